@@ -1,192 +1,110 @@
+#include "allocator.hpp"
+#include "bring_up.hpp"
+#include "compute_pipeline.hpp"
 #include "debug_reporter.hpp"
+#include "device_selector.hpp"
+#include "handle.hpp"
+#include "image_writer.hpp"
 #include "init_utils.hpp"
-
-#include <lodepng.h>
+#include "pipeline_cache.hpp"
+#include "pipeline_table.hpp"
+#include "profiler.hpp"
+#include "scheduler.hpp"
+#include "task_graph.hpp"
+#include "tiled_processor.hpp"
 
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
 #include <vulkan/vulkan.hpp>
 
+#include <glm/vec4.hpp>
+
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <iterator>
 #include <vector>
 #include <cstdint>
-#include <cmath>
-
-template<typename T>
-void encodeOneStep(const char* filename, T image, unsigned width, unsigned height) {
-  //Encode the image
-  // unsigned error = lodepng::encode(filename, image, width, height);
-  std::vector<unsigned char> png;
-
-  unsigned error = lodepng::encode(png, image, width, height);
-  if(!error) error = lodepng::save_file(png, filename);
-
-  //if there's an error, display it
-  if(error) std::cout << "encoder error " << error << ": "<< lodepng_error_text(error) << std::endl;
-}
+#include <string>
 
 int main(int argc, char* argv[]) {
+  auto time_start = std::chrono::steady_clock::now();
+  // size of the single image, larger images are processed in tiles
+  uint32_t const width = 512;
+  uint32_t const height = 512;
+
 // create Instance
-  vk::ApplicationInfo appInfo{};
-  appInfo.apiVersion = VK_API_VERSION_1_0;
-
-  vk::InstanceCreateInfo createInfo{};
-  createInfo.pApplicationInfo = &appInfo;
-  // fill layer info
-  std::vector<char const*> layers{"VK_LAYER_LUNARG_standard_validation"};
-  createInfo.ppEnabledLayerNames = layers.data();
-  createInfo.enabledLayerCount = uint32_t(layers.size());
-  // fill extension info 
-  std::vector<char const*> extensions = get_required_extensions(false, true);
-  createInfo.enabledExtensionCount = uint32_t(extensions.size());
-  createInfo.ppEnabledExtensionNames = extensions.data();
-
-  vk::Instance instance = vk::createInstance(createInfo);
-  // create DebugCallback objetc and attach to instance
-  DebugReporter debug_reporter{instance};
+  // validation is opt-in through VULKAN_MINIMAL_VALIDATION, layers are not even enumerated otherwise
+  bool const validation = validation_requested();
+  vk::Instance instance = create_instance({}, validation);
+  // create DebugCallback objetc and attach to instance, without validation names and labels are no-ops
+  DebugReporter debug_reporter = validation ? DebugReporter{instance} : DebugReporter{};
 
 ///////////////////////////////////////////////////////////////////////////////
 
-// choose physical device
-  std::vector<vk::PhysicalDevice> phys_devices = instance.enumeratePhysicalDevices();
-  // fallback in case optimal device is found
-  vk::PhysicalDevice chosen_device{phys_devices.front()};
-  // search for discrete GPU
-  for (const auto& phys_device : phys_devices) {
-    vk::PhysicalDeviceProperties properties = phys_device.getProperties();
-    // check if device is discrete GPU
-    if (properties.deviceType == vk::PhysicalDeviceType::eDiscreteGpu) {
-      chosen_device = phys_device;
-      break;
-    }
-  }
-// choose queue family
-  std::vector<vk::QueueFamilyProperties> queue_families =chosen_device.getQueueFamilyProperties();
-  vk::DeviceQueueCreateInfo info_queue{};
-  info_queue.queueCount = 1;
-  float priority = 1.0f;
-  info_queue.pQueuePriorities = &priority;
-  // search for usable queue
-  for (uint32_t i = 0; i < queue_families.size(); ++i) {
-    if (queue_families[i].queueFlags & vk::QueueFlagBits::eCompute 
-     && queue_families[i].queueFlags & vk::QueueFlagBits::eTransfer) {
-      info_queue.queueFamilyIndex = i;
-      break;
-    }
-  }
-  // fill info struct
-  vk::DeviceCreateInfo info_device{};
-  info_device.queueCreateInfoCount = 1;
-  info_device.pQueueCreateInfos = &info_queue;
-
-  vk::Device device = chosen_device.createDevice(info_device);
+// choose physical device and queue families
+  DeviceSelector device_selector{instance, VK_API_VERSION_1_0, resource_path(argv[0]) + "device_cache.txt"};
+  DeviceSelection selection = device_selector.select();
+  vk::PhysicalDevice chosen_device{selection.phys_device};
+  std::cout << "using " << selection.capabilities.name << " (score " << selection.score << ")" << std::endl;
+  uint32_t queue_family = selection.queue_family;
+  // framework objects and the device calls below go through the dispatch table loaded here
+  vk::Device device = create_device(selection);
+  vk::DispatchLoaderDynamic const& dispatch = device_dispatch(device);
 
 ///////////////////////////////////////////////////////////////////////////////
 
 // get queue
-  vk::Queue queue = device.getQueue(info_queue.queueFamilyIndex, 0);
-  queue.waitIdle();
+  vk::Queue queue = device.getQueue(queue_family, 0, dispatch);
+  queue.waitIdle(dispatch);
 
 ///////////////////////////////////////////////////////////////////////////////
 
-// create command pool
-  vk::CommandPoolCreateInfo info_command_pool{};
-  info_command_pool.queueFamilyIndex = info_queue.queueFamilyIndex;
-  info_command_pool.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
-
-  vk::CommandPool command_pool = device.createCommandPool(info_command_pool);
-// allocate command buffer
-  vk::CommandBufferAllocateInfo info_command_buffer{};
-  info_command_buffer.commandPool =  command_pool;
-  info_command_buffer.level =  vk::CommandBufferLevel::ePrimary;
-  info_command_buffer.commandBufferCount =  1;
-  
-  vk::CommandBuffer command_buffer = device.allocateCommandBuffers(info_command_buffer).front();
-
-  vk::CommandBufferBeginInfo info_cb_begin{};
-// record empty buffer
-  info_cb_begin.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
-  command_buffer.begin(info_cb_begin);
-  command_buffer.end();
-
-  vk::SubmitInfo info_submit{};
-  info_submit.pCommandBuffers = &command_buffer;
-  info_submit.commandBufferCount = 1;
-
-// logic
-  queue.submit(info_submit, {});
-  queue.waitIdle();
+// create scheduler with per-frame command pools
+  Scheduler scheduler{device, queue_family, queue};
+  scheduler.begin_frame();
 
 ///////////////////////////////////////////////////////////////////////////////
 
-// create host memory
-  vk::MemoryAllocateInfo info_memory_host{};
-  info_memory_host.allocationSize = 512 * 512 * 4 * 2;
-  vk::PhysicalDeviceMemoryProperties mem_properties_buffer = chosen_device.getMemoryProperties();
-  // search for coherent, mapable type
-  for (uint32_t i = 0; i < mem_properties_buffer.memoryTypeCount; ++i) {
-    if (mem_properties_buffer.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible
-     && mem_properties_buffer.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent) {
-      info_memory_host.memoryTypeIndex = i;
-      break;
-    }
-  }
-
-  vk::DeviceMemory memory_host = device.allocateMemory(info_memory_host);
-  uint8_t* ptr_mem = static_cast<uint8_t*>(device.mapMemory(memory_host, 0, 512 * 512 * 4 * 2));
-  std::memset(ptr_mem, 255, 512 * 512 * 4);
+// create allocator
+  Allocator allocator{device, chosen_device};
 
 ///////////////////////////////////////////////////////////////////////////////
 
-// create buffer
+// create buffer receiving the image content
+  // the image is copied straight into host cached memory and encoded from the mapping,
+  // rows are padded to the pitch the device copies fastest
+  vk::DeviceSize const pitch_alignment = std::max<vk::DeviceSize>(chosen_device.getProperties().limits.optimalBufferCopyRowPitchAlignment, 4);
+  vk::DeviceSize const row_pitch = (vk::DeviceSize(width) * 4 + pitch_alignment - 1) / pitch_alignment * pitch_alignment;
   vk::BufferCreateInfo info_buffer{};
-  info_buffer.size = 512 * 512 * 4;
-  info_buffer.usage = vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst; 
+  info_buffer.size = row_pitch * height;
+  info_buffer.usage = vk::BufferUsageFlagBits::eTransferDst;
 
-  vk::Buffer buffer = device.createBuffer(info_buffer);
+  // destruction is deferred until the frames using the buffer retired
+  Handle<vk::Buffer> buffer{device, device.createBuffer(info_buffer, nullptr, dispatch), &scheduler};
 // bind buffer to memory
-  vk::MemoryRequirements requirements_buffer = device.getBufferMemoryRequirements(buffer);
-  // check that memory type is supported
-  if(!(requirements_buffer.memoryTypeBits & (1 << info_memory_host.memoryTypeIndex))) throw std::exception{};
-  if(requirements_buffer.size > info_memory_host.allocationSize) throw std::exception{};
-  
-  device.bindBufferMemory(buffer, memory_host, 0);
-
-  // rerecord buffer
-  info_cb_begin.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
-  command_buffer.begin(info_cb_begin);
-  // fill half of image with white
-  command_buffer.fillBuffer(buffer, 0, 512 * 256 * 4, 0);
-  command_buffer.end();
-
-  queue.submit(info_submit, {});
-  queue.waitIdle();
+  AllocationHandle allocation_buffer{allocator, allocator.allocate(buffer.get(), MemoryUsage::eReadback), &scheduler};
 
 ///////////////////////////////////////////////////////////////////////////////
 
-// create image
-  vk::ImageCreateInfo info_image_linear{};
-  info_image_linear.imageType = vk::ImageType::e2D;
-  info_image_linear.extent = vk::Extent3D{512, 512, 1};
-  info_image_linear.format = vk::Format::eR8G8B8A8Unorm;
-  info_image_linear.tiling = vk::ImageTiling::eLinear;
-  info_image_linear.mipLevels = 1;
-  info_image_linear.arrayLayers = 1;
-  info_image_linear.initialLayout = vk::ImageLayout::eUndefined;
-  info_image_linear.usage = vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst;
+// create storage image
+  vk::ImageCreateInfo info_image{};
+  info_image.imageType = vk::ImageType::e2D;
+  info_image.extent = vk::Extent3D{width, height, 1};
+  info_image.format = vk::Format::eR8G8B8A8Unorm;
+  info_image.tiling = vk::ImageTiling::eOptimal;
+  info_image.mipLevels = 1;
+  info_image.arrayLayers = 1;
+  info_image.initialLayout = vk::ImageLayout::eUndefined;
+  info_image.usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc;
 
-  vk::Image image_linear = device.createImage(info_image_linear);
+  Handle<vk::Image> image{device, device.createImage(info_image, nullptr, dispatch), &scheduler};
 
 // bind image
-  vk::MemoryRequirements requirements_image_linear = device.getImageMemoryRequirements(image_linear);
-  // check that memory type is supported
-  if(!(requirements_image_linear.memoryTypeBits & (1 << info_memory_host.memoryTypeIndex))) throw std::exception{};
-  // calculate offset
-  vk::DeviceSize offset = vk::DeviceSize(std::ceil(float(requirements_buffer.size / requirements_image_linear.alignment))) * requirements_image_linear.alignment;
-  if(offset + requirements_image_linear.size > info_memory_host.allocationSize) throw std::exception{};
-
-  device.bindImageMemory(image_linear, memory_host, offset);
+  AllocationHandle allocation_image{allocator, allocator.allocate(image.get(), MemoryUsage::eDeviceLocal), &scheduler};
+  debug_reporter.set_name(device, buffer.get(), "readback buffer");
+  debug_reporter.set_name(device, image.get(), "fill target");
 
   // /create full range
   vk::ImageSubresourceRange image_range_full{};
@@ -196,158 +114,201 @@ int main(int argc, char* argv[]) {
   image_range_full.layerCount = 1;
   image_range_full.aspectMask = vk::ImageAspectFlagBits::eColor;
 
-  // rerecord buffer
-  info_cb_begin.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
-  command_buffer.begin(info_cb_begin);
-  // transform to general layout
-  vk::ImageMemoryBarrier barrier_img{};
-  barrier_img.image = image_linear;
-  barrier_img.subresourceRange = image_range_full;
-  barrier_img.oldLayout = vk::ImageLayout::eUndefined;
-  barrier_img.newLayout = vk::ImageLayout::eGeneral;
-  barrier_img.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
-  command_buffer.pipelineBarrier(
-    vk::PipelineStageFlagBits::eTopOfPipe,
-    vk::PipelineStageFlagBits::eTransfer,
-    vk::DependencyFlags{},
-    {},
-    {},
-    barrier_img
-  );
-  
-  // fill half of image with white
-  vk::ClearColorValue clear_colors{};
-  clear_colors.setFloat32({1.0f, 0.0f, 1.0f, 1.0f});
-  command_buffer.clearColorImage(image_linear, vk::ImageLayout::eGeneral, clear_colors, image_range_full);
-  command_buffer.end();
-
-  queue.submit(info_submit, {});
-  queue.waitIdle();
+// create view
+  vk::ComponentMapping mapping{};
+  mapping.r = vk::ComponentSwizzle::eR;
+  mapping.g = vk::ComponentSwizzle::eG;
+  mapping.b = vk::ComponentSwizzle::eB;
+  mapping.a = vk::ComponentSwizzle::eA;
+
+  vk::ImageViewCreateInfo info_image_view{};
+  info_image_view.image = image.get();
+  info_image_view.subresourceRange = image_range_full;
+  info_image_view.format = info_image.format;
+  info_image_view.viewType = vk::ImageViewType::e2D;
+  info_image_view.components = mapping;
+
+  Handle<vk::ImageView> view_image{device, device.createImageView(info_image_view, nullptr, dispatch), &scheduler};
+
 ///////////////////////////////////////////////////////////////////////////////
 
-// // create device memory
-//   vk::MemoryAllocateInfo info_memory_device{};
-//   info_memory_device.allocationSize = 512 * 512 * 4 * 2;
-//   vk::PhysicalDeviceMemoryProperties mem_properties_image = chosen_device.getMemoryProperties();
-//   // search for coherent, mapable type
-//   for (uint32_t i = 0; i < mem_properties_image.memoryTypeCount; ++i) {
-//     if (mem_properties_image.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal) {
-//       info_memory_device.memoryTypeIndex = i;
-//       break;
-//     }
-//   }
-
-//   vk::DeviceMemory memory_device = device.allocateMemory(info_memory_device);
-// synchronisation
-// // create image
-//   vk::ImageCreateInfo info_image{};
-//   info_image.imageType = vk::ImageType::e2D;
-//   info_image.extent = vk::Extent3D{512, 512, 1};
-//   info_image.format = vk::Format::eR8G8B8A8Unorm;
-//   info_image.tiling = vk::ImageTiling::eOptimal;
-//   info_image.mipLevels = 1;
-//   info_image.arrayLayers = 1;
-//   info_image.initialLayout = vk::ImageLayout::eUndefined;
-//   info_image.usage = vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst;
-//   // for view
-//   info_image.usage |= vk::ImageUsageFlagBits::eStorage;
-
-//   vk::Image image = device.createImage(info_image);
-
-// // bind image
-//   vk::MemoryRequirements requirements_image = device.getImageMemoryRequirements(image);
-//   // check that memory type is supported
-//   if(!(requirements_image.memoryTypeBits & (1 << info_memory_device.memoryTypeIndex))) throw std::exception{};
-//   if(requirements_image.size > info_memory_device.allocationSize) throw std::exception{};
-
-//   device.bindImageMemory(image, memory_device, 0);
-
-//   // rerecord buffer
-//   info_cb_begin.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
-//   command_buffer.begin(info_cb_begin);
-//   // transform to general layout
-//   vk::ImageMemoryBarrier barrier_img{};
-//   barrier_img.image = image;
-//   barrier_img.subresourceRange = image_range_full;
-//   barrier_img.oldLayout = vk::ImageLayout::eUndefined;
-//   barrier_img.newLayout = vk::ImageLayout::eGeneral;
-//   barrier_img.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
-//   command_buffer.pipelineBarrier(
-//     vk::PipelineStageFlagBits::eTopOfPipe,
-//     vk::PipelineStageFlagBits::eTransfer,
-//     vk::DependencyFlags{},
-//     {},
-//     {},
-//     barrier_img
-//   );
-  
-//   // fill half of image with white
-//   vk::ClearColorValue clear_colors{};
-//   clear_colors.setFloat32({1.0f, 0.0f, 1.0f, 1.0f});
-//   command_buffer.clearColorImage(image, vk::ImageLayout::eGeneral, clear_colors, image_range_full);
-//   command_buffer.end();
-
-//   queue.submit(info_submit, {});
-//   queue.waitIdle();
-
-//   // copy image to buffer
-//   // /create full layer range
-//   vk::ImageSubresourceLayers image_layers_full{};
-//   image_layers_full.mipLevel = 0;
-//   image_layers_full.baseArrayLayer = 0;
-//   image_layers_full.layerCount = 1;
-//   image_layers_full.aspectMask = vk::ImageAspectFlagBits::eColor;
-
-//   command_buffer.begin(info_cb_begin);
-
-//   vk::BufferImageCopy copy_region{};
-//   copy_region.imageSubresource = image_layers_full;
-//   copy_region.imageExtent = info_image.extent;
-//   command_buffer.copyImageToBuffer(image, vk::ImageLayout::eGeneral, buffer, copy_region);
-//   command_buffer.end();
-
-//   queue.submit(info_submit, {});
-//   queue.waitIdle();
+// create compute pipeline, workgroup size is specialized as listed in the pipeline table
+  PipelineCache pipeline_cache{device, chosen_device, resource_path(argv[0]) + "pipeline_cache.bin"};
+  std::string const shader_dir = resource_path(argv[0]) + "shaders/";
+  auto time_pipeline = std::chrono::steady_clock::now();
+  ComputePipeline pipeline_fill = create_pipeline(device, shader_dir, pipeline_cache.get(), sample_pipeline("fill"));
+  std::cout << (pipeline_cache.warm() ? "warm" : "cold") << " pipeline creation took "
+            << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - time_pipeline).count() << "ms" << std::endl;
+  DescriptorSet set_fill = pipeline_fill.allocate_set(0);
+  set_fill.write(0, view_image.get(), vk::ImageLayout::eGeneral).update();
+
+#ifdef ENABLE_PROFILING
+  // measures the recorded regions, exported together with the cpu scopes
+  GpuProfiler gpu_profiler{device, chosen_device, queue_family};
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
 
-// create view
+  // record dispatch job
+  uint32_t job_fill = scheduler.begin_job();
+  vk::CommandBuffer command_buffer = scheduler.command_buffer(job_fill);
+#ifdef ENABLE_PROFILING
+  gpu_profiler.reset(command_buffer);
+#endif
+  // barriers and layouts are derived from the declared uses
+  TaskGraph graph{device, allocator};
+  TaskGraph::Resource resource_image = graph.import_image(image.get(), image_range_full, vk::ImageLayout::eUndefined, view_image.get());
+  TaskGraph::Resource resource_buffer = graph.import_buffer(buffer.get());
+  graph.add_pass("fill", {{resource_image, ResourceUsage::eStorageWrite}}, [&](vk::CommandBuffer const& cb, TaskGraph const&) {
+    PROFILE_GPU_SCOPE(gpu_profiler, cb, "fill");
+    // fill upper half of image with white, lower half with magenta
+    glm::vec4 colors[2] = {glm::vec4{1.0f, 1.0f, 1.0f, 1.0f}, glm::vec4{1.0f, 0.0f, 1.0f, 1.0f}};
+    pipeline_fill.bind(cb, {set_fill.get()});
+    pipeline_fill.push_constants(cb, colors, sizeof(colors));
+    pipeline_fill.dispatch(cb, glm::uvec3{width, height, 1});
+  });
+  graph.add_pass("copy", {{resource_image, ResourceUsage::eTransferSrc}, {resource_buffer, ResourceUsage::eTransferDst}}, [&](vk::CommandBuffer const& cb, TaskGraph const& g) {
+    PROFILE_GPU_SCOPE(gpu_profiler, cb, "copy");
+    // copy image to buffer
+    // /create full layer range
+    vk::ImageSubresourceLayers image_layers_full{};
+    image_layers_full.mipLevel = 0;
+    image_layers_full.baseArrayLayer = 0;
+    image_layers_full.layerCount = 1;
+    image_layers_full.aspectMask = vk::ImageAspectFlagBits::eColor;
+
+    vk::BufferImageCopy copy_region{};
+    copy_region.bufferRowLength = uint32_t(row_pitch / 4);
+    copy_region.imageSubresource = image_layers_full;
+    copy_region.imageExtent = info_image.extent;
+    cb.copyImageToBuffer(g.image(resource_image), TaskGraph::layout(ResourceUsage::eTransferSrc), g.buffer(resource_buffer), copy_region, dispatch);
+  });
+  // the copy is made visible to the mapped readback
+  graph.set_final_usage(resource_buffer, ResourceUsage::eHostRead);
+  graph.compile();
+  debug_reporter.begin_label(command_buffer, "task graph");
+  graph.execute(command_buffer);
+  debug_reporter.end_label(command_buffer);
+  std::cout << "task graph recorded " << graph.statistics().barrier_count << " barriers in " << graph.statistics().batch_count << " batches" << std::endl;
+  scheduler.end_job(job_fill);
+
+// submit frame
+#ifdef ENABLE_PROFILING
+  auto time_submit = Profiler::clock::now();
+#endif
+  scheduler.end_frame();
+  std::cout << "first submit after " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - time_start).count() << "ms" << std::endl;
+  scheduler.wait_idle();
+  for (auto const& timing : scheduler.take_timings()) {
+    std::cout << "job " << timing.job << " recorded in " << timing.record_ms << "ms, completed after " << timing.latency_ms << "ms" << std::endl;
+  }
 
-  // vk::ComponentMapping mapping{};
-  // mapping.r = vk::ComponentSwizzle::eR;
-  // mapping.g = vk::ComponentSwizzle::eG;
-  // mapping.b = vk::ComponentSwizzle::eB;
-  // mapping.a = vk::ComponentSwizzle::eA;
+// read back result, the copy completed with the frame
+  allocator.invalidate(allocation_buffer.get(), 0, info_buffer.size);
+  uint8_t const* pixels = allocation_buffer.get().ptr;
 
-  // vk::ImageViewCreateInfo info_image_view{};
-  // info_image_view.image = image;
-  // info_image_view.subresourceRange = image_range_full;
-  // info_image_view.format = info_image.format;
-  // info_image_view.viewType = vk::ImageViewType::e2D;
-  // info_image_view.components = mapping;
+#ifdef ENABLE_PROFILING
+  gpu_profiler.collect(time_submit);
+  Profiler::write_trace(resource_path(argv[0]) + "trace.json");
+#endif
 
-  // vk::ImageView view_image = device.createImageView(info_image_view);
+///////////////////////////////////////////////////////////////////////////////
+
+// blur a procedural image of the size given on the command line in tiles,
+// the result is streamed to disk so it may exceed device limits and memory
+  if (argc >= 3) {
+    uint32_t const tiled_width = uint32_t(std::stoul(argv[1]));
+    uint32_t const tiled_height = uint32_t(std::stoul(argv[2]));
+    uint32_t const radius = 2;
+    ComputePipeline pipeline_blur = create_pipeline(device, shader_dir, pipeline_cache.get(), sample_pipeline("blur"));
+    // three tiles in flight overlap filling, blurring and reading back
+    TiledProcessor processor{device, chosen_device, allocator, queue_family, queue, 1024, radius, 3};
+    std::vector<DescriptorSet> sets_blur{};
+    for (uint32_t slot = 0; slot < processor.slot_count(); ++slot) {
+      sets_blur.push_back(pipeline_blur.allocate_set(0));
+      sets_blur.back().write(0, processor.input_view(slot), vk::ImageLayout::eGeneral).write(1, processor.output_view(slot), vk::ImageLayout::eGeneral).update();
+    }
 
-  // device.waitIdle();
+    JobSystem jobs{};
+    PngStream stream{resource_path(argv[0]) + "out_tiled.png", tiled_width, tiled_height, &jobs};
+    auto time_tiled = std::chrono::steady_clock::now();
+    processor.run(tiled_width, tiled_height,
+      [](Tile const& tile, uint8_t* tile_pixels, size_t row_pitch) {
+        // checkerboard over a gradient, computed from image coordinates
+        for (uint32_t y = 0; y < tile.input_height; ++y) {
+          uint8_t* row = tile_pixels + y * row_pitch;
+          for (uint32_t x = 0; x < tile.input_width; ++x) {
+            uint32_t pos_x = tile.input_x + x;
+            uint32_t pos_y = tile.input_y + y;
+            row[x * 4] = (pos_x / 64 + pos_y / 64) % 2 ? 255 : 0;
+            row[x * 4 + 1] = uint8_t(pos_x);
+            row[x * 4 + 2] = uint8_t(pos_y);
+            row[x * 4 + 3] = 255;
+          }
+        }
+      },
+      [&](vk::CommandBuffer const& cb, Tile const& tile, uint32_t slot) {
+        int32_t constants[7] = {
+          int32_t(tile.x - tile.input_x), int32_t(tile.y - tile.input_y),
+          int32_t(tile.input_width), int32_t(tile.input_height),
+          int32_t(tile.width), int32_t(tile.height),
+          int32_t(radius)
+        };
+        pipeline_blur.bind(cb, {sets_blur[slot].get()});
+        pipeline_blur.push_constants(cb, constants, sizeof(constants));
+        pipeline_blur.dispatch(cb, glm::uvec3{tile.width, tile.height, 1});
+      },
+      [&](uint8_t const* rows, uint32_t, uint32_t row_count, size_t row_pitch) {
+        stream.write_rows(rows, row_count, row_pitch);
+      }
+    );
+    stream.finish();
+    std::cout << "tiled " << tiled_width << "x" << tiled_height << " image in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - time_tiled).count() << "ms" << std::endl;
+  }
 
 ///////////////////////////////////////////////////////////////////////////////
 
 // end
-  std::vector<uint8_t> pixels(512 * 512 * 4, 255);
   auto filename = resource_path(argv[0]) + "out.png";
   std::cout << filename << std::endl;
-  // encodeOneStep(filename.c_str(), pixels, 512, 512);
-  encodeOneStep(filename.c_str(), ptr_mem + offset, 512, 512);
-  
-  // device.destroyImageView(view_image);
-  device.destroyImage(image_linear);
-  device.destroyBuffer(buffer);
-  device.freeMemory(memory_host);
-  // device.freeMemory(memory_device);
-  device.destroyCommandPool(command_pool);
-  device.destroy();
+  // encoding reads the mapped buffer and overlaps the teardown of everything else
+  ImageWriter image_writer{};
+  auto written = image_writer.write(filename, ImageFormat::ePng, pixels, width, height, size_t(row_pitch));
+
+  set_fill = {};
+  pipeline_fill = {};
+  pipeline_cache = {};
+  graph = {};
+#ifdef ENABLE_PROFILING
+  gpu_profiler = {};
+#endif
+  // released objects are queued on the scheduler, no waitIdle needed
+  view_image = {};
+  image = {};
+  allocation_image = {};
+  // the buffer is released once the encoder is done with it
+  written.wait();
+  buffer = {};
+  allocation_buffer = {};
+  // flushes the deferred deletions, so it goes before the allocator
+  scheduler = {};
+  allocator = {};
+  destroy_device(device);
+  // errors are recorded instead of thrown from the validation callback
+  debug_reporter.flush();
+  uint32_t validation_errors = debug_reporter.error_count();
+  if (validation_errors > 0) {
+    std::cout << validation_errors << " validation errors, last: " << debug_reporter.last_error() << std::endl;
+  }
   debug_reporter = {};
   instance.destroy();
 
-  return 0;
+  try {
+    written.get();
+  }
+  catch (std::exception const& e) {
+    std::cout << e.what() << std::endl;
+  }
+  return validation_errors > 0 ? 1 : 0;
 }
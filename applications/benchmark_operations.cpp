@@ -0,0 +1,212 @@
+#include "allocator.hpp"
+#include "benchmark.hpp"
+#include "handle.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// measures the transfer operations, host access and submission costs the sample relies on
+// runs headless, e.g. on lavapipe, and prints one row per operation and size
+// usage: benchmark_operations [max size in MiB] [repetitions] [csv|json]
+
+static std::string format_size(vk::DeviceSize bytes) {
+  if (bytes >= 1024 * 1024 * 1024) return std::to_string(bytes / (1024 * 1024 * 1024)) + "GiB";
+  if (bytes >= 1024 * 1024) return std::to_string(bytes / (1024 * 1024)) + "MiB";
+  if (bytes >= 1024) return std::to_string(bytes / 1024) + "KiB";
+  return std::to_string(bytes) + "B";
+}
+
+int main(int argc, char* argv[]) {
+  vk::DeviceSize max_size = (argc > 1 ? vk::DeviceSize(std::stoull(argv[1])) : 256) * 1024 * 1024;
+  uint32_t repetitions = argc > 2 ? uint32_t(std::stoul(argv[2])) : 10;
+  bool json = argc > 3 && std::string{argv[3]} == "json";
+
+// create headless instance and device
+  HeadlessDevice headless = create_headless_device();
+  DeviceSelection const& selection = headless.selection;
+  vk::PhysicalDevice phys_device = selection.phys_device;
+  vk::Device device = headless.device;
+
+  vk::PhysicalDeviceLimits limits = phys_device.getProperties().limits;
+  Allocator allocator{device, phys_device};
+
+// command buffer, fence and timestamps shared by all gpu measurements
+  BenchmarkSubmitter submitter{headless};
+  std::string clock_gpu = submitter.clock();
+
+  std::vector<BenchmarkResult> results{};
+  auto measure = [&](std::string const& operation, vk::DeviceSize bytes, uint32_t items, std::string const& clock, std::function<double()> const& run) {
+    results.push_back(collect_samples(BenchmarkResult{operation, "", bytes, items, clock}, repetitions, run));
+    std::cerr << operation << " " << format_size(bytes) << ": " << median(results.back().samples_ms) << "ms" << std::endl;
+  };
+
+// fixed cost of a submission and fence round trip
+  measure("submit_latency", 0, 1, "host", [&]() {
+    return submitter.submit([](vk::CommandBuffer const&) {}, false);
+  });
+
+// recording cost, independent of execution
+  Handle<vk::Buffer> target{};
+  AllocationHandle allocation_target{};
+  {
+    vk::BufferCreateInfo info_buffer{};
+    info_buffer.size = 64 * 1024;
+    info_buffer.usage = vk::BufferUsageFlagBits::eTransferDst;
+    target = Handle<vk::Buffer>{device, device.createBuffer(info_buffer)};
+    allocation_target = AllocationHandle{allocator, allocator.allocate(target.get(), MemoryUsage::eDeviceLocal)};
+  }
+  uint32_t const record_count = 10000;
+  vk::CommandBuffer command_buffer = submitter.command_buffer();
+  vk::CommandBufferBeginInfo info_cb_begin{};
+  info_cb_begin.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+  measure("record_fill", 0, record_count, "host", [&]() {
+    auto start = std::chrono::steady_clock::now();
+    command_buffer.begin(info_cb_begin);
+    for (uint32_t i = 0; i < record_count; ++i) {
+      command_buffer.fillBuffer(target.get(), (i % (16 * 1024)) * 4, 4, i);
+    }
+    command_buffer.end();
+    double time = elapsed_ms(start);
+    command_buffer.reset(vk::CommandBufferResetFlags{});
+    return time;
+  });
+
+// device operations and host access from KiB to max_size
+  vk::ImageSubresourceRange image_range{};
+  image_range.aspectMask = vk::ImageAspectFlagBits::eColor;
+  image_range.levelCount = 1;
+  image_range.layerCount = 1;
+  vk::ImageSubresourceLayers image_layers{};
+  image_layers.aspectMask = vk::ImageAspectFlagBits::eColor;
+  image_layers.layerCount = 1;
+
+  for (vk::DeviceSize size = 4 * 1024; size <= max_size; size *= 4) {
+    try {
+      vk::BufferCreateInfo info_buffer{};
+      info_buffer.size = size;
+      info_buffer.usage = vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+      Handle<vk::Buffer> buffer{device, device.createBuffer(info_buffer)};
+      AllocationHandle allocation_buffer{allocator, allocator.allocate(buffer.get(), MemoryUsage::eDeviceLocal)};
+
+      measure("fill_buffer", size, 1, clock_gpu, [&]() {
+        return submitter.submit([&](vk::CommandBuffer const& cb) {
+          cb.fillBuffer(buffer.get(), 0, size, 0x01020304);
+        }, true);
+      });
+
+      // rgba8 image of the same size, as wide as allowed
+      vk::DeviceSize pixels = size / 4;
+      uint32_t width = uint32_t(std::min<vk::DeviceSize>(pixels, std::min(limits.maxImageDimension2D, 4096u)));
+      uint32_t height = uint32_t(pixels / width);
+      if (height <= limits.maxImageDimension2D) {
+        vk::ImageCreateInfo info_image{};
+        info_image.imageType = vk::ImageType::e2D;
+        info_image.extent = vk::Extent3D{width, height, 1};
+        info_image.format = vk::Format::eR8G8B8A8Unorm;
+        info_image.tiling = vk::ImageTiling::eOptimal;
+        info_image.mipLevels = 1;
+        info_image.arrayLayers = 1;
+        info_image.samples = vk::SampleCountFlagBits::e1;
+        info_image.initialLayout = vk::ImageLayout::eUndefined;
+        info_image.usage = vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst;
+        Handle<vk::Image> image{device, device.createImage(info_image)};
+        AllocationHandle allocation_image{allocator, allocator.allocate(image.get(), MemoryUsage::eDeviceLocal)};
+
+        vk::ImageMemoryBarrier barrier{};
+        barrier.image = image.get();
+        barrier.subresourceRange = image_range;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.oldLayout = vk::ImageLayout::eUndefined;
+        barrier.newLayout = vk::ImageLayout::eTransferDstOptimal;
+        barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+        submitter.submit([&](vk::CommandBuffer const& cb) {
+          cb.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags{}, {}, {}, barrier);
+        }, false);
+
+        vk::BufferImageCopy region{};
+        region.imageSubresource = image_layers;
+        region.imageExtent = info_image.extent;
+        vk::DeviceSize image_bytes = vk::DeviceSize(width) * height * 4;
+
+        vk::ClearColorValue color{std::array<float, 4>{{1.0f, 0.0f, 1.0f, 1.0f}}};
+        measure("clear_color_image", image_bytes, 1, clock_gpu, [&]() {
+          return submitter.submit([&](vk::CommandBuffer const& cb) {
+            cb.clearColorImage(image.get(), vk::ImageLayout::eTransferDstOptimal, color, image_range);
+          }, true);
+        });
+        measure("copy_buffer_to_image", image_bytes, 1, clock_gpu, [&]() {
+          return submitter.submit([&](vk::CommandBuffer const& cb) {
+            cb.copyBufferToImage(buffer.get(), image.get(), vk::ImageLayout::eTransferDstOptimal, region);
+          }, true);
+        });
+
+        barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+        barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+        barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+        submitter.submit([&](vk::CommandBuffer const& cb) {
+          cb.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags{}, {}, {}, barrier);
+        }, false);
+        measure("copy_image_to_buffer", image_bytes, 1, clock_gpu, [&]() {
+          return submitter.submit([&](vk::CommandBuffer const& cb) {
+            cb.copyImageToBuffer(image.get(), vk::ImageLayout::eTransferSrcOptimal, buffer.get(), region);
+          }, true);
+        });
+      }
+
+      // host access through persistent mappings, memory types picked by the allocator policy
+      std::vector<uint8_t> host_data(size, 0x7f);
+      info_buffer.size = size;
+      info_buffer.usage = vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+      std::vector<std::pair<std::string, MemoryUsage>> host_memories{
+        {"upload", MemoryUsage::eUpload},
+        {"readback", MemoryUsage::eReadback}
+      };
+      for (auto const& memory : host_memories) {
+        Handle<vk::Buffer> host_buffer{device, device.createBuffer(info_buffer)};
+        AllocationHandle allocation_host{allocator, allocator.allocate(host_buffer.get(), memory.second)};
+        Allocation const& allocation = allocation_host.get();
+
+        measure("host_write_" + memory.first, size, 1, "host", [&]() {
+          auto start = std::chrono::steady_clock::now();
+          std::memcpy(allocation.ptr, host_data.data(), size);
+          allocator.flush(allocation, 0, size);
+          return elapsed_ms(start);
+        });
+        measure("host_read_" + memory.first, size, 1, "host", [&]() {
+          auto start = std::chrono::steady_clock::now();
+          allocator.invalidate(allocation, 0, size);
+          std::memcpy(host_data.data(), allocation.ptr, size);
+          return elapsed_ms(start);
+        });
+      }
+    }
+    catch (std::exception const& e) {
+      std::cerr << "skipping " << format_size(size) << ": " << e.what() << std::endl;
+    }
+  }
+
+  if (json) {
+    print_json(results, {{"device", selection.capabilities.name}});
+  }
+  else {
+    print_csv(results);
+  }
+
+  target = {};
+  allocation_target = {};
+  submitter = {};
+  allocator = {};
+  destroy_headless_device(headless);
+
+  return 0;
+}
@@ -0,0 +1,267 @@
+#include "benchmark.hpp"
+#include "pixel_convert.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// checks the simd conversion kernels against the scalar reference and measures their throughput
+// prints one row per kernel and instruction set, exits with 1 if any check fails
+// usage: benchmark_pixels [megapixels] [repetitions] [csv|json]
+
+static bool is_nan_half(uint16_t half) {
+  return (half & 0x7c00) == 0x7c00 && (half & 0x3ff) != 0;
+}
+
+// NaN payloads may differ between f16c and the portable kernels
+static bool equal_halves(std::vector<uint16_t> const& a, std::vector<uint16_t> const& b) {
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i] != b[i] && !(is_nan_half(a[i]) && is_nan_half(b[i]))) return false;
+  }
+  return true;
+}
+
+static bool equal_floats(std::vector<float> const& a, std::vector<float> const& b) {
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (std::memcmp(&a[i], &b[i], 4) != 0 && !(std::isnan(a[i]) && std::isnan(b[i]))) return false;
+  }
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  size_t pixel_count = size_t(argc > 1 ? std::stod(argv[1]) * 1024 * 1024 : 4 * 1024 * 1024);
+  uint32_t repetitions = argc > 2 ? uint32_t(std::stoul(argv[2])) : 10;
+  bool json = argc > 3 && std::string{argv[3]} == "json";
+  std::cerr << "highest simd level " << simd_level_name(simd_level()) << std::endl;
+
+  std::vector<SimdLevel> levels{SimdLevel::eScalar};
+  if (simd_level() >= SimdLevel::eSse41) levels.push_back(SimdLevel::eSse41);
+  if (simd_level() >= SimdLevel::eAvx2) levels.push_back(SimdLevel::eAvx2);
+
+  uint32_t failures = 0;
+  auto check = [&](std::string const& name, bool passed) {
+    if (!passed) {
+      std::cerr << "check " << name << " FAILED" << std::endl;
+      ++failures;
+    }
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+// exhaustive and random checks, odd counts exercise the scalar remainders
+  std::mt19937 rng{42};
+  std::vector<uint16_t> all_halves(65536 + 7);
+  for (size_t i = 0; i < all_halves.size(); ++i) {
+    all_halves[i] = uint16_t(i);
+  }
+  std::vector<float> floats(100003);
+  std::uniform_real_distribution<float> distribution{-0.25f, 1.25f};
+  for (auto& value : floats) {
+    value = distribution(rng);
+  }
+  // specials and half rounding edge cases
+  float const specials[] = {0.0f, -0.0f, 1.0f, 65504.0f, 65520.0f, 1e-8f, -1e-8f, 6.1e-5f, 5.96e-8f, 2.98e-8f,
+                            INFINITY, -INFINITY, NAN, 1.00048828125f, 1.00146484375f, 0.5f / 255.0f, 254.5f / 255.0f};
+  std::copy(std::begin(specials), std::end(specials), floats.begin());
+  std::vector<uint8_t> bytes(floats.size() * 4 + 3);
+  for (auto& value : bytes) {
+    value = uint8_t(rng());
+  }
+  std::vector<uint32_t> packed(floats.size() / 4);
+  for (auto& value : packed) {
+    value = uint32_t(rng());
+  }
+  size_t const check_pixels = floats.size() / 4;
+
+  std::vector<float> reference_floats(all_halves.size());
+  half_to_float(all_halves.data(), reference_floats.data(), all_halves.size(), SimdLevel::eScalar);
+  std::vector<uint16_t> reference_halves(floats.size());
+  float_to_half(floats.data(), reference_halves.data(), floats.size(), SimdLevel::eScalar);
+  std::vector<uint8_t> reference_bytes(floats.size());
+  float_to_unorm8(floats.data(), reference_bytes.data(), floats.size(), SimdLevel::eScalar);
+  std::vector<uint8_t> reference_srgb(check_pixels * 4);
+  linear_to_srgb8(floats.data(), reference_srgb.data(), check_pixels, SimdLevel::eScalar);
+  std::vector<uint32_t> reference_packed(check_pixels);
+  pack_a2b10g10r10(floats.data(), reference_packed.data(), check_pixels, SimdLevel::eScalar);
+
+  // scalar reference against exact arithmetic
+  {
+    std::vector<uint16_t> roundtrip(all_halves.size());
+    float_to_half(reference_floats.data(), roundtrip.data(), roundtrip.size(), SimdLevel::eScalar);
+    check("half roundtrip", equal_halves(roundtrip, all_halves));
+
+    std::vector<float> unorm(256);
+    std::vector<uint8_t> values(256);
+    for (uint32_t i = 0; i < 256; ++i) values[i] = uint8_t(i);
+    unorm8_to_float(values.data(), unorm.data(), 256, SimdLevel::eScalar);
+    std::vector<uint8_t> roundtrip_unorm(256);
+    float_to_unorm8(unorm.data(), roundtrip_unorm.data(), 256, SimdLevel::eScalar);
+    check("unorm8 roundtrip", roundtrip_unorm == values);
+
+    std::vector<float> linear(256);
+    srgb8_to_linear(values.data(), linear.data(), 64, SimdLevel::eScalar);
+    std::vector<uint8_t> roundtrip_srgb(256);
+    linear_to_srgb8(linear.data(), roundtrip_srgb.data(), 64, SimdLevel::eScalar);
+    check("srgb roundtrip", roundtrip_srgb == values);
+
+    int max_error = 0;
+    for (size_t i = 0; i < check_pixels * 4; ++i) {
+      if (i % 4 == 3) continue;
+      // NaN encodes to 0
+      double value = std::isnan(floats[i]) ? 0.0 : std::min(std::max(double(floats[i]), 0.0), 1.0);
+      double exact = value <= 0.0031308 ? value * 12.92 : 1.055 * std::pow(value, 1.0 / 2.4) - 0.055;
+      max_error = std::max(max_error, std::abs(int(reference_srgb[i]) - int(std::floor(exact * 255.0 + 0.5))));
+    }
+    check("srgb encode accuracy", max_error <= 1);
+  }
+
+  // every level against the scalar reference
+  for (SimdLevel level : levels) {
+    std::string suffix = std::string{" "} + simd_level_name(level);
+    std::vector<float> result_floats(all_halves.size());
+    half_to_float(all_halves.data(), result_floats.data(), all_halves.size(), level);
+    check("half_to_float" + suffix, equal_floats(result_floats, reference_floats));
+
+    std::vector<uint16_t> result_halves(floats.size());
+    float_to_half(floats.data(), result_halves.data(), floats.size(), level);
+    check("float_to_half" + suffix, equal_halves(result_halves, reference_halves));
+
+    std::vector<uint8_t> result_bytes(floats.size());
+    float_to_unorm8(floats.data(), result_bytes.data(), floats.size(), level);
+    check("float_to_unorm8" + suffix, result_bytes == reference_bytes);
+
+    std::vector<float> result_unorm(bytes.size());
+    std::vector<float> reference_unorm(bytes.size());
+    unorm8_to_float(bytes.data(), result_unorm.data(), bytes.size(), level);
+    unorm8_to_float(bytes.data(), reference_unorm.data(), bytes.size(), SimdLevel::eScalar);
+    check("unorm8_to_float" + suffix, equal_floats(result_unorm, reference_unorm));
+
+    std::vector<uint8_t> result_srgb(check_pixels * 4);
+    linear_to_srgb8(floats.data(), result_srgb.data(), check_pixels, level);
+    check("linear_to_srgb8" + suffix, result_srgb == reference_srgb);
+
+    std::vector<float> result_linear(check_pixels * 4);
+    std::vector<float> reference_linear(check_pixels * 4);
+    srgb8_to_linear(bytes.data(), result_linear.data(), check_pixels, level);
+    srgb8_to_linear(bytes.data(), reference_linear.data(), check_pixels, SimdLevel::eScalar);
+    check("srgb8_to_linear" + suffix, equal_floats(result_linear, reference_linear));
+
+    std::vector<uint32_t> result_packed(check_pixels);
+    pack_a2b10g10r10(floats.data(), result_packed.data(), check_pixels, level);
+    check("pack_a2b10g10r10" + suffix, result_packed == reference_packed);
+
+    std::vector<float> result_unpacked(packed.size() * 4);
+    std::vector<float> reference_unpacked(packed.size() * 4);
+    unpack_a2b10g10r10(packed.data(), result_unpacked.data(), packed.size(), level);
+    unpack_a2b10g10r10(packed.data(), reference_unpacked.data(), packed.size(), SimdLevel::eScalar);
+    check("unpack_a2b10g10r10" + suffix, equal_floats(result_unpacked, reference_unpacked));
+
+    uint8_t const order[4] = {2, 1, 0, 3};
+    std::vector<uint8_t> result_swizzled(check_pixels * 4);
+    std::vector<uint8_t> reference_swizzled(check_pixels * 4);
+    swizzle_rgba8(bytes.data(), result_swizzled.data(), check_pixels, order, level);
+    swizzle_rgba8(bytes.data(), reference_swizzled.data(), check_pixels, order, SimdLevel::eScalar);
+    check("swizzle_rgba8" + suffix, result_swizzled == reference_swizzled);
+
+    // all format pairs with padded rows
+    PixelFormat const formats[] = {PixelFormat::eRgba8Unorm, PixelFormat::eBgra8Unorm, PixelFormat::eRgba8Srgb, PixelFormat::eBgra8Srgb,
+                                   PixelFormat::eRgba16Float, PixelFormat::eRgba32Float, PixelFormat::eA2b10g10r10Unorm};
+    uint32_t const width = 37;
+    uint32_t const height = 5;
+    std::vector<uint8_t> source(size_t(width) * 16 * height + 64 * height);
+    for (PixelFormat src_format : formats) {
+      size_t src_pitch = width * pixel_size(src_format) + 16;
+      // valid source data, produced from random unorm values
+      convert_pixels(PixelFormat::eRgba8Unorm, bytes.data(), width * 4, src_format, source.data(), src_pitch, width, height, SimdLevel::eScalar);
+      for (PixelFormat dst_format : formats) {
+        size_t dst_pitch = width * pixel_size(dst_format) + 32;
+        std::vector<uint8_t> result(dst_pitch * height, 0);
+        std::vector<uint8_t> reference(dst_pitch * height, 0);
+        convert_pixels(src_format, source.data(), src_pitch, dst_format, result.data(), dst_pitch, width, height, level);
+        convert_pixels(src_format, source.data(), src_pitch, dst_format, reference.data(), dst_pitch, width, height, SimdLevel::eScalar);
+        check("convert " + std::to_string(int(src_format)) + " to " + std::to_string(int(dst_format)) + suffix, result == reference);
+      }
+    }
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+// throughput of each kernel at each level
+  std::vector<BenchmarkResult> results{};
+  auto measure = [&](std::string const& kernel, size_t bytes_moved, std::function<void(SimdLevel)> const& run) {
+    for (SimdLevel level : levels) {
+      BenchmarkResult result{kernel, simd_level_name(level), bytes_moved, 0, "host"};
+      results.push_back(collect_samples(result, repetitions, [&]() {
+        auto start = std::chrono::steady_clock::now();
+        run(level);
+        return elapsed_ms(start);
+      }));
+    }
+  };
+
+  size_t const count = pixel_count * 4;
+  std::vector<uint8_t> buffer_bytes(count);
+  std::vector<uint8_t> buffer_bytes_out(count);
+  std::vector<uint16_t> buffer_halves(count);
+  std::vector<float> buffer_floats(count);
+  std::vector<uint32_t> buffer_packed(pixel_count);
+  for (size_t i = 0; i < count; ++i) {
+    buffer_bytes[i] = uint8_t(rng());
+  }
+  unorm8_to_float(buffer_bytes.data(), buffer_floats.data(), count);
+
+  measure("unorm8_to_float", count * 5, [&](SimdLevel level) {
+    unorm8_to_float(buffer_bytes.data(), buffer_floats.data(), count, level);
+  });
+  measure("float_to_unorm8", count * 5, [&](SimdLevel level) {
+    float_to_unorm8(buffer_floats.data(), buffer_bytes_out.data(), count, level);
+  });
+  measure("float_to_half", count * 6, [&](SimdLevel level) {
+    float_to_half(buffer_floats.data(), buffer_halves.data(), count, level);
+  });
+  measure("half_to_float", count * 6, [&](SimdLevel level) {
+    half_to_float(buffer_halves.data(), buffer_floats.data(), count, level);
+  });
+  measure("srgb8_to_linear", count * 5, [&](SimdLevel level) {
+    srgb8_to_linear(buffer_bytes.data(), buffer_floats.data(), pixel_count, level);
+  });
+  measure("linear_to_srgb8", count * 5, [&](SimdLevel level) {
+    linear_to_srgb8(buffer_floats.data(), buffer_bytes_out.data(), pixel_count, level);
+  });
+  measure("pack_a2b10g10r10", count * 5, [&](SimdLevel level) {
+    pack_a2b10g10r10(buffer_floats.data(), buffer_packed.data(), pixel_count, level);
+  });
+  measure("unpack_a2b10g10r10", count * 5, [&](SimdLevel level) {
+    unpack_a2b10g10r10(buffer_packed.data(), buffer_floats.data(), pixel_count, level);
+  });
+  uint8_t const order_bgra[4] = {2, 1, 0, 3};
+  measure("swizzle_rgba8", count * 2, [&](SimdLevel level) {
+    swizzle_rgba8(buffer_bytes.data(), buffer_bytes_out.data(), pixel_count, order_bgra, level);
+  });
+  // export path of a half float readback with padded rows
+  uint32_t const width = 4096;
+  uint32_t const height = uint32_t(std::max(pixel_count / width, size_t(1)));
+  measure("convert_rgba16f_to_rgba8_srgb", size_t(width) * height * 12, [&](SimdLevel level) {
+    convert_pixels(PixelFormat::eRgba16Float, buffer_halves.data(), width * 8, PixelFormat::eRgba8Srgb, buffer_bytes_out.data(), width * 4, width, height, level);
+  });
+
+  // speedups are relative to the scalar kernels
+  std::string const baseline = simd_level_name(SimdLevel::eScalar);
+  if (json) {
+    print_json(results, {{"simd_level", simd_level_name(simd_level())}}, baseline);
+  }
+  else {
+    print_csv(results, baseline);
+  }
+  if (failures > 0) {
+    std::cerr << failures << " checks failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,295 @@
+#include "allocator.hpp"
+#include "benchmark.hpp"
+#include "handle.hpp"
+#include "init_utils.hpp"
+#include "primitives.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// measures the parallel primitives against their standard library counterparts on the host
+// every gpu result is verified against the host result, mismatches make the exit code non-zero
+// variants: subgroup operations where supported, shared memory, host (cpu)
+// usage: benchmark_primitives [max count in Mi values] [repetitions] [csv|json]
+
+// device local buffer of uint32 values
+struct DeviceBuffer {
+  Handle<vk::Buffer> buffer;
+  AllocationHandle allocation;
+};
+
+static uint32_t const bin_count = 256;
+
+static DeviceBuffer create_buffer(vk::Device const& device, Allocator& allocator, uint32_t count, MemoryUsage usage) {
+  vk::BufferCreateInfo info_buffer{};
+  info_buffer.size = vk::DeviceSize(count) * sizeof(uint32_t);
+  info_buffer.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+  DeviceBuffer buffer{};
+  buffer.buffer = Handle<vk::Buffer>{device, device.createBuffer(info_buffer)};
+  buffer.allocation = AllocationHandle{allocator, allocator.allocate(buffer.buffer.get(), usage)};
+  return buffer;
+}
+
+static bool check(std::string const& what, std::vector<uint32_t> const& result, std::vector<uint32_t> const& expected) {
+  if (result == expected) return true;
+  size_t i = 0;
+  while (i < result.size() && i < expected.size() && result[i] == expected[i]) ++i;
+  std::cerr << what << " differs from the host result at index " << i << std::endl;
+  return false;
+}
+
+int main(int argc, char* argv[]) {
+  uint32_t max_count = (argc > 1 ? uint32_t(std::stoul(argv[1])) : 16) * 1024 * 1024;
+  uint32_t repetitions = argc > 2 ? uint32_t(std::stoul(argv[2])) : 10;
+  bool json = argc > 3 && std::string{argv[3]} == "json";
+
+// create headless instance and device, subgroup operations need 1.1
+  HeadlessDevice headless = create_headless_device(VK_API_VERSION_1_1);
+  DeviceSelection const& selection = headless.selection;
+  vk::Device device = headless.device;
+  Allocator allocator{device, selection.phys_device};
+
+// shared memory variants always, subgroup variants where supported
+  std::string shader_dir = resource_path(argv[0]) + "shaders/";
+  std::vector<std::unique_ptr<Primitives>> variants{};
+  variants.emplace_back(new Primitives{device, selection.capabilities, vk::PipelineCache{}, shader_dir, false});
+  std::unique_ptr<Primitives> primitives_subgroup{new Primitives{device, selection.capabilities, vk::PipelineCache{}, shader_dir}};
+  if (primitives_subgroup->subgroups()) {
+    variants.push_back(std::move(primitives_subgroup));
+  }
+  else {
+    std::cerr << "subgroup variants not supported" << std::endl;
+  }
+
+// command buffer, fence and timestamps shared by all gpu measurements
+  BenchmarkSubmitter submitter{headless};
+  std::string clock_gpu = submitter.clock();
+
+  std::vector<BenchmarkResult> results{};
+  auto measure = [&](std::string const& primitive, std::string const& variant, uint32_t count, std::string const& clock, std::function<double()> const& run) {
+    results.push_back(collect_samples(BenchmarkResult{primitive, variant, uint64_t(count) * sizeof(uint32_t), count, clock}, repetitions, run));
+    std::cerr << primitive << " " << variant << " " << count << ": " << median(results.back().samples_ms) << "ms" << std::endl;
+  };
+
+// staging for the inputs and the verification
+  DeviceBuffer staging_upload = create_buffer(device, allocator, max_count, MemoryUsage::eUpload);
+  DeviceBuffer staging_readback = create_buffer(device, allocator, max_count, MemoryUsage::eReadback);
+  auto upload = [&](vk::Buffer const& buffer, std::vector<uint32_t> const& data) {
+    vk::DeviceSize size = data.size() * sizeof(uint32_t);
+    std::memcpy(staging_upload.allocation.get().ptr, data.data(), size);
+    allocator.flush(staging_upload.allocation.get(), 0, size);
+    submitter.submit([&](vk::CommandBuffer const& cb) {
+      cb.copyBuffer(staging_upload.buffer.get(), buffer, vk::BufferCopy{0, 0, size});
+    }, false);
+  };
+  auto download = [&](vk::Buffer const& buffer, uint32_t count) {
+    vk::DeviceSize size = vk::DeviceSize(count) * sizeof(uint32_t);
+    submitter.submit([&](vk::CommandBuffer const& cb) {
+      cb.copyBuffer(buffer, staging_readback.buffer.get(), vk::BufferCopy{0, 0, size});
+    }, false);
+    allocator.invalidate(staging_readback.allocation.get(), 0, size);
+    std::vector<uint32_t> data(count);
+    std::memcpy(data.data(), staging_readback.allocation.get().ptr, size);
+    return data;
+  };
+
+  bool verified = true;
+  std::mt19937 rng{42};
+  for (uint32_t count = 64 * 1024; count <= max_count; count *= 4) {
+    try {
+      // values stay small enough for the sums to be meaningful, keys use all bits
+      std::vector<uint32_t> values(count);
+      std::vector<uint32_t> flags(count);
+      std::vector<uint32_t> keys(count);
+      std::vector<uint32_t> indices(count);
+      for (uint32_t i = 0; i < count; ++i) {
+        values[i] = uint32_t(rng() & 0xff);
+        flags[i] = rng() % 1000 == 0 ? 1u : 0u;
+        keys[i] = uint32_t(rng());
+        indices[i] = i;
+      }
+
+// host baselines, their results are the references
+      std::vector<uint32_t> reduced(1);
+      measure("reduce", "cpu", count, "host", [&]() {
+        auto start = std::chrono::steady_clock::now();
+        reduced[0] = std::accumulate(values.begin(), values.end(), 0u);
+        return elapsed_ms(start);
+      });
+      std::vector<uint32_t> scanned_inclusive(count);
+      measure("inclusive_scan", "cpu", count, "host", [&]() {
+        auto start = std::chrono::steady_clock::now();
+        std::partial_sum(values.begin(), values.end(), scanned_inclusive.begin());
+        return elapsed_ms(start);
+      });
+      std::vector<uint32_t> scanned_exclusive(count);
+      measure("exclusive_scan", "cpu", count, "host", [&]() {
+        auto start = std::chrono::steady_clock::now();
+        uint32_t sum = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+          scanned_exclusive[i] = sum;
+          sum += values[i];
+        }
+        return elapsed_ms(start);
+      });
+      std::vector<uint32_t> scanned_segmented(count);
+      measure("segmented_scan", "cpu", count, "host", [&]() {
+        auto start = std::chrono::steady_clock::now();
+        uint32_t sum = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+          sum = flags[i] ? values[i] : sum + values[i];
+          scanned_segmented[i] = sum;
+        }
+        return elapsed_ms(start);
+      });
+      // std::sort is not stable, the reference comes from std::stable_sort
+      std::vector<std::pair<uint32_t, uint32_t>> pairs(count);
+      measure("sort_pairs", "cpu", count, "host", [&]() {
+        for (uint32_t i = 0; i < count; ++i) {
+          pairs[i] = std::make_pair(keys[i], i);
+        }
+        auto start = std::chrono::steady_clock::now();
+        std::sort(pairs.begin(), pairs.end(), [](std::pair<uint32_t, uint32_t> const& a, std::pair<uint32_t, uint32_t> const& b) {
+          return a.first < b.first;
+        });
+        return elapsed_ms(start);
+      });
+      for (uint32_t i = 0; i < count; ++i) {
+        pairs[i] = std::make_pair(keys[i], i);
+      }
+      std::stable_sort(pairs.begin(), pairs.end(), [](std::pair<uint32_t, uint32_t> const& a, std::pair<uint32_t, uint32_t> const& b) {
+        return a.first < b.first;
+      });
+      std::vector<uint32_t> sorted_keys(count);
+      std::vector<uint32_t> sorted_values(count);
+      for (uint32_t i = 0; i < count; ++i) {
+        sorted_keys[i] = pairs[i].first;
+        sorted_values[i] = pairs[i].second;
+      }
+      // bins of the highest key byte
+      std::vector<uint32_t> bins(bin_count);
+      measure("histogram", "cpu", count, "host", [&]() {
+        auto start = std::chrono::steady_clock::now();
+        std::fill(bins.begin(), bins.end(), 0u);
+        for (uint32_t i = 0; i < count; ++i) {
+          ++bins[keys[i] >> 24];
+        }
+        return elapsed_ms(start);
+      });
+
+// device buffers, sort inputs are restored from the sources before each run
+      DeviceBuffer buffer_values = create_buffer(device, allocator, count, MemoryUsage::eDeviceLocal);
+      DeviceBuffer buffer_flags = create_buffer(device, allocator, count, MemoryUsage::eDeviceLocal);
+      DeviceBuffer buffer_keys_source = create_buffer(device, allocator, count, MemoryUsage::eDeviceLocal);
+      DeviceBuffer buffer_indices = create_buffer(device, allocator, count, MemoryUsage::eDeviceLocal);
+      DeviceBuffer buffer_keys = create_buffer(device, allocator, count, MemoryUsage::eDeviceLocal);
+      DeviceBuffer buffer_sorted_values = create_buffer(device, allocator, count, MemoryUsage::eDeviceLocal);
+      DeviceBuffer buffer_output = create_buffer(device, allocator, count, MemoryUsage::eDeviceLocal);
+      DeviceBuffer buffer_bins = create_buffer(device, allocator, bin_count, MemoryUsage::eDeviceLocal);
+      upload(buffer_values.buffer.get(), values);
+      upload(buffer_flags.buffer.get(), flags);
+      upload(buffer_keys_source.buffer.get(), keys);
+      upload(buffer_indices.buffer.get(), indices);
+      auto restore_pairs = [&]() {
+        submitter.submit([&](vk::CommandBuffer const& cb) {
+          vk::BufferCopy region{0, 0, vk::DeviceSize(count) * sizeof(uint32_t)};
+          cb.copyBuffer(buffer_keys_source.buffer.get(), buffer_keys.buffer.get(), region);
+          cb.copyBuffer(buffer_indices.buffer.get(), buffer_sorted_values.buffer.get(), region);
+        }, false);
+      };
+
+      for (auto const& primitives : variants) {
+        std::string variant = primitives->subgroups() ? "subgroup" : "shared";
+        PrimitiveBatch batch{*primitives, allocator};
+        auto run_batch = [&]() {
+          return submitter.submit([&](vk::CommandBuffer const& cb) {
+            batch.record(cb);
+          }, true);
+        };
+        std::string what = variant + " " + std::to_string(count) + " ";
+
+        batch.reduce(buffer_values.buffer.get(), count, buffer_output.buffer.get());
+        measure("reduce", variant, count, clock_gpu, run_batch);
+        verified &= check(what + "reduce", download(buffer_output.buffer.get(), 1), reduced);
+        batch.clear();
+
+        batch.inclusive_scan(buffer_values.buffer.get(), buffer_output.buffer.get(), count);
+        measure("inclusive_scan", variant, count, clock_gpu, run_batch);
+        verified &= check(what + "inclusive_scan", download(buffer_output.buffer.get(), count), scanned_inclusive);
+        batch.clear();
+
+        batch.exclusive_scan(buffer_values.buffer.get(), buffer_output.buffer.get(), count);
+        measure("exclusive_scan", variant, count, clock_gpu, run_batch);
+        verified &= check(what + "exclusive_scan", download(buffer_output.buffer.get(), count), scanned_exclusive);
+        batch.clear();
+
+        batch.segmented_scan(buffer_values.buffer.get(), buffer_flags.buffer.get(), buffer_output.buffer.get(), count, true);
+        measure("segmented_scan", variant, count, clock_gpu, run_batch);
+        verified &= check(what + "segmented_scan", download(buffer_output.buffer.get(), count), scanned_segmented);
+        batch.clear();
+
+        batch.sort_pairs(buffer_keys.buffer.get(), buffer_sorted_values.buffer.get(), count);
+        measure("sort_pairs", variant, count, clock_gpu, [&]() {
+          restore_pairs();
+          return run_batch();
+        });
+        verified &= check(what + "sort_pairs keys", download(buffer_keys.buffer.get(), count), sorted_keys);
+        verified &= check(what + "sort_pairs values", download(buffer_sorted_values.buffer.get(), count), sorted_values);
+        batch.clear();
+
+        batch.histogram(buffer_keys_source.buffer.get(), count, buffer_bins.buffer.get(), bin_count, 0, 1u << 24);
+        measure("histogram", variant, count, clock_gpu, run_batch);
+        verified &= check(what + "histogram", download(buffer_bins.buffer.get(), bin_count), bins);
+        batch.clear();
+
+        // all of the above in one command buffer, without host round trips in between
+        batch.histogram(buffer_keys_source.buffer.get(), count, buffer_bins.buffer.get(), bin_count, 0, 1u << 24);
+        batch.sort_pairs(buffer_keys.buffer.get(), buffer_sorted_values.buffer.get(), count);
+        batch.segmented_scan(buffer_values.buffer.get(), buffer_flags.buffer.get(), buffer_output.buffer.get(), count, true);
+        batch.reduce(buffer_output.buffer.get(), count, buffer_output.buffer.get(), 0, ScanOp::eMax);
+        measure("chained", variant, count, clock_gpu, [&]() {
+          restore_pairs();
+          return run_batch();
+        });
+        verified &= check(what + "chained", download(buffer_output.buffer.get(), 1),
+          std::vector<uint32_t>{*std::max_element(scanned_segmented.begin(), scanned_segmented.end())});
+        batch.clear();
+      }
+    }
+    catch (std::exception const& e) {
+      std::cerr << "skipping " << count << ": " << e.what() << std::endl;
+    }
+  }
+
+  // speedups are relative to the host baselines
+  if (json) {
+    print_json(results, {{"device", selection.capabilities.name}}, "cpu");
+  }
+  else {
+    print_csv(results, "cpu");
+  }
+  if (!verified) {
+    std::cerr << "verification failed" << std::endl;
+  }
+
+  staging_upload = DeviceBuffer{};
+  staging_readback = DeviceBuffer{};
+  submitter = {};
+  variants.clear();
+  primitives_subgroup.reset();
+  allocator = {};
+  destroy_headless_device(headless);
+
+  return verified ? 0 : 1;
+}
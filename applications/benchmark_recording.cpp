@@ -0,0 +1,103 @@
+#include "allocator.hpp"
+#include "benchmark.hpp"
+#include "bring_up.hpp"
+#include "handle.hpp"
+#include "job_system.hpp"
+#include "parallel_recorder.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// compares single threaded command recording with the ParallelRecorder
+// usage: benchmark_recording [command count] [repetitions] [csv|json]
+
+int main(int argc, char* argv[]) {
+  uint32_t command_count = argc > 1 ? uint32_t(std::stoul(argv[1])) : 100000;
+  uint32_t repetitions = argc > 2 ? uint32_t(std::stoul(argv[2])) : 5;
+  bool json = argc > 3 && std::string{argv[3]} == "json";
+
+// create headless instance and device
+  HeadlessDevice headless = create_headless_device();
+  DeviceSelection const& selection = headless.selection;
+  vk::Device device = headless.device;
+  vk::DispatchLoaderDynamic const& dispatch = device_dispatch(device);
+
+// target of the recorded commands
+  Allocator allocator{device, selection.phys_device};
+  vk::BufferCreateInfo info_buffer{};
+  info_buffer.size = 64 * 1024;
+  info_buffer.usage = vk::BufferUsageFlagBits::eTransferDst;
+  Handle<vk::Buffer> buffer{device, device.createBuffer(info_buffer, nullptr, dispatch)};
+  AllocationHandle allocation_buffer{allocator, allocator.allocate(buffer.get(), MemoryUsage::eDeviceLocal)};
+  vk::DeviceSize const slots = info_buffer.size / 4;
+
+  auto record_range = [&](vk::CommandBuffer const& command_buffer, uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; ++i) {
+      command_buffer.fillBuffer(buffer.get(), (i % slots) * 4, 4, i, dispatch);
+    }
+  };
+
+// primary command buffer, only recorded and never submitted
+  BenchmarkSubmitter submitter{headless};
+  vk::CommandBuffer primary = submitter.command_buffer();
+  vk::CommandBufferBeginInfo info_cb_begin{};
+  info_cb_begin.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+
+  std::vector<BenchmarkResult> results{};
+  // recycle runs untimed once the primary no longer references the recorded buffers
+  auto measure = [&](std::string const& variant, std::function<void()> const& record, std::function<void()> const& recycle) {
+    results.push_back(collect_samples(BenchmarkResult{"record_fill", variant, 0, command_count, "host"}, repetitions, [&]() {
+      auto start = std::chrono::steady_clock::now();
+      primary.begin(info_cb_begin, dispatch);
+      record();
+      primary.end(dispatch);
+      double time = elapsed_ms(start);
+      primary.reset(vk::CommandBufferResetFlags{}, dispatch);
+      recycle();
+      return time;
+    }));
+    std::cerr << variant << ": " << median(results.back().samples_ms) << "ms" << std::endl;
+  };
+
+// single threaded baseline
+  measure("single", [&]() {
+    record_range(primary, 0, command_count);
+  }, []() {});
+
+// parallel recording with increasing worker counts
+  uint32_t max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  for (uint32_t threads = 1; threads <= max_threads; threads *= 2) {
+    JobSystem jobs{threads};
+    ParallelRecorder recorder{device, selection.queue_family, jobs};
+    // several chunks per worker to let stealing balance the load
+    uint32_t chunk_size = std::max(command_count / (threads * 8), 256u);
+    measure("threads_" + std::to_string(threads), [&]() {
+      recorder.record(primary, command_count, chunk_size, record_range);
+    }, [&]() {
+      recorder.reset();
+    });
+  }
+
+  // speedups are relative to recording on a single thread
+  if (json) {
+    print_json(results, {{"device", selection.capabilities.name}}, "single");
+  }
+  else {
+    print_csv(results, "single");
+  }
+
+  buffer = {};
+  allocation_buffer = {};
+  submitter = {};
+  allocator = {};
+  destroy_headless_device(headless);
+
+  return 0;
+}
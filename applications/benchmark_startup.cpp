@@ -0,0 +1,261 @@
+#include "allocator.hpp"
+#include "benchmark.hpp"
+#include "bring_up.hpp"
+#include "debug_reporter.hpp"
+#include "device_selector.hpp"
+#include "handle.hpp"
+#include "scheduler.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// per-call cost of recording through vulkan.hpp compared to the device dispatch table
+// configurations:
+//  legacy      validation always on, extensions enumerated on every query, no device cache, loader calls
+//  validation  bring-up with validation opted in
+//  default     bring-up without validation, with device cache and dispatch table
+// usage: benchmark_startup [repetitions] [calls] [csv|json]
+
+struct StageTimes {
+  double instance_ms;
+  double select_ms;
+  double device_ms;
+  double submit_ms;
+};
+
+// instance creation as the sample did it before the bring-up module
+static vk::Instance create_instance_legacy() {
+  std::vector<char const*> layers{};
+  for (auto const& layer : vk::enumerateInstanceLayerProperties()) {
+    for (auto name : {"VK_LAYER_KHRONOS_validation", "VK_LAYER_LUNARG_standard_validation"}) {
+      if (layers.empty() && std::string{layer.layerName} == name) {
+        layers.push_back(name);
+      }
+    }
+  }
+  std::vector<char const*> extensions{};
+  for (auto const& extension : vk::enumerateInstanceExtensionProperties()) {
+    if (std::string{extension.extensionName} == VK_EXT_DEBUG_UTILS_EXTENSION_NAME) {
+      extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    }
+  }
+  if (extensions.empty()) {
+    extensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+  }
+  vk::ApplicationInfo info_app{};
+  info_app.apiVersion = VK_API_VERSION_1_0;
+  vk::InstanceCreateInfo info_instance{};
+  info_instance.pApplicationInfo = &info_app;
+  info_instance.enabledLayerCount = uint32_t(layers.size());
+  info_instance.ppEnabledLayerNames = layers.data();
+  info_instance.enabledExtensionCount = uint32_t(extensions.size());
+  info_instance.ppEnabledExtensionNames = extensions.data();
+  return vk::createInstance(info_instance);
+}
+
+// brings up instance and device and waits for an empty submission
+static StageTimes bring_up(std::string const& config, std::string const& cache_path) {
+  StageTimes times{};
+  bool const legacy = config == "legacy";
+  bool const validation = config != "default";
+
+  auto start = std::chrono::steady_clock::now();
+  vk::Instance instance = legacy ? create_instance_legacy() : create_instance({}, validation);
+  DebugReporter debug_reporter = validation ? DebugReporter{instance} : DebugReporter{};
+  times.instance_ms = elapsed_ms(start);
+
+  start = std::chrono::steady_clock::now();
+  DeviceSelection selection = DeviceSelector{instance, VK_API_VERSION_1_0, legacy ? "" : cache_path}.select();
+  times.select_ms = elapsed_ms(start);
+
+  start = std::chrono::steady_clock::now();
+  vk::Device device{};
+  if (legacy) {
+    std::vector<vk::DeviceQueueCreateInfo> infos_queue = selection.queue_infos();
+    vk::DeviceCreateInfo info_device{};
+    info_device.queueCreateInfoCount = uint32_t(infos_queue.size());
+    info_device.pQueueCreateInfos = infos_queue.data();
+    device = selection.phys_device.createDevice(info_device);
+  }
+  else {
+    device = create_device(selection);
+  }
+  times.device_ms = elapsed_ms(start);
+
+  start = std::chrono::steady_clock::now();
+  {
+    Scheduler scheduler{device, selection.queue_family, device.getQueue(selection.queue_family, 0), 1};
+    scheduler.begin_frame();
+    scheduler.end_job(scheduler.begin_job());
+    scheduler.end_frame();
+    scheduler.wait_idle();
+  }
+  times.submit_ms = elapsed_ms(start);
+
+  // also releases the table the scheduler loaded for the legacy device
+  destroy_device(device);
+  debug_reporter = {};
+  instance.destroy();
+  return times;
+}
+
+int main(int argc, char* argv[]) {
+  std::string const cache_path = std::string{argv[0]} + ".device_cache";
+  // single bring-up in a fresh process, timed by the parent
+  if (argc > 2 && std::string{argv[1]} == "--bring-up") {
+    bring_up(argv[2], cache_path);
+    return 0;
+  }
+  uint32_t repetitions = argc > 1 ? uint32_t(std::stoul(argv[1])) : 10;
+  uint32_t calls = argc > 2 ? uint32_t(std::stoul(argv[2])) : 100000;
+  bool json = argc > 3 && std::string{argv[3]} == "json";
+
+  std::vector<BenchmarkResult> results{};
+  std::vector<std::string> const configs{"legacy", "validation", "default"};
+  if (validation_layer().empty()) {
+    std::cerr << "no validation layer installed, legacy and validation configs run without it" << std::endl;
+  }
+
+  // whole processes, including loader initialization and driver loading
+  for (auto const& config : configs) {
+    BenchmarkResult result{"process_to_first_submit", config, 0, 1, "host"};
+    std::string command = "\"" + std::string{argv[0]} + "\" --bring-up " + config;
+    // first run creates the device cache and warms the file system
+    if (std::system(command.c_str()) != 0) {
+      std::cerr << "bring-up of " << config << " failed" << std::endl;
+      return 1;
+    }
+    for (uint32_t r = 0; r < repetitions; ++r) {
+      auto start = std::chrono::steady_clock::now();
+      if (std::system(command.c_str()) != 0) {
+        std::cerr << "bring-up of " << config << " failed" << std::endl;
+        return 1;
+      }
+      result.samples_ms.push_back(elapsed_ms(start));
+    }
+    results.push_back(result);
+  }
+
+  // stages within this process, the loader stays initialized between runs
+  for (auto const& config : configs) {
+    std::vector<BenchmarkResult> stages{
+      {"instance", config, 0, 1, "host"},
+      {"select_device", config, 0, 1, "host"},
+      {"create_device", config, 0, 1, "host"},
+      {"first_submit", config, 0, 1, "host"},
+      {"bring_up_total", config, 0, 1, "host"}
+    };
+    for (uint32_t r = 0; r < repetitions; ++r) {
+      StageTimes times = bring_up(config, cache_path);
+      stages[0].samples_ms.push_back(times.instance_ms);
+      stages[1].samples_ms.push_back(times.select_ms);
+      stages[2].samples_ms.push_back(times.device_ms);
+      stages[3].samples_ms.push_back(times.submit_ms);
+      stages[4].samples_ms.push_back(times.instance_ms + times.select_ms + times.device_ms + times.submit_ms);
+    }
+    results.insert(results.end(), stages.begin(), stages.end());
+  }
+
+  // extension queries, repeated enumeration compared to the process cache
+  {
+    BenchmarkResult uncached{"enumerate_instance_extensions", "legacy", 0, 1, "host"};
+    BenchmarkResult cached{"enumerate_instance_extensions", "default", 0, 1, "host"};
+    for (uint32_t r = 0; r < repetitions; ++r) {
+      auto start = std::chrono::steady_clock::now();
+      vk::enumerateInstanceExtensionProperties();
+      uncached.samples_ms.push_back(elapsed_ms(start));
+      start = std::chrono::steady_clock::now();
+      instance_extension_supported(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+      cached.samples_ms.push_back(elapsed_ms(start));
+    }
+    results.push_back(uncached);
+    results.push_back(cached);
+  }
+
+  // per-call overhead of recording through the loader and through the device table
+  HeadlessDevice headless = create_headless_device();
+  DeviceSelection const& selection = headless.selection;
+  vk::Device device = headless.device;
+  {
+    vk::DispatchLoaderDynamic const& dispatch = device_dispatch(device);
+    Allocator allocator{device, selection.phys_device};
+    vk::BufferCreateInfo info_buffer{};
+    info_buffer.size = 64 * 1024;
+    info_buffer.usage = vk::BufferUsageFlagBits::eTransferDst;
+    Handle<vk::Buffer> buffer{device, device.createBuffer(info_buffer)};
+    AllocationHandle allocation_buffer{allocator, allocator.allocate(buffer.get(), MemoryUsage::eDeviceLocal)};
+    vk::DeviceSize const slots = info_buffer.size / 4;
+
+    vk::CommandPoolCreateInfo info_command_pool{};
+    info_command_pool.queueFamilyIndex = selection.queue_family;
+    info_command_pool.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+    Handle<vk::CommandPool> command_pool{device, device.createCommandPool(info_command_pool)};
+    vk::CommandBufferAllocateInfo info_command_buffer{};
+    info_command_buffer.commandPool = command_pool.get();
+    info_command_buffer.level = vk::CommandBufferLevel::ePrimary;
+    info_command_buffer.commandBufferCount = 1;
+    vk::CommandBuffer command_buffer = device.allocateCommandBuffers(info_command_buffer).front();
+    vk::CommandBufferBeginInfo info_cb_begin{};
+    info_cb_begin.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+
+    vk::MemoryBarrier barrier{};
+    barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+
+    auto measure = [&](std::string const& measurement, std::string const& config, std::function<void()> const& record) {
+      BenchmarkResult result{measurement, config, 0, calls, "host"};
+      for (uint32_t r = 0; r < repetitions; ++r) {
+        command_buffer.begin(info_cb_begin);
+        auto start = std::chrono::steady_clock::now();
+        record();
+        result.samples_ms.push_back(elapsed_ms(start));
+        command_buffer.end();
+        command_buffer.reset(vk::CommandBufferResetFlags{});
+      }
+      results.push_back(result);
+    };
+
+    measure("fill_buffer", "legacy", [&]() {
+      for (uint32_t i = 0; i < calls; ++i) {
+        command_buffer.fillBuffer(buffer.get(), (i % slots) * 4, 4, i);
+      }
+    });
+    measure("fill_buffer", "default", [&]() {
+      for (uint32_t i = 0; i < calls; ++i) {
+        command_buffer.fillBuffer(buffer.get(), (i % slots) * 4, 4, i, dispatch);
+      }
+    });
+    measure("pipeline_barrier", "legacy", [&]() {
+      for (uint32_t i = 0; i < calls; ++i) {
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags{}, barrier, {}, {});
+      }
+    });
+    measure("pipeline_barrier", "default", [&]() {
+      for (uint32_t i = 0; i < calls; ++i) {
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags{}, barrier, {}, {}, dispatch);
+      }
+    });
+
+    buffer = {};
+    allocation_buffer = {};
+    command_pool = {};
+    allocator = {};
+  }
+  destroy_headless_device(headless);
+
+  // speedups are relative to the configuration without any of the bring-up changes
+  if (json) {
+    print_json(results, {}, "legacy");
+  }
+  else {
+    print_csv(results, "legacy");
+  }
+  return 0;
+}
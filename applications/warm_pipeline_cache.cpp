@@ -0,0 +1,93 @@
+#include "benchmark.hpp"
+#include "compute_pipeline.hpp"
+#include "init_utils.hpp"
+#include "pipeline_cache.hpp"
+#include "pipeline_table.hpp"
+#include "primitives.hpp"
+#include "shader.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// builds the pipelines of the sample and of the parallel primitives into a persistent cache,
+// with the specializations they are created with, and compares creation with an empty cache
+// usage: warm_pipeline_cache [cache file] [shader directory]
+
+// shader, workgroup size and constants, e.g. scan 256x0x0 1=0 2=1
+static std::string pipeline_label(PipelineParameters const& parameters) {
+  std::string label = parameters.shader + " " + std::to_string(parameters.workgroup_size.x) + "x"
+    + std::to_string(parameters.workgroup_size.y) + "x" + std::to_string(parameters.workgroup_size.z);
+  for (auto const& constant : parameters.constants) {
+    label += " " + std::to_string(constant.first) + "=" + std::to_string(constant.second);
+  }
+  return label;
+}
+
+int main(int argc, char* argv[]) {
+  // defaults to the cache and shaders of the sample next to this executable
+  std::string path_cache = argc > 1 ? argv[1] : resource_path(argv[0]) + "pipeline_cache.bin";
+  std::string shader_dir = argc > 2 ? argv[2] : resource_path(argv[0]) + "shaders/";
+
+// device chosen like the sample does, subgroup variants of the primitives need 1.1
+  HeadlessDevice headless = create_headless_device(VK_API_VERSION_1_1);
+  vk::Device device = headless.device;
+  DeviceCapabilities const& capabilities = headless.selection.capabilities;
+
+// parameters of every pipeline the sample and the primitives create on this device
+  std::vector<PipelineParameters> pipelines{sample_pipelines()};
+  for (bool use_subgroups : {false, true}) {
+    Primitives primitives{device, capabilities, vk::PipelineCache{}, shader_dir, use_subgroups};
+    if (use_subgroups && !primitives.subgroups()) continue;
+    std::vector<PipelineParameters> parameters = primitives.pipeline_parameters();
+    pipelines.insert(pipelines.end(), parameters.begin(), parameters.end());
+  }
+  // shaders are loaded up front to time pipeline creation alone
+  std::map<std::string, Shader> shaders{};
+  for (auto const& parameters : pipelines) {
+    if (!shaders.count(parameters.shader)) {
+      shaders.emplace(parameters.shader, load_shader(device, shader_dir, parameters.shader));
+    }
+  }
+  auto create = [&](PipelineParameters const& parameters, vk::PipelineCache const& cache) {
+    auto start = std::chrono::steady_clock::now();
+    ComputePipeline pipeline{device, shaders.at(parameters.shader), cache, parameters.workgroup_size, parameters.constants, 1};
+    return elapsed_ms(start);
+  };
+
+// reference timing without any cached data
+  std::vector<double> times_cold{};
+  vk::PipelineCache cache_empty = device.createPipelineCache(vk::PipelineCacheCreateInfo{});
+  for (auto const& parameters : pipelines) {
+    times_cold.push_back(create(parameters, cache_empty));
+  }
+  device.destroyPipelineCache(cache_empty);
+
+// build into the persistent cache, saved on destruction
+  std::vector<double> times_cache{};
+  PipelineCache pipeline_cache{device, headless.selection.phys_device, path_cache};
+  for (auto const& parameters : pipelines) {
+    times_cache.push_back(create(parameters, pipeline_cache.get()));
+  }
+
+  std::string cache_state = pipeline_cache.warm() ? "warm" : "cold";
+  double total_cold = 0.0;
+  double total_cache = 0.0;
+  std::cout << "pipeline,empty_ms,cache_ms,cache_state" << std::endl;
+  for (size_t i = 0; i < pipelines.size(); ++i) {
+    std::cout << pipeline_label(pipelines[i]) << "," << times_cold[i] << "," << times_cache[i] << "," << cache_state << std::endl;
+    total_cold += times_cold[i];
+    total_cache += times_cache[i];
+  }
+  std::cout << "total " << pipelines.size() << "," << total_cold << "," << total_cache << "," << cache_state << std::endl;
+
+  pipeline_cache = {};
+  shaders.clear();
+  destroy_headless_device(headless);
+
+  return 0;
+}
@@ -0,0 +1,118 @@
+# compiles a single shader, invoked through cmake -P by compile_shaders
+# results are stored in a content addressed cache, the key is the
+# preprocessed source, so changes to comments or unrelated files are hits
+##############################################################################
+#input variables
+# GLSLANG - path to glslangValidator
+# SPIRV_OPT - path to spirv-opt, empty to skip optimization
+# SOURCE - shader to compile
+# OUTPUT - compiled SPIR-V file
+# FLAGS - glslang arguments, separated by '|'
+# OPT_FLAGS - spirv-opt arguments, separated by '|'
+# CACHE_DIR - directory of the shader cache
+# TOOL_HASH - hash of the tool versions, part of the cache key
+# GLSLANG_DEPFILE - whether glslang supports --depfile
+# DEPFILE - depfile to write (optional)
+# EMBED_HEADER - header to write the SPIR-V words to (optional)
+# EMBED_NAME - name of the array in the embedded header
+##############################################################################
+string(REPLACE "|" ";" FLAGS "${FLAGS}")
+string(REPLACE "|" ";" OPT_FLAGS "${OPT_FLAGS}")
+
+# preprocess to hash the shader together with all included files
+execute_process(
+  COMMAND ${GLSLANG} ${FLAGS} -E ${SOURCE}
+  OUTPUT_VARIABLE _PREPROCESSED
+  ERROR_VARIABLE _ERRORS
+  RESULT_VARIABLE _RESULT
+)
+if(NOT _RESULT EQUAL 0)
+  message(FATAL_ERROR "Preprocessing \"${SOURCE}\" failed:\n${_PREPROCESSED}${_ERRORS}")
+endif()
+string(SHA256 _HASH "${TOOL_HASH}|${FLAGS}|${SPIRV_OPT}|${OPT_FLAGS}|${_PREPROCESSED}")
+set(_CACHED ${CACHE_DIR}/${_HASH}.spv)
+set(_CACHED_DEPS ${CACHE_DIR}/${_HASH}.deps)
+
+if(NOT EXISTS ${_CACHED})
+  file(MAKE_DIRECTORY ${CACHE_DIR})
+  # unique per output, the same shader may be built by several commands at once
+  string(MD5 _TMP_NAME ${OUTPUT})
+  set(_TMP ${CACHE_DIR}/${_HASH}.${_TMP_NAME})
+  set(_DEPFILE_ARGS)
+  if(GLSLANG_DEPFILE)
+    set(_DEPFILE_ARGS --depfile ${_TMP}.d)
+  endif()
+
+  execute_process(
+    COMMAND ${GLSLANG} -V ${FLAGS} ${_DEPFILE_ARGS} ${SOURCE} -o ${_TMP}.spv
+    OUTPUT_VARIABLE _OUTPUT
+    ERROR_VARIABLE _ERRORS
+    RESULT_VARIABLE _RESULT
+  )
+  if(NOT _RESULT EQUAL 0)
+    message(FATAL_ERROR "Compiling \"${SOURCE}\" failed:\n${_OUTPUT}${_ERRORS}")
+  endif()
+
+  if(SPIRV_OPT)
+    execute_process(
+      COMMAND ${SPIRV_OPT} ${OPT_FLAGS} ${_TMP}.spv -o ${_TMP}.opt.spv
+      OUTPUT_VARIABLE _OUTPUT
+      ERROR_VARIABLE _ERRORS
+      RESULT_VARIABLE _RESULT
+    )
+    if(NOT _RESULT EQUAL 0)
+      message(FATAL_ERROR "Optimizing \"${SOURCE}\" failed:\n${_OUTPUT}${_ERRORS}")
+    endif()
+    file(RENAME ${_TMP}.opt.spv ${_TMP}.spv)
+  endif()
+
+  # keep dependencies without target, so hits can write depfiles for any output
+  # the separator is ": ", windows drive letters are followed by a slash
+  if(EXISTS ${_TMP}.d)
+    file(READ ${_TMP}.d _DEPS)
+    string(FIND "${_DEPS}" ": " _SEPARATOR)
+    if(_SEPARATOR GREATER -1)
+      math(EXPR _SEPARATOR "${_SEPARATOR} + 2")
+      string(SUBSTRING "${_DEPS}" ${_SEPARATOR} -1 _DEPS)
+      file(WRITE ${_CACHED_DEPS} "${_DEPS}")
+    endif()
+    file(REMOVE ${_TMP}.d)
+  endif()
+  # publish entry last, so interrupted builds never leave partial entries
+  file(RENAME ${_TMP}.spv ${_CACHED})
+endif()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy ${_CACHED} ${OUTPUT})
+
+if(DEPFILE)
+  if(EXISTS ${_CACHED_DEPS})
+    file(READ ${_CACHED_DEPS} _DEPS)
+  else()
+    set(_DEPS "${SOURCE}\n")
+  endif()
+  file(WRITE ${DEPFILE} "${OUTPUT}: ${_DEPS}")
+endif()
+
+if(EMBED_HEADER)
+  # SPIR-V is little endian, swap bytes of every word
+  file(READ ${OUTPUT} _HEX HEX)
+  string(REGEX REPLACE "([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])" "0x\\4\\3\\2\\1u, " _WORDS "${_HEX}")
+  string(REGEX REPLACE "((0x[0-9a-f]+u, ){8})" "\\1\n  " _WORDS "${_WORDS}")
+  string(REGEX REPLACE "[ \n]+$" "" _WORDS "${_WORDS}")
+  string(TOUPPER ${EMBED_NAME} _GUARD)
+  file(WRITE ${EMBED_HEADER}
+"// generated from ${SOURCE}, do not edit
+#ifndef SHADERS_${_GUARD}_HPP
+#define SHADERS_${_GUARD}_HPP
+
+#include <cstdint>
+
+namespace shaders {
+constexpr uint32_t ${EMBED_NAME}[] = {
+  ${_WORDS}
+};
+}
+
+#endif
+")
+endif()
@@ -1,52 +1,196 @@
 # compile shaders with glslangValidator from VulkanSDK
+# outputs are named <file>.spv, e.g. fill.comp -> fill.comp.spv
+# includes are tracked with depfiles where glslang and the generator support
+# them, otherwise by scanning the sources at configure time
+# a shader can pass extra arguments to glslang with a comment line
+#   // glslang: --target-env vulkan1.1
 ##############################################################################
 #input variables
-# DIR_IN - relative path to shader directory 
+# DIR_IN - relative path to shader directory
 # DIR_INSTALL - install folder (if not specified, mirrors input dir)
+#output variables
+# SHADER_OUTPUTS - compiled shaders
+# SHADER_EMBED_DIR - include directory of embedded shader headers
+#options
+# SHADER_OPTIMIZE - run spirv-opt with SHADER_OPT_FLAGS
+# SHADER_EMBED - generate shaders/<file>_<ext>.hpp with constexpr SPIR-V arrays
+# SHADER_CACHE_DIR - content addressed cache, can be shared between builds
 #env variables
 # VULKAN_SDK - path to SDK containing glslangvalidator
 ##############################################################################
 cmake_minimum_required(VERSION 2.8)
 
+find_program(GLSLANG_VALIDATOR glslangValidator HINTS "$ENV{VULKAN_SDK}/bin" "$ENV{VULKAN_SDK}/Bin")
+find_program(SPIRV_OPT spirv-opt HINTS "$ENV{VULKAN_SDK}/bin" "$ENV{VULKAN_SDK}/Bin")
+
+option(SHADER_OPTIMIZE "Optimize shaders with spirv-opt" ON)
+option(SHADER_EMBED "Generate headers containing the compiled shaders" OFF)
+set(SHADER_OPT_FLAGS "-O" CACHE STRING "Arguments for spirv-opt")
+set(SHADER_CACHE_DIR "${PROJECT_BINARY_DIR}/shader_cache" CACHE PATH "Directory for cached shader binaries")
+
+set(_COMPILE_SHADER_SCRIPT ${CMAKE_CURRENT_LIST_DIR}/CompileShader.cmake)
+# files with these extensions are compiled, others are treated as includes
+set(_SHADER_STAGES vert tesc tese geom frag comp)
+
+# collects files included by a shader, used when depfiles are unavailable
+function(shader_includes SHADER INCLUDE_DIR OUT_VAR)
+  set(_QUEUE ${SHADER})
+  set(_FOUND)
+  while(_QUEUE)
+    list(GET _QUEUE 0 _CURRENT)
+    list(REMOVE_AT _QUEUE 0)
+    get_filename_component(_CURRENT_DIR ${_CURRENT} PATH)
+    file(STRINGS ${_CURRENT} _LINES REGEX "^[ \t]*#[ \t]*include[ \t]*[\"<]")
+    foreach(_LINE ${_LINES})
+      string(REGEX REPLACE "^[ \t]*#[ \t]*include[ \t]*[\"<]([^\">]+)[\">].*$" "\\1" _NAME "${_LINE}")
+      foreach(_DIR ${_CURRENT_DIR} ${INCLUDE_DIR})
+        if(EXISTS ${_DIR}/${_NAME})
+          get_filename_component(_INCLUDE ${_DIR}/${_NAME} ABSOLUTE)
+          list(FIND _FOUND ${_INCLUDE} _INDEX)
+          if(_INDEX LESS 0)
+            list(APPEND _FOUND ${_INCLUDE})
+            list(APPEND _QUEUE ${_INCLUDE})
+          endif()
+          break()
+        endif()
+      endforeach()
+    endforeach()
+  endwhile()
+  set(${OUT_VAR} ${_FOUND} PARENT_SCOPE)
+endfunction()
+
 MACRO(compile_shaders DIR_IN)
+if(NOT GLSLANG_VALIDATOR)
+  message(FATAL_ERROR "glslangValidator not found, set VULKAN_SDK or GLSLANG_VALIDATOR")
+endif()
 # get list of shaders
 file(GLOB SHADERS "${DIR_IN}/*")
+get_filename_component(_DIR_SRC ${DIR_IN} ABSOLUTE)
 
 string(CONCAT _DIR_OUT ${PROJECT_BINARY_DIR} "/" ${DIR_IN} "/")
+set(SHADER_EMBED_DIR ${_DIR_OUT}include)
 # create folder for compiled shaders
 file(MAKE_DIRECTORY ${_DIR_OUT})
+if(SHADER_EMBED)
+  file(MAKE_DIRECTORY ${SHADER_EMBED_DIR}/shaders)
+endif()
+
+# tool versions invalidate the cache
+execute_process(COMMAND ${GLSLANG_VALIDATOR} -v OUTPUT_VARIABLE _GLSLANG_VERSION ERROR_QUIET)
+set(_SPIRV_OPT)
+set(_SPIRV_OPT_VERSION)
+if(SHADER_OPTIMIZE AND SPIRV_OPT)
+  set(_SPIRV_OPT ${SPIRV_OPT})
+  execute_process(COMMAND ${SPIRV_OPT} --version OUTPUT_VARIABLE _SPIRV_OPT_VERSION ERROR_QUIET)
+elseif(SHADER_OPTIMIZE)
+  message(STATUS "spirv-opt not found, shaders are not optimized")
+endif()
+string(MD5 _TOOL_HASH "${_GLSLANG_VERSION}${_SPIRV_OPT_VERSION}")
+
+# depfiles need support from glslang and the generator
+execute_process(COMMAND ${GLSLANG_VALIDATOR} --help OUTPUT_VARIABLE _GLSLANG_HELP ERROR_VARIABLE _GLSLANG_HELP)
+set(_GLSLANG_DEPFILE OFF)
+set(_USE_DEPFILE OFF)
+if(_GLSLANG_HELP MATCHES "--depfile")
+  set(_GLSLANG_DEPFILE ON)
+  if(CMAKE_GENERATOR MATCHES "Ninja" AND NOT CMAKE_VERSION VERSION_LESS 3.7)
+    set(_USE_DEPFILE ON)
+  elseif(CMAKE_GENERATOR MATCHES "Makefiles" AND NOT CMAKE_VERSION VERSION_LESS 3.20)
+    set(_USE_DEPFILE ON)
+  endif()
+endif()
+string(REPLACE ";" "|" _OPT_FLAGS "${SHADER_OPT_FLAGS}")
+
+set(SHADER_OUTPUTS)
+set(_SHADER_HEADERS)
+set(_SHADER_NAMES)
 # add shader compilation command sand target
 foreach(_SHADER ${SHADERS})
-  # compute output file name
-  get_filename_component(_EXT ${_SHADER} EXT)
-  get_filename_component(_NAME ${_SHADER} NAME_WE)
-  string(SUBSTRING ${_EXT} 1 -1 _EXT)
-  string(CONCAT _NAME_OUT ${_NAME}_ ${_EXT} ".spv")
-  string(CONCAT _SHADER_OUT ${_DIR_OUT} ${_NAME_OUT})
-  # print info
-  message(STATUS "Generating compilation command for ${_NAME}.${_EXT}")
-  # add to output list
-  list(APPEND SHADER_OUTPUTS ${_SHADER_OUT})
-  add_custom_command(
-    OUTPUT ${_SHADER_OUT}
-    COMMAND "$ENV{VULKAN_SDK}/bin/glslangValidator" -V ${_SHADER} -o ${_SHADER_OUT}
-    DEPENDS ${_SHADER}
-    COMMENT "Compiling \"${_NAME}.${_EXT}\" to \"${_NAME_OUT}\"" 
-  )
+  get_filename_component(_FILE ${_SHADER} NAME)
+  string(REGEX MATCH "[^.]+$" _EXT ${_FILE})
+  list(FIND _SHADER_STAGES ${_EXT} _STAGE_INDEX)
+  if(_STAGE_INDEX GREATER -1)
+    # compute output file name, keeping the full name avoids collisions
+    set(_NAME_OUT ${_FILE}.spv)
+    string(CONCAT _SHADER_OUT ${_DIR_OUT} ${_NAME_OUT})
+    # print info
+    message(STATUS "Generating compilation command for ${_FILE}")
+    # add to output list
+    list(APPEND SHADER_OUTPUTS ${_SHADER_OUT})
+
+    # extra arguments from "// glslang:" comment
+    set(_ARGS)
+    file(STRINGS ${_SHADER} _DIRECTIVE REGEX "^//[ \t]*glslang:" LIMIT_COUNT 1)
+    if(_DIRECTIVE)
+      string(REGEX REPLACE "^//[ \t]*glslang:[ \t]*" "" _ARGS "${_DIRECTIVE}")
+      separate_arguments(_ARGS)
+    endif()
+    set(_FLAGS -I${_DIR_SRC} ${_ARGS})
+    string(REPLACE ";" "|" _FLAGS "${_FLAGS}")
+
+    set(_OUTPUTS ${_SHADER_OUT})
+    set(_EMBED_ARGS)
+    if(SHADER_EMBED)
+      string(MAKE_C_IDENTIFIER ${_FILE} _IDENTIFIER)
+      list(FIND _SHADER_NAMES ${_IDENTIFIER} _NAME_INDEX)
+      if(_NAME_INDEX GREATER -1)
+        message(FATAL_ERROR "Embedded name of ${_FILE} collides with another shader")
+      endif()
+      list(APPEND _SHADER_NAMES ${_IDENTIFIER})
+      set(_HEADER ${SHADER_EMBED_DIR}/shaders/${_IDENTIFIER}.hpp)
+      list(APPEND _OUTPUTS ${_HEADER})
+      list(APPEND _SHADER_HEADERS ${_HEADER})
+      set(_EMBED_ARGS -DEMBED_HEADER=${_HEADER} -DEMBED_NAME=${_IDENTIFIER})
+    endif()
+
+    set(_DEPENDS ${_SHADER} ${_COMPILE_SHADER_SCRIPT})
+    set(_DEPFILE_ARGS)
+    set(_DEPFILE_OPTION)
+    if(_USE_DEPFILE)
+      set(_DEPFILE_ARGS -DDEPFILE=${_SHADER_OUT}.d)
+      set(_DEPFILE_OPTION DEPFILE ${_SHADER_OUT}.d)
+    else()
+      # only catches includes present at configure time
+      shader_includes(${_SHADER} ${_DIR_SRC} _INCLUDES)
+      list(APPEND _DEPENDS ${_INCLUDES})
+    endif()
+
+    add_custom_command(
+      OUTPUT ${_OUTPUTS}
+      COMMAND ${CMAKE_COMMAND}
+        -DGLSLANG=${GLSLANG_VALIDATOR}
+        -DSPIRV_OPT=${_SPIRV_OPT}
+        -DSOURCE=${_SHADER}
+        -DOUTPUT=${_SHADER_OUT}
+        -DFLAGS=${_FLAGS}
+        -DOPT_FLAGS=${_OPT_FLAGS}
+        -DCACHE_DIR=${SHADER_CACHE_DIR}
+        -DTOOL_HASH=${_TOOL_HASH}
+        -DGLSLANG_DEPFILE=${_GLSLANG_DEPFILE}
+        ${_DEPFILE_ARGS}
+        ${_EMBED_ARGS}
+        -P ${_COMPILE_SHADER_SCRIPT}
+      DEPENDS ${_DEPENDS}
+      ${_DEPFILE_OPTION}
+      COMMENT "Compiling \"${_FILE}\" to \"${_NAME_OUT}\""
+      VERBATIM
+    )
+  endif()
 endforeach()
 # add target depending on shaders to compile when building
-add_custom_target(shaders ALL DEPENDS ${SHADER_OUTPUTS})
+add_custom_target(shaders ALL DEPENDS ${SHADER_OUTPUTS} ${_SHADER_HEADERS})
 
-# Cannot use ARGN directly with list() command.
-set(extra_macro_args ${ARGN})
-list(GET extra_macro_args 0 _DIR_INSTALL)
 # check if install override was set
-if(NOT ${_DIR_INSTALL})
+set(_DIR_INSTALL)
+if(${ARGC} GREATER 1)
+  set(_DIR_INSTALL ${ARGV1})
+endif()
+if(NOT _DIR_INSTALL)
   string(CONCAT _DIR_INSTALL ${CMAKE_INSTALL_PREFIX} "/" ${DIR_IN})
-endif(NOT ${_DIR_INSTALL})
+endif()
 
 # installation rules, copy compiled shaders
-install(DIRECTORY ${_DIR_OUT}
+install(FILES ${SHADER_OUTPUTS}
   DESTINATION ${_DIR_INSTALL}
 )
 
@@ -0,0 +1,126 @@
+#ifndef ALLOCATOR_HPP
+#define ALLOCATOR_HPP
+
+#include <vulkan/vulkan.hpp>
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+// region of device memory handed out by the Allocator
+struct Allocation {
+  Allocation();
+
+  vk::DeviceMemory memory;
+  vk::DeviceSize offset;
+  vk::DeviceSize size;
+  uint32_t type;
+  // persistent mapping of the region, nullptr if not host visible
+  uint8_t* ptr;
+  // index of the owning block inside the pool of its memory type
+  uint32_t block;
+};
+
+// intended access pattern, selects the memory type
+enum class MemoryUsage {
+  // only accessed by the device, avoids the host visible part of device memory
+  eDeviceLocal,
+  // written sequentially by the host and read once by the device, may be write-combined
+  eUpload,
+  // written by the device and read by the host, prefers cached memory
+  eReadback,
+  // transient attachments, backed on demand where supported
+  eLazy
+};
+
+// sub-allocates buffers and images from large per memory type blocks
+// respects alignment and bufferImageGranularity between linear and optimal resources,
+// allocations in non-coherent memory cover whole nonCoherentAtomSize units
+class Allocator {
+ public:
+  struct Statistics {
+    Statistics();
+
+    size_t block_count;
+    size_t allocation_count;
+    size_t free_range_count;
+    vk::DeviceSize bytes_reserved;
+    vk::DeviceSize bytes_used;
+    vk::DeviceSize largest_free_range;
+  };
+
+  Allocator();
+  Allocator(vk::Device const& device, vk::PhysicalDevice const& phys_device, vk::DeviceSize block_size = 64 * 1024 * 1024);
+  Allocator(Allocator&& rhs);
+  Allocator(Allocator const&) = delete;
+
+  ~Allocator();
+
+  Allocator& operator=(Allocator&& rhs);
+  Allocator& operator=(Allocator const&) = delete;
+
+  // linear resources are buffers and linearly tiled images
+  Allocation allocate(vk::MemoryRequirements const& requirements, vk::MemoryPropertyFlags const& properties, bool linear);
+  // allocate memory for resource and bind it
+  Allocation allocate(vk::Buffer const& buffer, vk::MemoryPropertyFlags const& properties);
+  Allocation allocate(vk::Image const& image, vk::MemoryPropertyFlags const& properties, vk::ImageTiling tiling = vk::ImageTiling::eOptimal);
+  // choose the memory type by intended usage
+  Allocation allocate(vk::MemoryRequirements const& requirements, MemoryUsage usage, bool linear);
+  Allocation allocate(vk::Buffer const& buffer, MemoryUsage usage);
+  Allocation allocate(vk::Image const& image, MemoryUsage usage, vk::ImageTiling tiling = vk::ImageTiling::eOptimal);
+  void free(Allocation& allocation);
+
+  // make host writes visible to the device and device writes visible to the host
+  // ranges are relative to the allocation and widened to nonCoherentAtomSize,
+  // no-ops for coherent memory
+  void flush(Allocation const& allocation, vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE) const;
+  void invalidate(Allocation const& allocation, vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE) const;
+  bool is_coherent(Allocation const& allocation) const;
+
+  // returns empty blocks to the driver, returns number of freed bytes
+  // live allocations are never moved, so partially used blocks stay fragmented
+  vk::DeviceSize release_empty_blocks();
+  Statistics statistics() const;
+
+  uint32_t find_memory_type(uint32_t type_bits, vk::MemoryPropertyFlags const& properties) const;
+  // highest scoring type with the properties required by the usage
+  uint32_t find_memory_type(uint32_t type_bits, MemoryUsage usage) const;
+
+ private:
+  // contiguous part of a block, either free or in use
+  struct Range {
+    vk::DeviceSize size;
+    bool free;
+    bool linear;
+  };
+
+  struct Block {
+    vk::DeviceMemory memory;
+    vk::DeviceSize size;
+    uint8_t* ptr;
+    // ranges covering the whole block, keyed by offset
+    std::map<vk::DeviceSize, Range> ranges;
+    size_t allocation_count;
+    // single-resource allocations are released on free
+    bool dedicated;
+  };
+
+  void cleanup();
+  Allocation allocate_type(vk::MemoryRequirements const& requirements, uint32_t type, bool linear);
+  bool allocate_from(Block& block, vk::MemoryRequirements const& requirements, bool linear, vk::DeviceSize& offset);
+  uint32_t add_block(uint32_t type, vk::DeviceSize size, bool dedicated);
+  void release_block(Block& block);
+  vk::MappedMemoryRange mapped_range(Allocation const& allocation, vk::DeviceSize offset, vk::DeviceSize size) const;
+
+  vk::Device m_device;
+  vk::DispatchLoaderDynamic const* m_dispatch;
+  vk::PhysicalDeviceMemoryProperties m_mem_properties;
+  vk::DeviceSize m_block_size;
+  vk::DeviceSize m_granularity;
+  vk::DeviceSize m_atom_size;
+  // blocks of each memory type
+  std::vector<std::vector<Block>> m_pools;
+  mutable std::mutex m_mutex;
+};
+
+#endif
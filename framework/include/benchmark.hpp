@@ -0,0 +1,87 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include "device_selector.hpp"
+#include "handle.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// samples of one measured operation of a benchmark application
+struct BenchmarkResult {
+  BenchmarkResult();
+  BenchmarkResult(std::string const& name, std::string const& variant, uint64_t bytes, uint64_t items, std::string const& clock);
+
+  std::string name;
+  // implementation or configuration measured, e.g. simd level or shader variant
+  std::string variant;
+  // bytes moved and operations performed per sample, 0 if meaningless
+  uint64_t bytes;
+  uint64_t items;
+  // gpu if measured with timestamp queries, host otherwise
+  std::string clock;
+  std::vector<double> samples_ms;
+};
+
+// instance, device and main queue of a benchmark without window
+struct HeadlessDevice {
+  HeadlessDevice();
+
+  vk::Instance instance;
+  DeviceSelection selection;
+  vk::Device device;
+  vk::Queue queue;
+};
+
+// one command buffer submitted to the main queue at a time, optionally between timestamps
+class BenchmarkSubmitter {
+ public:
+  BenchmarkSubmitter();
+  explicit BenchmarkSubmitter(HeadlessDevice const& headless);
+
+  // records fn, submits and waits, returns the gpu time between the timestamps if timed
+  // and supported, the host round trip otherwise
+  double submit(std::function<void(vk::CommandBuffer const&)> const& fn, bool timed);
+  // clock of timed submissions, gpu or host
+  std::string const& clock() const;
+  // reset and unused between submissions, e.g. for measuring recording alone
+  vk::CommandBuffer const& command_buffer() const;
+
+ private:
+  vk::Device m_device;
+  vk::DispatchLoaderDynamic const* m_dispatch;
+  vk::Queue m_queue;
+  Handle<vk::CommandPool> m_command_pool;
+  vk::CommandBuffer m_command_buffer;
+  Handle<vk::Fence> m_fence;
+  // empty without timestamp support on the main family
+  Handle<vk::QueryPool> m_query_pool;
+  uint64_t m_timestamp_mask;
+  double m_timestamp_period;
+  std::string m_clock;
+};
+
+double elapsed_ms(std::chrono::steady_clock::time_point const& start);
+double median(std::vector<double> samples);
+
+// runs once to warm caches and lazy allocations, then adds the times run returns
+// for the given number of repetitions to the result
+BenchmarkResult collect_samples(BenchmarkResult result, uint32_t repetitions, std::function<double()> const& run);
+
+// one row per result, speedup is relative to the result of the baseline variant
+// with the same name, bytes and items, 0 without such a result
+void print_csv(std::vector<BenchmarkResult> const& results, std::string const& baseline = "");
+// properties describe the whole run, e.g. the device name
+void print_json(std::vector<BenchmarkResult> const& results, std::map<std::string, std::string> const& properties, std::string const& baseline = "");
+
+// device chosen by the DeviceSelector and created through the bring-up module, without validation
+HeadlessDevice create_headless_device(uint32_t api_version = VK_API_VERSION_1_0);
+void destroy_headless_device(HeadlessDevice const& headless);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef BRING_UP_HPP
+#define BRING_UP_HPP
+
+#include "device_selector.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <string>
+#include <vector>
+
+// dispatch table of the device, device level functions are loaded through vkGetDeviceProcAddr
+// and go straight to the driver or the first enabled layer instead of through the loader trampoline
+// passed as last argument of the vulkan.hpp calls on the recording and submission paths
+// loaded by create_device, or on first use for devices created otherwise
+// looked up once when a framework object is created, valid until destroy_device
+vk::DispatchLoaderDynamic const& device_dispatch(vk::Device const& device);
+
+// enumerated on first use and cached for the lifetime of the process
+std::vector<vk::ExtensionProperties> const& instance_extensions();
+std::vector<vk::LayerProperties> const& instance_layers();
+std::vector<vk::ExtensionProperties> const& device_extensions(vk::PhysicalDevice const& phys_device);
+bool instance_extension_supported(std::string const& name);
+bool instance_layer_supported(std::string const& name);
+bool device_extension_supported(vk::PhysicalDevice const& phys_device, std::string const& name);
+
+// whether the environment variable VULKAN_MINIMAL_VALIDATION is set to anything but 0
+bool validation_requested();
+// khronos or the older lunarg validation layer, empty if none is installed
+std::string validation_layer();
+
+// with validation the validation layer and the extension used by the DebugReporter are
+// enabled as far as they are installed, layers are not even enumerated without it
+// throws if one of the given extensions is not supported
+vk::Instance create_instance(std::vector<char const*> const& extensions, bool validation, uint32_t api_version = VK_API_VERSION_1_0);
+// enables one queue of each selected family and loads the dispatch table of the device
+vk::Device create_device(DeviceSelection const& selection, std::vector<char const*> const& extensions = {});
+// releases the dispatch table and destroys the device
+void destroy_device(vk::Device const& device);
+
+#endif
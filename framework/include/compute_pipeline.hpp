@@ -0,0 +1,65 @@
+#ifndef COMPUTE_PIPELINE_HPP
+#define COMPUTE_PIPELINE_HPP
+
+#include "bring_up.hpp"
+#include "descriptor_set.hpp"
+#include "shader.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <glm/vec3.hpp>
+
+#include <map>
+#include <vector>
+
+// compute pipeline with layout and descriptor pool built from shader reflection
+// the workgroup size is set through specialization constants where the shader allows it
+class ComputePipeline {
+ public:
+  ComputePipeline();
+  // zero workgroup size components keep the size declared in the shader
+  ComputePipeline(
+    vk::Device const& device,
+    Shader const& shader,
+    vk::PipelineCache const& cache,
+    glm::uvec3 const& workgroup_size = glm::uvec3{0},
+    std::map<uint32_t, uint32_t> const& constants = {},
+    uint32_t max_sets = 16
+  );
+  ComputePipeline(ComputePipeline&& rhs);
+  ComputePipeline(ComputePipeline const&) = delete;
+
+  ~ComputePipeline();
+
+  ComputePipeline& operator=(ComputePipeline&& rhs);
+  ComputePipeline& operator=(ComputePipeline const&) = delete;
+
+  DescriptorSet allocate_set(uint32_t set = 0);
+  // from a pool of the caller providing the descriptor types of the set
+  DescriptorSet allocate_set(vk::DescriptorPool const& pool, uint32_t set = 0) const;
+  // binds pipeline and the given sets starting at set 0
+  void bind(vk::CommandBuffer const& command_buffer, std::vector<vk::DescriptorSet> const& sets = {}) const;
+  void push_constants(vk::CommandBuffer const& command_buffer, void const* data, uint32_t size, uint32_t offset = 0) const;
+  // dispatches enough workgroups to cover the given number of invocations
+  void dispatch(vk::CommandBuffer const& command_buffer, glm::uvec3 const& invocations) const;
+
+  glm::uvec3 const& workgroup_size() const;
+  vk::Pipeline const& get() const;
+  vk::PipelineLayout const& layout() const;
+
+ private:
+  void cleanup();
+
+  vk::Device m_device;
+  // recording goes through the device table
+  vk::DispatchLoaderDynamic const* m_dispatch;
+  std::vector<vk::DescriptorSetLayout> m_set_layouts;
+  // reflected bindings of each set
+  std::vector<std::vector<ShaderBinding>> m_bindings;
+  vk::PipelineLayout m_layout;
+  vk::Pipeline m_pipeline;
+  vk::DescriptorPool m_pool;
+  glm::uvec3 m_workgroup_size;
+};
+
+#endif
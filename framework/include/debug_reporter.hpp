@@ -3,20 +3,20 @@
 
 #include <vulkan/vulkan.hpp>
 
-// simple class to wrap DebugCallback
-// queries extension function addresses
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// receives validation messages through VK_EXT_debug_utils if utils_supported(),
+// which the instance must then enable, otherwise through VK_EXT_debug_report
+// the callback only copies messages into a lock-free queue, a background thread
+// prints them, collapsing repeated message ids and limiting each id to
+// rate_limit messages per second
+// errors are recorded instead of thrown from inside the driver
 class DebugReporter {
  public:
   DebugReporter();
-  DebugReporter(
-    vk::Instance const& inst, 
-    vk::DebugReportFlagsEXT const& flags = 
-          vk::DebugReportFlagBitsEXT::eError
-        | vk::DebugReportFlagBitsEXT::eWarning 
-        | vk::DebugReportFlagBitsEXT::ePerformanceWarning 
-       // | vk::DebugReportFlagBitsEXT::eDebug 
-       // | vk::DebugReportFlagBitsEXT::eInformation
-  );
+  DebugReporter(vk::Instance const& inst, uint32_t rate_limit = 8, bool verbose = false);
   DebugReporter(DebugReporter&& rhs);
   DebugReporter(DebugReporter const&) = delete;
 
@@ -25,11 +25,38 @@ class DebugReporter {
   DebugReporter const& operator=(DebugReporter&& rhs);
   DebugReporter const& operator=(DebugReporter const&) = delete;
 
+  // names appear in messages about the object, no-ops without debug utils
+  void set_name(vk::Device const& device, vk::Buffer const& buffer, std::string const& name) const;
+  void set_name(vk::Device const& device, vk::Image const& image, std::string const& name) const;
+  void set_name(vk::Device const& device, vk::ImageView const& view, std::string const& name) const;
+  void set_name(vk::Device const& device, vk::Pipeline const& pipeline, std::string const& name) const;
+  void set_name(vk::Device const& device, vk::CommandBuffer const& command_buffer, std::string const& name) const;
+  void set_name(vk::Device const& device, vk::Queue const& queue, std::string const& name) const;
+  // labelled regions show up in messages and capture tools
+  void begin_label(vk::CommandBuffer const& command_buffer, std::string const& name) const;
+  void end_label(vk::CommandBuffer const& command_buffer) const;
+  void insert_label(vk::CommandBuffer const& command_buffer, std::string const& name) const;
+
+  // waits until all queued messages were printed
+  void flush() const;
+  uint32_t error_count() const;
+  std::string last_error() const;
+  // messages dropped because the queue was full
+  uint64_t dropped_count() const;
+
+  // whether the instance can be created with VK_EXT_debug_utils
+  static bool utils_supported();
+
+  // queue, printing thread and extension state, shared with the callback
+  struct Channel;
+
  private:
   void cleanup();
-  
+  void set_object_name(vk::Device const& device, uint32_t type, uint64_t handle, std::string const& name) const;
+
   vk::Instance m_instance;
-  vk::DebugReportCallbackEXT m_callback; 
+  // heap allocated so the callback user data survives moves
+  std::unique_ptr<Channel> m_channel;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,41 @@
+#ifndef DELETION_QUEUE_HPP
+#define DELETION_QUEUE_HPP
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// defers destruction of objects until the gpu work that may use them has retired
+// every deleter is tagged with a monotonically increasing value, e.g. a frame index
+// or timeline semaphore value, and runs once a larger value has completed
+class DeletionQueue {
+ public:
+  DeletionQueue();
+  DeletionQueue(DeletionQueue&& rhs);
+  DeletionQueue(DeletionQueue const&) = delete;
+
+  // runs all remaining deleters
+  ~DeletionQueue();
+
+  DeletionQueue& operator=(DeletionQueue&& rhs);
+  DeletionQueue& operator=(DeletionQueue const&) = delete;
+
+  void push(uint64_t value, std::function<void()> const& deleter);
+  // runs all deleters with a value below completed, returns their number
+  size_t retire(uint64_t completed);
+  // only safe once the device is idle
+  size_t flush();
+  size_t size() const;
+
+ private:
+  struct Entry {
+    uint64_t value;
+    std::function<void()> deleter;
+  };
+
+  std::deque<Entry> m_entries;
+  mutable std::mutex m_mutex;
+};
+
+#endif
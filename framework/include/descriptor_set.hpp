@@ -0,0 +1,46 @@
+#ifndef DESCRIPTOR_SET_HPP
+#define DESCRIPTOR_SET_HPP
+
+#include "shader.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <deque>
+#include <vector>
+
+// descriptor set with reflected binding types
+// writes are collected and applied with a single update
+// move-only, pending writes point into the info deques of this object
+class DescriptorSet {
+ public:
+  DescriptorSet();
+  // updates go through the dispatch table of the allocating pipeline
+  DescriptorSet(vk::Device const& device, vk::DispatchLoaderDynamic const& dispatch, vk::DescriptorSet const& set, std::vector<ShaderBinding> const& bindings);
+  DescriptorSet(DescriptorSet&& rhs);
+  DescriptorSet(DescriptorSet const&) = delete;
+
+  DescriptorSet& operator=(DescriptorSet&& rhs);
+  DescriptorSet& operator=(DescriptorSet const&) = delete;
+
+  DescriptorSet& write(uint32_t binding, vk::Buffer const& buffer, vk::DeviceSize offset = 0, vk::DeviceSize range = VK_WHOLE_SIZE);
+  DescriptorSet& write(uint32_t binding, vk::ImageView const& view, vk::ImageLayout layout, vk::Sampler const& sampler = vk::Sampler{});
+  void update();
+
+  vk::DescriptorSet const& get() const;
+
+ private:
+  // the set itself is returned with its pool, only pending writes are dropped
+  void cleanup();
+  vk::DescriptorType type(uint32_t binding) const;
+
+  vk::Device m_device;
+  vk::DispatchLoaderDynamic const* m_dispatch;
+  vk::DescriptorSet m_set;
+  std::vector<ShaderBinding> m_bindings;
+  std::vector<vk::WriteDescriptorSet> m_writes;
+  // deques keep info addresses stable until update
+  std::deque<vk::DescriptorBufferInfo> m_buffer_infos;
+  std::deque<vk::DescriptorImageInfo> m_image_infos;
+};
+
+#endif
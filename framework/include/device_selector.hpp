@@ -0,0 +1,82 @@
+#ifndef DEVICE_SELECTOR_HPP
+#define DEVICE_SELECTOR_HPP
+
+#include <vulkan/vulkan.hpp>
+
+#include <string>
+#include <vector>
+
+// properties of a physical device relevant for selection
+struct DeviceCapabilities {
+  DeviceCapabilities();
+
+  std::string name;
+  uint32_t vendor_id;
+  uint32_t device_id;
+  uint32_t driver_version;
+  uint32_t api_version;
+  // lower of instance and device version, bounds the usable core features
+  uint32_t effective_api_version;
+  vk::PhysicalDeviceType type;
+  // size of largest device local heap
+  vk::DeviceSize device_memory;
+  uint32_t max_workgroup_invocations;
+  uint32_t max_shared_memory;
+  // 0 if the device does not report it
+  uint32_t subgroup_size;
+  // VkSubgroupFeatureFlags supported in compute shaders, 0 without subgroup support
+  uint32_t subgroup_operations;
+  std::vector<vk::QueueFamilyProperties> queue_families;
+};
+
+// device and queue families chosen by the DeviceSelector
+// families without a dedicated queue fall back to the main family
+struct DeviceSelection {
+  DeviceSelection();
+
+  // instance the device was enumerated from
+  vk::Instance instance;
+  vk::PhysicalDevice phys_device;
+  DeviceCapabilities capabilities;
+  float score;
+  // compute and transfer capable, preferably also graphics
+  uint32_t queue_family;
+  // compute family without graphics support
+  uint32_t queue_family_compute;
+
+  // one queue of each distinct family, priorities stay valid until exit
+  std::vector<vk::DeviceQueueCreateInfo> queue_infos() const;
+};
+
+// scores all physical devices including cpu implementations
+// capabilities are cached on disk, keyed by device, driver and effective api version
+class DeviceSelector {
+ public:
+  // api_version is the one the instance was created with
+  // empty path disables the cache
+  DeviceSelector(vk::Instance const& instance, uint32_t api_version, std::string const& cache_path = "");
+
+  // devices without compute support are skipped
+  DeviceSelection select() const;
+
+  std::vector<vk::PhysicalDevice> const& devices() const;
+  std::vector<DeviceCapabilities> const& capabilities() const;
+
+  // instance_api_version limits the queried properties
+  static DeviceCapabilities query(vk::PhysicalDevice const& phys_device, uint32_t instance_api_version);
+  static float score(DeviceCapabilities const& capabilities);
+  // returns first family with the required but without the avoided flags, or -1
+  static int32_t find_queue_family(DeviceCapabilities const& capabilities, vk::QueueFlags const& required, vk::QueueFlags const& avoided = vk::QueueFlags{});
+
+ private:
+  std::vector<DeviceCapabilities> load_cache() const;
+  void save_cache() const;
+
+  vk::Instance m_instance;
+  std::vector<vk::PhysicalDevice> m_devices;
+  std::vector<DeviceCapabilities> m_capabilities;
+  std::string m_cache_path;
+  uint32_t m_api_version;
+};
+
+#endif
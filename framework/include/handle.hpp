@@ -0,0 +1,171 @@
+#ifndef HANDLE_HPP
+#define HANDLE_HPP
+
+#include "allocator.hpp"
+#include "bring_up.hpp"
+#include "scheduler.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <utility>
+
+// destroy functions for the wrapped device objects
+inline void destroy_handle(vk::Device const& device, vk::DispatchLoaderDynamic const& dispatch, vk::Buffer const& handle) { device.destroyBuffer(handle, nullptr, dispatch); }
+inline void destroy_handle(vk::Device const& device, vk::DispatchLoaderDynamic const& dispatch, vk::BufferView const& handle) { device.destroyBufferView(handle, nullptr, dispatch); }
+inline void destroy_handle(vk::Device const& device, vk::DispatchLoaderDynamic const& dispatch, vk::Image const& handle) { device.destroyImage(handle, nullptr, dispatch); }
+inline void destroy_handle(vk::Device const& device, vk::DispatchLoaderDynamic const& dispatch, vk::ImageView const& handle) { device.destroyImageView(handle, nullptr, dispatch); }
+inline void destroy_handle(vk::Device const& device, vk::DispatchLoaderDynamic const& dispatch, vk::Sampler const& handle) { device.destroySampler(handle, nullptr, dispatch); }
+inline void destroy_handle(vk::Device const& device, vk::DispatchLoaderDynamic const& dispatch, vk::Fence const& handle) { device.destroyFence(handle, nullptr, dispatch); }
+inline void destroy_handle(vk::Device const& device, vk::DispatchLoaderDynamic const& dispatch, vk::Semaphore const& handle) { device.destroySemaphore(handle, nullptr, dispatch); }
+inline void destroy_handle(vk::Device const& device, vk::DispatchLoaderDynamic const& dispatch, vk::Event const& handle) { device.destroyEvent(handle, nullptr, dispatch); }
+inline void destroy_handle(vk::Device const& device, vk::DispatchLoaderDynamic const& dispatch, vk::QueryPool const& handle) { device.destroyQueryPool(handle, nullptr, dispatch); }
+inline void destroy_handle(vk::Device const& device, vk::DispatchLoaderDynamic const& dispatch, vk::CommandPool const& handle) { device.destroyCommandPool(handle, nullptr, dispatch); }
+inline void destroy_handle(vk::Device const& device, vk::DispatchLoaderDynamic const& dispatch, vk::DescriptorPool const& handle) { device.destroyDescriptorPool(handle, nullptr, dispatch); }
+inline void destroy_handle(vk::Device const& device, vk::DispatchLoaderDynamic const& dispatch, vk::DescriptorSetLayout const& handle) { device.destroyDescriptorSetLayout(handle, nullptr, dispatch); }
+inline void destroy_handle(vk::Device const& device, vk::DispatchLoaderDynamic const& dispatch, vk::PipelineLayout const& handle) { device.destroyPipelineLayout(handle, nullptr, dispatch); }
+inline void destroy_handle(vk::Device const& device, vk::DispatchLoaderDynamic const& dispatch, vk::Pipeline const& handle) { device.destroyPipeline(handle, nullptr, dispatch); }
+inline void destroy_handle(vk::Device const& device, vk::DispatchLoaderDynamic const& dispatch, vk::ShaderModule const& handle) { device.destroyShaderModule(handle, nullptr, dispatch); }
+inline void destroy_handle(vk::Device const& device, vk::DispatchLoaderDynamic const& dispatch, vk::DeviceMemory const& handle) { device.freeMemory(handle, nullptr, dispatch); }
+
+// move-only owner of a device object
+// with a scheduler the object is destroyed once the frame recorded at release time
+// has retired, so no waitIdle is needed before dropping it
+template<typename T>
+class Handle {
+ public:
+  Handle()
+   :m_device{}
+   ,m_dispatch{nullptr}
+   ,m_handle{}
+   ,m_scheduler{nullptr}
+  {}
+
+  Handle(vk::Device const& device, T const& handle, Scheduler* scheduler = nullptr)
+   :m_device{device}
+   ,m_dispatch{&device_dispatch(device)}
+   ,m_handle{handle}
+   ,m_scheduler{scheduler}
+  {}
+
+  Handle(Handle&& rhs)
+   :Handle{}
+  {
+    std::swap(m_device, rhs.m_device);
+    std::swap(m_dispatch, rhs.m_dispatch);
+    std::swap(m_handle, rhs.m_handle);
+    std::swap(m_scheduler, rhs.m_scheduler);
+  }
+  Handle(Handle const&) = delete;
+
+  ~Handle() {
+    cleanup();
+  }
+
+  Handle& operator=(Handle&& rhs) {
+    cleanup();
+    std::swap(m_device, rhs.m_device);
+    std::swap(m_dispatch, rhs.m_dispatch);
+    std::swap(m_handle, rhs.m_handle);
+    std::swap(m_scheduler, rhs.m_scheduler);
+    return *this;
+  }
+  Handle& operator=(Handle const&) = delete;
+
+  T const& get() const {
+    return m_handle;
+  }
+
+  // gives up ownership without destroying
+  T release() {
+    T handle = m_handle;
+    m_handle = T{};
+    return handle;
+  }
+
+ private:
+  void cleanup() {
+    if (!m_handle) return;
+    if (m_scheduler) {
+      vk::Device device = m_device;
+      vk::DispatchLoaderDynamic const* dispatch = m_dispatch;
+      T handle = m_handle;
+      m_scheduler->defer([device, dispatch, handle]() {
+        destroy_handle(device, *dispatch, handle);
+      });
+    }
+    else {
+      destroy_handle(m_device, *m_dispatch, m_handle);
+    }
+    m_handle = T{};
+  }
+
+  vk::Device m_device;
+  vk::DispatchLoaderDynamic const* m_dispatch;
+  T m_handle;
+  Scheduler* m_scheduler;
+};
+
+// move-only owner of an Allocator region, returned like a Handle
+// the allocator must outlive the scheduler flushing the deferred free
+class AllocationHandle {
+ public:
+  AllocationHandle()
+   :m_allocator{nullptr}
+   ,m_allocation{}
+   ,m_scheduler{nullptr}
+  {}
+
+  AllocationHandle(Allocator& allocator, Allocation const& allocation, Scheduler* scheduler = nullptr)
+   :m_allocator{&allocator}
+   ,m_allocation{allocation}
+   ,m_scheduler{scheduler}
+  {}
+
+  AllocationHandle(AllocationHandle&& rhs)
+   :AllocationHandle{}
+  {
+    std::swap(m_allocator, rhs.m_allocator);
+    std::swap(m_allocation, rhs.m_allocation);
+    std::swap(m_scheduler, rhs.m_scheduler);
+  }
+  AllocationHandle(AllocationHandle const&) = delete;
+
+  ~AllocationHandle() {
+    cleanup();
+  }
+
+  AllocationHandle& operator=(AllocationHandle&& rhs) {
+    cleanup();
+    std::swap(m_allocator, rhs.m_allocator);
+    std::swap(m_allocation, rhs.m_allocation);
+    std::swap(m_scheduler, rhs.m_scheduler);
+    return *this;
+  }
+  AllocationHandle& operator=(AllocationHandle const&) = delete;
+
+  Allocation const& get() const {
+    return m_allocation;
+  }
+
+ private:
+  void cleanup() {
+    if (!m_allocator || !m_allocation.memory) return;
+    if (m_scheduler) {
+      Allocator* allocator = m_allocator;
+      Allocation allocation = m_allocation;
+      m_scheduler->defer([allocator, allocation]() mutable {
+        allocator->free(allocation);
+      });
+    }
+    else {
+      m_allocator->free(m_allocation);
+    }
+    m_allocation = Allocation{};
+  }
+
+  Allocator* m_allocator;
+  Allocation m_allocation;
+  Scheduler* m_scheduler;
+};
+
+#endif
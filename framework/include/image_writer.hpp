@@ -0,0 +1,105 @@
+#ifndef IMAGE_WRITER_HPP
+#define IMAGE_WRITER_HPP
+
+#include "job_system.hpp"
+#include "pixel_convert.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class ImageFormat {
+  // strip-parallel deflate with fixed codes, fast with moderate compression
+  ePng,
+  // lodepng with its default settings, single threaded and smallest
+  ePngSmall,
+  // quite ok image format, single threaded but much faster than deflate
+  eQoi
+};
+
+// encodes rgba8 images on a background thread and writes them to disk
+// strips of a single image are encoded in parallel on an internal JobSystem
+// pixels are read in place, rows are row_pitch bytes apart
+// other pixel formats than rgba8 are converted to it, values are stored without
+// applying a transfer function, so linear float data should be converted to eRgba8Srgb first
+class ImageWriter {
+ public:
+  explicit ImageWriter(uint32_t thread_count = std::thread::hardware_concurrency(), size_t max_pending = 4);
+  ImageWriter(ImageWriter const&) = delete;
+
+  // finishes all pending writes
+  ~ImageWriter();
+
+  ImageWriter& operator=(ImageWriter const&) = delete;
+
+  // pixels must stay valid until the future is ready, which rethrows encoding and io errors
+  // blocks while max_pending writes are queued
+  std::shared_future<void> write(std::string const& path, ImageFormat format, uint8_t const* pixels, uint32_t width, uint32_t height, size_t row_pitch, PixelFormat pixel_format = PixelFormat::eRgba8Unorm);
+  // encodes on the calling thread, using the workers for strips
+  std::vector<uint8_t> encode(ImageFormat format, uint8_t const* pixels, uint32_t width, uint32_t height, size_t row_pitch, PixelFormat pixel_format = PixelFormat::eRgba8Unorm);
+  void wait_idle();
+
+ private:
+  struct Request {
+    std::string path;
+    ImageFormat format;
+    uint8_t const* pixels;
+    uint32_t width;
+    uint32_t height;
+    size_t row_pitch;
+    PixelFormat pixel_format;
+    std::promise<void> promise;
+  };
+
+  std::vector<uint8_t> encode_png(uint8_t const* pixels, uint32_t width, uint32_t height, size_t row_pitch);
+  void work();
+
+  JobSystem m_jobs;
+  std::deque<Request> m_requests;
+  size_t m_max_pending;
+  bool m_busy;
+  bool m_running;
+  std::mutex m_mutex;
+  std::condition_variable m_cv_request;
+  std::condition_variable m_cv_done;
+  std::thread m_thread;
+};
+
+// writes a png from rows arriving top to bottom, so images larger than memory
+// can be saved in strips, only the last row is kept between writes
+// jobs compress the strips of each write in parallel, without them on the calling thread
+class PngStream {
+ public:
+  PngStream(std::string const& path, uint32_t width, uint32_t height, JobSystem* jobs = nullptr);
+  PngStream(PngStream const&) = delete;
+
+  PngStream& operator=(PngStream const&) = delete;
+
+  // rows continue below the previously written ones
+  void write_rows(uint8_t const* pixels, uint32_t row_count, size_t row_pitch);
+  // writes the checksum and closes the file, throws if rows are missing
+  void finish();
+  uint32_t rows_written() const;
+
+ private:
+  void write(std::vector<uint8_t> const& data);
+
+  std::string m_path;
+  std::ofstream m_file;
+  JobSystem* m_jobs;
+  uint32_t m_width;
+  uint32_t m_height;
+  uint32_t m_rows;
+  // checksum of all filtered rows so far
+  uint32_t m_adler;
+  // filters of the next row refer to the last written one
+  std::vector<uint8_t> m_prev;
+};
+
+#endif
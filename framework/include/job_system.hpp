@@ -0,0 +1,80 @@
+#ifndef JOB_SYSTEM_HPP
+#define JOB_SYSTEM_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// pool of worker threads with one task deque each
+// idle workers steal from the front of other deques
+// parallel_for may be called concurrently and from inside tasks
+class JobSystem {
+ public:
+  // tasks receive the index of the executing worker
+  typedef std::function<void(uint32_t)> Task;
+
+  explicit JobSystem(uint32_t thread_count = std::thread::hardware_concurrency());
+  JobSystem(JobSystem const&) = delete;
+
+  ~JobSystem();
+
+  JobSystem& operator=(JobSystem const&) = delete;
+
+  void submit(Task const& task);
+  // splits [0, count) into chunks of grain_size, fn receives begin, end and worker
+  // blocks until its own chunks finished and rethrows their first exception
+  // called from a task, the calling worker executes queued tasks while waiting
+  void parallel_for(uint32_t count, uint32_t grain_size, std::function<void(uint32_t, uint32_t, uint32_t)> const& fn);
+  // blocks until all tasks given to submit finished, rethrows their first exception
+  // must not be called from one of these tasks
+  void wait();
+
+  uint32_t thread_count() const;
+
+ private:
+  // tasks waited on together
+  struct Group {
+    Group();
+
+    // tasks not yet finished
+    std::atomic<uint64_t> unfinished;
+    std::exception_ptr exception;
+  };
+
+  struct Job {
+    Task task;
+    Group* group;
+  };
+
+  struct Queue {
+    std::deque<Job> jobs;
+    std::mutex mutex;
+  };
+
+  void enqueue(Task const& task, Group& group);
+  void execute(Job& job, uint32_t index);
+  void wait(Group& group);
+  void work(uint32_t index);
+  bool pop(uint32_t index, Job& job);
+  bool steal(uint32_t index, Job& job);
+
+  std::vector<Queue> m_queues;
+  std::vector<std::thread> m_threads;
+  std::atomic<uint32_t> m_next;
+  // tasks waiting in a queue
+  std::atomic<uint64_t> m_queued;
+  // tasks given to submit
+  Group m_submitted;
+  std::mutex m_mutex;
+  std::condition_variable m_cv_work;
+  std::condition_variable m_cv_done;
+  bool m_running;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef PARALLEL_RECORDER_HPP
+#define PARALLEL_RECORDER_HPP
+
+#include "bring_up.hpp"
+#include "job_system.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <functional>
+#include <vector>
+
+// records command ranges on the workers of a JobSystem
+// every worker owns a command pool, results are returned in chunk order
+class ParallelRecorder {
+ public:
+  // receives command buffer, begin and end of the item range
+  typedef std::function<void(vk::CommandBuffer const&, uint32_t, uint32_t)> Function;
+
+  ParallelRecorder(vk::Device const& device, uint32_t queue_family, JobSystem& jobs);
+  ParallelRecorder(ParallelRecorder const&) = delete;
+
+  ~ParallelRecorder();
+
+  ParallelRecorder& operator=(ParallelRecorder const&) = delete;
+
+  // records count items in chunks of chunk_size, one command buffer per chunk
+  std::vector<vk::CommandBuffer> record(vk::CommandBufferLevel level, uint32_t count, uint32_t chunk_size, Function const& fn);
+  // records into secondary buffers and executes them in order in the primary buffer
+  void record(vk::CommandBuffer const& primary, uint32_t count, uint32_t chunk_size, Function const& fn);
+  // recycles all command buffers, previous submissions must have retired
+  void reset();
+
+ private:
+  struct WorkerPool {
+    vk::CommandPool pool;
+    std::vector<vk::CommandBuffer> primaries;
+    std::vector<vk::CommandBuffer> secondaries;
+    size_t used_primaries;
+    size_t used_secondaries;
+  };
+
+  vk::CommandBuffer acquire(WorkerPool& pool, vk::CommandBufferLevel level);
+
+  vk::Device m_device;
+  vk::DispatchLoaderDynamic const* m_dispatch;
+  JobSystem* m_jobs;
+  std::vector<WorkerPool> m_pools;
+};
+
+#endif
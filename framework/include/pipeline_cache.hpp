@@ -0,0 +1,44 @@
+#ifndef PIPELINE_CACHE_HPP
+#define PIPELINE_CACHE_HPP
+
+#include <vulkan/vulkan.hpp>
+
+#include <string>
+#include <vector>
+
+// pipeline cache persisted to disk
+// blobs from other devices, drivers or truncated writes are discarded
+class PipelineCache {
+ public:
+  PipelineCache();
+  PipelineCache(vk::Device const& device, vk::PhysicalDevice const& phys_device, std::string const& path);
+  PipelineCache(PipelineCache&& rhs);
+  PipelineCache(PipelineCache const&) = delete;
+
+  // writes cache back to disk
+  ~PipelineCache();
+
+  PipelineCache& operator=(PipelineCache&& rhs);
+  PipelineCache& operator=(PipelineCache const&) = delete;
+
+  // replaces file atomically
+  void save() const;
+
+  vk::PipelineCache const& get() const;
+  // whether a valid blob was loaded from disk
+  bool warm() const;
+
+  // checks driver header against device
+  static bool validate(std::vector<uint8_t> const& blob, vk::PhysicalDeviceProperties const& properties);
+
+ private:
+  void cleanup();
+
+  vk::Device m_device;
+  vk::DispatchLoaderDynamic const* m_dispatch;
+  vk::PipelineCache m_cache;
+  std::string m_path;
+  bool m_warm;
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef PIPELINE_TABLE_HPP
+#define PIPELINE_TABLE_HPP
+
+#include "compute_pipeline.hpp"
+#include "shader.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <glm/vec3.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+// shader and specialization of a compute pipeline
+// the specialization is part of the pipeline cache key, pipelines created by the
+// sample and by warm_pipeline_cache come from the same parameters to hit the same entries
+struct PipelineParameters {
+  PipelineParameters();
+  PipelineParameters(std::string const& shader, glm::uvec3 const& workgroup_size, std::map<uint32_t, uint32_t> const& constants = {});
+
+  // compiled shader without extension, e.g. fill for fill.comp.spv
+  std::string shader;
+  // zero components keep the size declared in the shader
+  glm::uvec3 workgroup_size;
+  std::map<uint32_t, uint32_t> constants;
+};
+
+// pipelines created by application_compute
+std::vector<PipelineParameters> const& sample_pipelines();
+// entry of sample_pipelines using the given shader, throws if there is none
+PipelineParameters const& sample_pipeline(std::string const& shader);
+
+// embedded code if built with SHADER_EMBED, otherwise loaded from shader_dir
+Shader load_shader(vk::Device const& device, std::string const& shader_dir, std::string const& name);
+// the shader module is only needed during creation
+ComputePipeline create_pipeline(vk::Device const& device, std::string const& shader_dir, vk::PipelineCache const& cache, PipelineParameters const& parameters, uint32_t max_sets = 16);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef PIXEL_CONVERT_HPP
+#define PIXEL_CONVERT_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// instruction sets of the conversion kernels, chosen at runtime
+// kernels without a version for a level use the next lower one
+enum class SimdLevel {
+  eScalar,
+  eSse41,
+  // includes f16c for half conversions
+  eAvx2
+};
+
+// four channel formats as read back from images, channels in memory order
+enum class PixelFormat {
+  eRgba8Unorm,
+  eBgra8Unorm,
+  eRgba8Srgb,
+  eBgra8Srgb,
+  eRgba16Float,
+  eRgba32Float,
+  // as vk::Format::eA2B10G10R10UnormPack32, red in the lowest bits
+  eA2b10g10r10Unorm
+};
+
+// highest level supported by cpu and os
+SimdLevel simd_level();
+char const* simd_level_name(SimdLevel level);
+size_t pixel_size(PixelFormat format);
+bool is_srgb(PixelFormat format);
+
+// element-wise kernels over count values, levels above simd_level() are lowered
+// float to integer conversions clamp to [0, 1] and map NaN to 0
+void unorm8_to_float(uint8_t const* src, float* dst, size_t count, SimdLevel level = simd_level());
+void float_to_unorm8(float const* src, uint8_t* dst, size_t count, SimdLevel level = simd_level());
+// round to nearest even, results are identical at all levels except for NaN payloads
+void half_to_float(uint16_t const* src, float* dst, size_t count, SimdLevel level = simd_level());
+void float_to_half(float const* src, uint16_t* dst, size_t count, SimdLevel level = simd_level());
+
+// kernels over rgba pixels, alpha is always linear
+void srgb8_to_linear(uint8_t const* src, float* dst, size_t pixel_count, SimdLevel level = simd_level());
+// within one step of exact rounding
+void linear_to_srgb8(float const* src, uint8_t* dst, size_t pixel_count, SimdLevel level = simd_level());
+void unpack_a2b10g10r10(uint32_t const* src, float* dst, size_t pixel_count, SimdLevel level = simd_level());
+void pack_a2b10g10r10(float const* src, uint32_t* dst, size_t pixel_count, SimdLevel level = simd_level());
+// channel i of each dst pixel is channel order[i] of the src pixel
+void swizzle_rgba8(uint8_t const* src, uint8_t* dst, size_t pixel_count, uint8_t const order[4], SimdLevel level = simd_level());
+
+// converts width x height pixels, rows are src_pitch and dst_pitch bytes apart
+// and aligned to the channel size, equal formats only remove the row padding
+// 8 bit formats of different channel order are swizzled directly, others go through float
+void convert_pixels(PixelFormat src_format, void const* src, size_t src_pitch, PixelFormat dst_format, void* dst, size_t dst_pitch, uint32_t width, uint32_t height, SimdLevel level = simd_level());
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef PRIMITIVES_HPP
+#define PRIMITIVES_HPP
+
+#include "allocator.hpp"
+#include "bring_up.hpp"
+#include "compute_pipeline.hpp"
+#include "device_selector.hpp"
+#include "handle.hpp"
+#include "pipeline_table.hpp"
+#include "shader.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+// combining operation of reductions and scans on uint32 values
+enum class ScanOp {
+  eAdd,
+  eMin,
+  eMax
+};
+
+// pipelines of the parallel primitives on uint32 values
+// subgroup variants are used if the device supports the required subgroup
+// operations in compute shaders, they need an instance created with api version 1.1
+// otherwise the shared memory variants run everywhere
+class Primitives {
+ public:
+  enum class Kernel {
+    eReduce,
+    eScan,
+    eScanAdd,
+    eHistogram,
+    eRadixCount,
+    eRadixScatter
+  };
+
+  // shader_dir holds the compiled shaders, unused if they are embedded
+  // use_subgroups false forces the shared memory variants
+  Primitives(vk::Device const& device, DeviceCapabilities const& capabilities, vk::PipelineCache const& cache, std::string const& shader_dir, bool use_subgroups = true);
+  Primitives(Primitives const&) = delete;
+
+  Primitives& operator=(Primitives const&) = delete;
+
+  // created on first use
+  ComputePipeline const& pipeline(Kernel kernel, ScanOp op = ScanOp::eAdd, bool segmented = false);
+  PipelineParameters parameters(Kernel kernel, ScanOp op = ScanOp::eAdd, bool segmented = false) const;
+  // every pipeline the batches may create, e.g. for warming a pipeline cache
+  std::vector<PipelineParameters> pipeline_parameters() const;
+
+  vk::Device const& device() const;
+  bool subgroups() const;
+  uint32_t workgroup_size() const;
+  // values covered by one workgroup of reduce and scan
+  uint32_t block_size() const;
+  // required operations of the subgroup variants as VkSubgroupFeatureFlags
+  static uint32_t required_subgroup_operations();
+
+ private:
+  Shader const& shader(std::string const& name);
+
+  vk::Device m_device;
+  vk::PipelineCache m_cache;
+  std::string m_shader_dir;
+  bool m_subgroups;
+  uint32_t m_workgroup_size;
+  std::map<std::string, Shader> m_shaders;
+  std::map<std::vector<uint32_t>, ComputePipeline> m_pipelines;
+};
+
+// sequence of primitives recorded into one command buffer
+// buffers hold uint32 values and need storage buffer and transfer dst usage,
+// sort_pairs also needs transfer src usage
+// scratch memory and descriptor sets are owned by the batch, it must stay alive until
+// the recorded commands completed or be given the scheduler of the submission
+// the caller synchronizes the buffers with commands before and after the batch
+class PrimitiveBatch {
+ public:
+  PrimitiveBatch(Primitives& primitives, Allocator& allocator, Scheduler* scheduler = nullptr);
+  PrimitiveBatch(PrimitiveBatch const&) = delete;
+
+  PrimitiveBatch& operator=(PrimitiveBatch const&) = delete;
+
+  // output[output_index] = input[0] op ... op input[count - 1]
+  void reduce(vk::Buffer const& input, uint32_t count, vk::Buffer const& output, uint32_t output_index = 0, ScanOp op = ScanOp::eAdd);
+  // output may equal input
+  void inclusive_scan(vk::Buffer const& input, vk::Buffer const& output, uint32_t count, ScanOp op = ScanOp::eAdd);
+  void exclusive_scan(vk::Buffer const& input, vk::Buffer const& output, uint32_t count, ScanOp op = ScanOp::eAdd);
+  // a non-zero flag starts a new segment at its index
+  void segmented_scan(vk::Buffer const& input, vk::Buffer const& flags, vk::Buffer const& output, uint32_t count, bool inclusive, ScanOp op = ScanOp::eAdd);
+  // stable in place sort of the pairs by the lowest key_bits bits of the keys
+  void sort_pairs(vk::Buffer const& keys, vk::Buffer const& values, uint32_t count, uint32_t key_bits = 32);
+  // counts values v with lower <= v < lower + bin_count * bin_width into bins[(v - lower) / bin_width]
+  // the bins are cleared first unless accumulating
+  void histogram(vk::Buffer const& input, uint32_t count, vk::Buffer const& bins, uint32_t bin_count, uint32_t lower = 0, uint32_t bin_width = 1, bool accumulate = false);
+
+  // records all added primitives in order, separated by barriers
+  void record(vk::CommandBuffer const& command_buffer) const;
+  // releases scratch memory and descriptor sets of the added primitives
+  void clear();
+
+  size_t step_count() const;
+
+ private:
+  struct Step {
+    Step();
+
+    // dispatch if set, otherwise fill or copy
+    ComputePipeline const* pipeline;
+    vk::DescriptorSet set;
+    std::vector<uint32_t> constants;
+    uint32_t block_count;
+    vk::Buffer buffer;
+    vk::Buffer buffer_dst;
+    vk::DeviceSize offset;
+    vk::DeviceSize size;
+    uint32_t fill_value;
+  };
+
+  // buffer of count uint32 values kept until clear
+  vk::Buffer scratch(uint32_t count);
+  DescriptorSet allocate_set(ComputePipeline const& pipeline);
+  void dispatch(ComputePipeline const& pipeline, DescriptorSet& set, std::vector<uint32_t> const& constants, uint32_t block_count);
+  void fill(vk::Buffer const& buffer, vk::DeviceSize offset, vk::DeviceSize size, uint32_t value);
+  void copy(vk::Buffer const& src, vk::Buffer const& dst, vk::DeviceSize size);
+  void scan(vk::Buffer const& input, vk::Buffer const& flags, vk::Buffer const& output, uint32_t count, bool inclusive, ScanOp op, bool segmented);
+
+  Primitives* m_primitives;
+  Allocator* m_allocator;
+  Scheduler* m_scheduler;
+  vk::DispatchLoaderDynamic const* m_dispatch;
+  std::vector<Step> m_steps;
+  // buffers are destroyed before their memory is freed
+  std::vector<AllocationHandle> m_allocations;
+  std::vector<Handle<vk::Buffer>> m_buffers;
+  // pools are added when full, sets are released with their pool
+  std::vector<Handle<vk::DescriptorPool>> m_pools;
+  uint32_t m_pool_sets;
+};
+
+#endif
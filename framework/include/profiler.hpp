@@ -0,0 +1,126 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <vulkan/vulkan.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// scopes are only recorded when built with ENABLE_PROFILING
+// names must be string literals or otherwise outlive the export
+#ifdef ENABLE_PROFILING
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__){name}
+#define PROFILE_GPU_SCOPE(profiler, command_buffer, name) GpuProfileScope PROFILE_CONCAT(profile_gpu_scope_, __LINE__){profiler, command_buffer, name}
+#define PROFILE_THREAD_NAME(name) Profiler::set_thread_name(name)
+#else
+#define PROFILE_SCOPE(name) (void)0
+#define PROFILE_GPU_SCOPE(profiler, command_buffer, name) (void)0
+#define PROFILE_THREAD_NAME(name) (void)0
+#endif
+
+// completed cpu or gpu region, times in ns since process start
+struct ProfileEvent {
+  char const* name;
+  uint64_t begin;
+  uint64_t end;
+  // 0 for cpu threads, 1 for gpu queues
+  uint32_t process;
+  uint32_t thread;
+};
+
+// collects cpu scopes into per-thread ring buffers and exports chrome trace json
+// recording only touches thread local data, old events are overwritten when a ring is full
+class Profiler {
+ public:
+  typedef std::chrono::steady_clock clock;
+
+  static void begin(char const* name);
+  static void end();
+  static void set_thread_name(std::string const& name);
+  static void add_events(std::vector<ProfileEvent> const& events);
+
+  // snapshot of all threads, call while no scopes are being recorded
+  static std::vector<ProfileEvent> events();
+  static void clear();
+  // loadable in chrome://tracing and perfetto
+  static void write_trace(std::string const& path);
+
+  static uint64_t to_ns(clock::time_point const& time);
+  static uint64_t now();
+};
+
+class ProfileScope {
+ public:
+  ProfileScope(char const* name) {
+    Profiler::begin(name);
+  }
+  ~ProfileScope() {
+    Profiler::end();
+  }
+  ProfileScope(ProfileScope const&) = delete;
+  ProfileScope& operator=(ProfileScope const&) = delete;
+};
+
+// measures command buffer regions with timestamp queries
+// regions can be recorded from several threads, reset must be recorded before
+// all regions in submission order
+class GpuProfiler {
+ public:
+  GpuProfiler();
+  GpuProfiler(vk::Device const& device, vk::PhysicalDevice const& phys_device, uint32_t queue_family, uint32_t max_regions = 256);
+  GpuProfiler(GpuProfiler&& rhs);
+  GpuProfiler(GpuProfiler const&) = delete;
+
+  ~GpuProfiler();
+
+  GpuProfiler& operator=(GpuProfiler&& rhs);
+  GpuProfiler& operator=(GpuProfiler const&) = delete;
+
+  void reset(vk::CommandBuffer const& command_buffer);
+  // returns region index, regions beyond the capacity are dropped
+  uint32_t begin(vk::CommandBuffer const& command_buffer, char const* name, vk::PipelineStageFlagBits stage = vk::PipelineStageFlagBits::eTopOfPipe);
+  void end(vk::CommandBuffer const& command_buffer, uint32_t region, vk::PipelineStageFlagBits stage = vk::PipelineStageFlagBits::eBottomOfPipe);
+  // waits for results and hands them to the Profiler
+  // the gpu has no common clock with the host, so the first region is placed at submit_time
+  void collect(Profiler::clock::time_point const& submit_time);
+
+  bool supported() const;
+
+ private:
+  void cleanup();
+
+  vk::Device m_device;
+  vk::DispatchLoaderDynamic const* m_dispatch;
+  vk::QueryPool m_pool;
+  std::vector<char const*> m_names;
+  std::atomic<uint32_t> m_count;
+  uint32_t m_queue_family;
+  double m_period;
+  uint64_t m_mask;
+};
+
+class GpuProfileScope {
+ public:
+  GpuProfileScope(GpuProfiler& profiler, vk::CommandBuffer const& command_buffer, char const* name)
+   :m_profiler(profiler)
+   ,m_command_buffer(command_buffer)
+   ,m_region{profiler.begin(command_buffer, name)}
+  {}
+  ~GpuProfileScope() {
+    m_profiler.end(m_command_buffer, m_region);
+  }
+  GpuProfileScope(GpuProfileScope const&) = delete;
+  GpuProfileScope& operator=(GpuProfileScope const&) = delete;
+
+ private:
+  GpuProfiler& m_profiler;
+  vk::CommandBuffer m_command_buffer;
+  uint32_t m_region;
+};
+
+#endif
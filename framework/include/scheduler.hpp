@@ -0,0 +1,102 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include "bring_up.hpp"
+#include "deletion_queue.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// records jobs into per-frame, per-thread command pools
+// all jobs of a frame are submitted with a single vkQueueSubmit
+// a frame slot is recycled once its fence signalled, so recording overlaps execution
+class Scheduler {
+ public:
+  struct Timing {
+    uint64_t frame;
+    uint32_t job;
+    // time between begin_job and end_job
+    double record_ms;
+    // time between submission and observed fence signal
+    double latency_ms;
+  };
+
+  Scheduler();
+  Scheduler(vk::Device const& device, uint32_t queue_family, vk::Queue const& queue, uint32_t frame_count = 3, uint32_t thread_count = 1);
+  Scheduler(Scheduler&& rhs);
+  Scheduler(Scheduler const&) = delete;
+
+  ~Scheduler();
+
+  Scheduler& operator=(Scheduler&& rhs);
+  Scheduler& operator=(Scheduler const&) = delete;
+
+  // waits until the next frame slot has retired
+  void begin_frame();
+  // jobs of different threads may be recorded concurrently
+  uint32_t begin_job(uint32_t thread = 0);
+  vk::CommandBuffer command_buffer(uint32_t job) const;
+  // job waits on the given jobs of the same frame at the given stages
+  // dependencies must have been begun before the job, throws otherwise
+  void end_job(uint32_t job, std::vector<uint32_t> const& dependencies = {}, vk::PipelineStageFlags const& wait_stages = vk::PipelineStageFlagBits::eAllCommands);
+  void end_frame();
+
+  void wait_idle();
+  // runs deleter once all frames up to the one currently recorded have retired
+  // may be called from any thread, the deleter runs in begin_frame, wait_idle or on destruction
+  void defer(std::function<void()> const& deleter);
+  // returns timings of retired jobs since last call
+  std::vector<Timing> take_timings();
+  uint64_t frame_index() const;
+
+ private:
+  typedef std::chrono::steady_clock clock;
+
+  struct Job {
+    vk::CommandBuffer command_buffer;
+    std::vector<uint32_t> dependencies;
+    vk::PipelineStageFlags wait_stages;
+    clock::time_point record_begin;
+    double record_ms;
+  };
+
+  struct ThreadPool {
+    vk::CommandPool pool;
+    std::vector<vk::CommandBuffer> command_buffers;
+    size_t used;
+  };
+
+  struct Frame {
+    vk::Fence fence;
+    std::vector<ThreadPool> pools;
+    std::vector<Job> jobs;
+    // one per dependency edge, a binary semaphore is only waited on once
+    // reused in edge order across frames
+    std::vector<vk::Semaphore> semaphores;
+    clock::time_point submit_time;
+    uint64_t index;
+    bool pending;
+  };
+
+  void cleanup();
+  // returns false if frame is still executing and wait was not requested
+  bool retire(Frame& frame, bool wait);
+  // frames below the returned index have retired
+  uint64_t completed_frames() const;
+
+  vk::Device m_device;
+  // recording and submission go through the device table
+  vk::DispatchLoaderDynamic const* m_dispatch;
+  vk::Queue m_queue;
+  std::vector<Frame> m_frames;
+  uint64_t m_frame_index;
+  std::vector<Timing> m_timings;
+  DeletionQueue m_deletions;
+  mutable std::mutex m_mutex;
+};
+
+#endif
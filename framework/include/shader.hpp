@@ -0,0 +1,64 @@
+#ifndef SHADER_HPP
+#define SHADER_HPP
+
+#include <vulkan/vulkan.hpp>
+
+#include <glm/vec3.hpp>
+
+#include <string>
+#include <vector>
+
+// descriptor used by a shader, reflected from SPIR-V
+struct ShaderBinding {
+  uint32_t set;
+  uint32_t binding;
+  vk::DescriptorType type;
+  uint32_t count;
+};
+
+// loads SPIR-V, creates module and reflects interface
+class Shader {
+ public:
+  Shader();
+  Shader(vk::Device const& device, std::string const& path);
+  Shader(vk::Device const& device, std::vector<uint32_t> const& code);
+  Shader(Shader&& rhs);
+  Shader(Shader const&) = delete;
+
+  ~Shader();
+
+  Shader& operator=(Shader&& rhs);
+  Shader& operator=(Shader const&) = delete;
+
+  vk::ShaderModule const& module() const;
+  // stage of the first entry point, callers reject stages they cannot use
+  vk::ShaderStageFlagBits stage() const;
+  std::string const& entry_point() const;
+  std::vector<uint32_t> const& code() const;
+
+  std::vector<ShaderBinding> const& bindings() const;
+  uint32_t push_constant_size() const;
+  // workgroup size declared in the shader
+  glm::uvec3 const& local_size() const;
+  // specialization constant ids of local size components, -1 if not specializable
+  glm::ivec3 const& local_size_ids() const;
+
+  static std::vector<uint32_t> load(std::string const& path);
+
+ private:
+  void cleanup();
+  void reflect();
+
+  vk::Device m_device;
+  vk::DispatchLoaderDynamic const* m_dispatch;
+  vk::ShaderModule m_module;
+  vk::ShaderStageFlagBits m_stage;
+  std::string m_entry_point;
+  std::vector<uint32_t> m_code;
+  std::vector<ShaderBinding> m_bindings;
+  uint32_t m_push_constant_size;
+  glm::uvec3 m_local_size;
+  glm::ivec3 m_local_size_ids;
+};
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef TASK_GRAPH_HPP
+#define TASK_GRAPH_HPP
+
+#include "allocator.hpp"
+#include "bring_up.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// how a pass accesses a resource, determines stages, access masks and image layout
+enum class ResourceUsage {
+  eStorageRead,
+  eStorageWrite,
+  eStorageReadWrite,
+  // images only, shader read only optimal layout
+  eSampled,
+  // buffers only
+  eUniform,
+  eIndirect,
+  eTransferSrc,
+  eTransferDst,
+  // only meaningful as final usage, after a fence wait
+  eHostRead
+};
+
+// records compute and transfer passes in declaration order
+// passes declare the resources they use, barriers and layout transitions are derived
+// from the declarations and batched into one pipelineBarrier per pass
+// transient resources with disjoint lifetimes share memory
+class TaskGraph {
+ public:
+  typedef uint32_t Resource;
+  // receives command buffer and graph to resolve resources
+  typedef std::function<void(vk::CommandBuffer const&, TaskGraph const&)> Function;
+
+  struct Use {
+    Resource resource;
+    ResourceUsage usage;
+  };
+
+  struct Statistics {
+    Statistics();
+
+    size_t barrier_count;
+    size_t batch_count;
+    // memory of all transients if they were not aliased
+    vk::DeviceSize bytes_transient;
+    vk::DeviceSize bytes_allocated;
+  };
+
+  TaskGraph();
+  TaskGraph(vk::Device const& device, Allocator& allocator);
+  TaskGraph(TaskGraph&& rhs);
+  TaskGraph(TaskGraph const&) = delete;
+
+  ~TaskGraph();
+
+  TaskGraph& operator=(TaskGraph&& rhs);
+  TaskGraph& operator=(TaskGraph const&) = delete;
+
+  // imported resources are owned by the caller, prior work must already be synchronized
+  Resource import_buffer(vk::Buffer const& buffer);
+  Resource import_image(vk::Image const& image, vk::ImageSubresourceRange const& range, vk::ImageLayout layout = vk::ImageLayout::eUndefined, vk::ImageView const& view = vk::ImageView{});
+  // transients are created on compile and only valid during execution of the graph
+  // barriers of depth and stencil images cover all aspects of the format, their views the depth aspect
+  Resource create_buffer(vk::BufferCreateInfo const& info);
+  Resource create_image(vk::ImageCreateInfo const& info);
+
+  // a resource may only be used once per pass, combined accesses use eStorageReadWrite
+  uint32_t add_pass(std::string const& name, std::vector<Use> const& uses, Function const& fn);
+  // usage after the last pass, adds a trailing barrier
+  void set_final_usage(Resource resource, ResourceUsage usage);
+
+  // creates and aliases transients and derives barriers
+  void compile();
+  // consecutive executions must be separated by a fence wait
+  void execute(vk::CommandBuffer const& command_buffer) const;
+
+  vk::Buffer const& buffer(Resource resource) const;
+  vk::Image const& image(Resource resource) const;
+  vk::ImageView const& view(Resource resource) const;
+  Statistics statistics() const;
+
+  // layout in which a pass sees an image with the given usage
+  static vk::ImageLayout layout(ResourceUsage usage);
+
+ private:
+  struct ResourceInfo {
+    bool is_image;
+    bool transient;
+    vk::Buffer buffer;
+    vk::Image image;
+    vk::ImageView view;
+    vk::ImageSubresourceRange range;
+    vk::ImageLayout initial_layout;
+    vk::BufferCreateInfo info_buffer;
+    vk::ImageCreateInfo info_image;
+    vk::MemoryRequirements requirements;
+    // lifetime in passes, the final usage counts as pass after the last
+    uint32_t first_pass;
+    uint32_t last_pass;
+    // transient previously occupying the same memory
+    int32_t alias_of;
+    bool has_final;
+    ResourceUsage final_usage;
+  };
+
+  // synchronization state of a resource while walking the passes
+  struct State {
+    vk::PipelineStageFlags write_stages;
+    vk::AccessFlags write_access;
+    // reads since the last write
+    vk::PipelineStageFlags read_stages;
+    // destinations the last write was already made visible to
+    vk::PipelineStageFlags visible_stages;
+    vk::AccessFlags visible_access;
+    vk::ImageLayout layout;
+    bool used;
+  };
+
+  struct Batch {
+    vk::PipelineStageFlags src_stages;
+    vk::PipelineStageFlags dst_stages;
+    // buffers are synchronized with one global barrier
+    vk::MemoryBarrier memory;
+    bool has_memory;
+    std::vector<vk::ImageMemoryBarrier> images;
+  };
+
+  struct Pass {
+    std::string name;
+    std::vector<Use> uses;
+    Function function;
+    Batch barriers;
+  };
+
+  // memory shared by transients with disjoint lifetimes
+  struct Slot {
+    vk::MemoryRequirements requirements;
+    bool linear;
+    std::vector<uint32_t> resources;
+    Allocation allocation;
+  };
+
+  void cleanup();
+  void release_transients();
+  void allocate_transients();
+  void add_barrier(std::vector<State>& states, Resource index, ResourceUsage usage, Batch& batch) const;
+  void record(vk::CommandBuffer const& command_buffer, Batch const& batch) const;
+
+  vk::Device m_device;
+  vk::DispatchLoaderDynamic const* m_dispatch;
+  Allocator* m_allocator;
+  std::vector<ResourceInfo> m_resources;
+  std::vector<Pass> m_passes;
+  std::vector<Slot> m_slots;
+  Batch m_final;
+  Statistics m_statistics;
+  bool m_compiled;
+};
+
+#endif
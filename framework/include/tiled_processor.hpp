@@ -0,0 +1,94 @@
+#ifndef TILED_PROCESSOR_HPP
+#define TILED_PROCESSOR_HPP
+
+#include "allocator.hpp"
+#include "bring_up.hpp"
+#include "handle.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// part of the output computed in one submission
+struct Tile {
+  uint32_t index;
+  // output region in image coordinates
+  uint32_t x;
+  uint32_t y;
+  uint32_t width;
+  uint32_t height;
+  // input region including the halo, clamped to the image
+  uint32_t input_x;
+  uint32_t input_y;
+  uint32_t input_width;
+  uint32_t input_height;
+};
+
+// processes rgba8 images of any size in tiles that fit the device limits
+// the input of each tile is extended by the halo on every side, so kernels can read neighbours
+// slot_count tiles are in flight, the source fills one while others are computed and read back
+// finished rows are handed to the sink in full-width strips of tile_size rows,
+// so host memory is bounded by the image width and not its height
+class TiledProcessor {
+ public:
+  // fills the input region of the tile, rows are row_pitch bytes apart
+  typedef std::function<void(Tile const& tile, uint8_t* pixels, size_t row_pitch)> Source;
+  // records the work of a tile, both images of the slot are in general layout
+  // the output region starts at the origin of the output image, the input region at the origin of the input image
+  typedef std::function<void(vk::CommandBuffer const& command_buffer, Tile const& tile, uint32_t slot)> Kernel;
+  // receives finished rows from top to bottom
+  typedef std::function<void(uint8_t const* pixels, uint32_t y, uint32_t row_count, size_t row_pitch)> Sink;
+
+  TiledProcessor(vk::Device const& device, vk::PhysicalDevice const& phys_device, Allocator& allocator, uint32_t queue_family, vk::Queue const& queue, uint32_t tile_size = 1024, uint32_t halo = 0, uint32_t slot_count = 2);
+  TiledProcessor(TiledProcessor const&) = delete;
+
+  ~TiledProcessor();
+
+  TiledProcessor& operator=(TiledProcessor const&) = delete;
+
+  // without a source the input images are left undefined
+  void run(uint32_t width, uint32_t height, Source const& source, Kernel const& kernel, Sink const& sink);
+  void wait_idle();
+
+  // storage images to bind for the kernel, sized tile_size + 2 * halo and tile_size
+  vk::ImageView const& input_view(uint32_t slot) const;
+  vk::ImageView const& output_view(uint32_t slot) const;
+  uint32_t tile_size() const;
+  uint32_t halo() const;
+  uint32_t slot_count() const;
+
+ private:
+  struct Slot {
+    vk::CommandBuffer command_buffer;
+    Handle<vk::Fence> fence;
+    Handle<vk::Image> input;
+    AllocationHandle allocation_input;
+    Handle<vk::ImageView> view_input;
+    Handle<vk::Image> output;
+    AllocationHandle allocation_output;
+    Handle<vk::ImageView> view_output;
+    Handle<vk::Buffer> upload;
+    AllocationHandle allocation_upload;
+    Handle<vk::Buffer> readback;
+    AllocationHandle allocation_readback;
+    Tile tile;
+    bool busy;
+  };
+
+  void submit(Slot& slot, Tile const& tile, Source const& source, Kernel const& kernel, uint32_t slot_index);
+  // copies the tile into the strip and passes completed strips on
+  void retire(Slot& slot, std::vector<uint8_t>& strip, uint32_t width, Sink const& sink);
+
+  vk::Device m_device;
+  vk::DispatchLoaderDynamic const* m_dispatch;
+  Allocator* m_allocator;
+  vk::Queue m_queue;
+  uint32_t m_tile_size;
+  uint32_t m_halo;
+  Handle<vk::CommandPool> m_command_pool;
+  std::vector<Slot> m_slots;
+};
+
+#endif
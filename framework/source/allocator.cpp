@@ -0,0 +1,441 @@
+#include "allocator.hpp"
+
+#include "bring_up.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+
+static vk::DeviceSize align_up(vk::DeviceSize value, vk::DeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// whether two byte addresses lie on the same granularity page
+static bool same_page(vk::DeviceSize a, vk::DeviceSize b, vk::DeviceSize granularity) {
+  return a / granularity == b / granularity;
+}
+
+static int bit_count(vk::MemoryPropertyFlags const& flags) {
+  int count = 0;
+  for (uint32_t bits = uint32_t(flags); bits != 0; bits &= bits - 1) {
+    ++count;
+  }
+  return count;
+}
+
+// properties a type must have, should have and should rather not have for a usage
+struct UsagePolicy {
+  vk::MemoryPropertyFlags required;
+  vk::MemoryPropertyFlags preferred;
+  vk::MemoryPropertyFlags unwanted;
+};
+
+static UsagePolicy usage_policy(MemoryUsage usage) {
+  UsagePolicy policy{};
+  switch (usage) {
+    case MemoryUsage::eDeviceLocal:
+      policy.required = vk::MemoryPropertyFlagBits::eDeviceLocal;
+      // keep the small mappable window of discrete cards for staging
+      policy.unwanted = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eLazilyAllocated;
+      break;
+    case MemoryUsage::eUpload:
+      policy.required = vk::MemoryPropertyFlagBits::eHostVisible;
+      policy.preferred = vk::MemoryPropertyFlagBits::eHostCoherent;
+      // uncached write-combined memory is fastest for sequential writes and device reads
+      policy.unwanted = vk::MemoryPropertyFlagBits::eHostCached | vk::MemoryPropertyFlagBits::eDeviceLocal;
+      break;
+    case MemoryUsage::eReadback:
+      policy.required = vk::MemoryPropertyFlagBits::eHostVisible;
+      // host reads from uncached memory are an order of magnitude slower
+      policy.preferred = vk::MemoryPropertyFlagBits::eHostCached;
+      policy.unwanted = vk::MemoryPropertyFlagBits::eDeviceLocal;
+      break;
+    case MemoryUsage::eLazy:
+      policy.preferred = vk::MemoryPropertyFlagBits::eLazilyAllocated | vk::MemoryPropertyFlagBits::eDeviceLocal;
+      policy.unwanted = vk::MemoryPropertyFlagBits::eHostVisible;
+      break;
+  }
+  return policy;
+}
+
+Allocation::Allocation()
+ :memory{}
+ ,offset{0}
+ ,size{0}
+ ,type{0}
+ ,ptr{nullptr}
+ ,block{0}
+{}
+
+Allocator::Statistics::Statistics()
+ :block_count{0}
+ ,allocation_count{0}
+ ,free_range_count{0}
+ ,bytes_reserved{0}
+ ,bytes_used{0}
+ ,largest_free_range{0}
+{}
+
+Allocator::Allocator()
+ :m_device{}
+ ,m_dispatch{nullptr}
+ ,m_mem_properties{}
+ ,m_block_size{0}
+ ,m_granularity{1}
+ ,m_atom_size{1}
+ ,m_pools{}
+{}
+
+Allocator::Allocator(vk::Device const& device, vk::PhysicalDevice const& phys_device, vk::DeviceSize block_size)
+ :m_device{device}
+ ,m_dispatch{&device_dispatch(device)}
+ ,m_mem_properties{phys_device.getMemoryProperties()}
+ ,m_block_size{block_size}
+ ,m_granularity{std::max(phys_device.getProperties().limits.bufferImageGranularity, vk::DeviceSize{1})}
+ ,m_atom_size{std::max(phys_device.getProperties().limits.nonCoherentAtomSize, vk::DeviceSize{1})}
+ ,m_pools(m_mem_properties.memoryTypeCount)
+{}
+
+Allocator::Allocator(Allocator&& rhs)
+ :Allocator{}
+{
+  std::swap(m_device, rhs.m_device);
+  std::swap(m_dispatch, rhs.m_dispatch);
+  std::swap(m_mem_properties, rhs.m_mem_properties);
+  std::swap(m_block_size, rhs.m_block_size);
+  std::swap(m_granularity, rhs.m_granularity);
+  std::swap(m_atom_size, rhs.m_atom_size);
+  std::swap(m_pools, rhs.m_pools);
+}
+
+Allocator& Allocator::operator=(Allocator&& rhs) {
+  cleanup();
+  std::swap(m_device, rhs.m_device);
+  std::swap(m_dispatch, rhs.m_dispatch);
+  std::swap(m_mem_properties, rhs.m_mem_properties);
+  std::swap(m_block_size, rhs.m_block_size);
+  std::swap(m_granularity, rhs.m_granularity);
+  std::swap(m_atom_size, rhs.m_atom_size);
+  std::swap(m_pools, rhs.m_pools);
+  return *this;
+}
+
+Allocator::~Allocator() {
+  cleanup();
+}
+
+void Allocator::cleanup() {
+  for (auto& pool : m_pools) {
+    for (auto& block : pool) {
+      release_block(block);
+    }
+  }
+  m_pools.clear();
+}
+
+uint32_t Allocator::find_memory_type(uint32_t type_bits, vk::MemoryPropertyFlags const& properties) const {
+  for (uint32_t i = 0; i < m_mem_properties.memoryTypeCount; ++i) {
+    if ((type_bits & (1u << i))
+     && (m_mem_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+      return i;
+    }
+  }
+  throw std::runtime_error{"No memory type with requested properties"};
+}
+
+uint32_t Allocator::find_memory_type(uint32_t type_bits, MemoryUsage usage) const {
+  UsagePolicy policy = usage_policy(usage);
+  uint32_t best = UINT32_MAX;
+  int best_score = 0;
+  for (uint32_t i = 0; i < m_mem_properties.memoryTypeCount; ++i) {
+    vk::MemoryPropertyFlags flags = m_mem_properties.memoryTypes[i].propertyFlags;
+    if (!(type_bits & (1u << i))
+     || (flags & policy.required) != policy.required
+     || (flags & vk::MemoryPropertyFlagBits::eProtected)) {
+      continue;
+    }
+    // preferred properties outweigh unwanted ones, coherence only breaks ties
+    int score = 4 * bit_count(flags & policy.preferred) - 2 * bit_count(flags & policy.unwanted);
+    if (flags & vk::MemoryPropertyFlagBits::eHostCoherent) {
+      score += 1;
+    }
+    if (best == UINT32_MAX || score > best_score) {
+      best = i;
+      best_score = score;
+    }
+  }
+  if (best == UINT32_MAX) {
+    throw std::runtime_error{"No memory type for requested usage"};
+  }
+  return best;
+}
+
+Allocation Allocator::allocate(vk::MemoryRequirements const& requirements, vk::MemoryPropertyFlags const& properties, bool linear) {
+  return allocate_type(requirements, find_memory_type(requirements.memoryTypeBits, properties), linear);
+}
+
+Allocation Allocator::allocate(vk::MemoryRequirements const& requirements, MemoryUsage usage, bool linear) {
+  return allocate_type(requirements, find_memory_type(requirements.memoryTypeBits, usage), linear);
+}
+
+Allocation Allocator::allocate_type(vk::MemoryRequirements const& requirements_resource, uint32_t type, bool linear) {
+  vk::MemoryRequirements requirements = requirements_resource;
+  // flushes and invalidates are widened to whole atoms, which must not reach into neighbours
+  vk::MemoryPropertyFlags flags = m_mem_properties.memoryTypes[type].propertyFlags;
+  if ((flags & vk::MemoryPropertyFlagBits::eHostVisible) && !(flags & vk::MemoryPropertyFlagBits::eHostCoherent)) {
+    // both are powers of two
+    requirements.alignment = std::max(requirements.alignment, m_atom_size);
+    requirements.size = align_up(requirements.size, m_atom_size);
+  }
+
+  std::lock_guard<std::mutex> lock{m_mutex};
+  auto& pool = m_pools[type];
+
+  Allocation allocation{};
+  allocation.type = type;
+  allocation.size = requirements_resource.size;
+  // large resources get their own memory object
+  bool dedicated = requirements.size > m_block_size / 2;
+  bool found = false;
+  if (!dedicated) {
+    for (uint32_t i = 0; i < pool.size() && !found; ++i) {
+      if (pool[i].memory && !pool[i].dedicated) {
+        found = allocate_from(pool[i], requirements, linear, allocation.offset);
+        allocation.block = i;
+      }
+    }
+  }
+  if (!found) {
+    allocation.block = add_block(type, requirements.size, dedicated);
+    if (!allocate_from(pool[allocation.block], requirements, linear, allocation.offset)) {
+      throw std::runtime_error{"Failed to sub-allocate from new block"};
+    }
+  }
+
+  Block const& block = pool[allocation.block];
+  allocation.memory = block.memory;
+  allocation.ptr = block.ptr ? block.ptr + allocation.offset : nullptr;
+  return allocation;
+}
+
+Allocation Allocator::allocate(vk::Buffer const& buffer, vk::MemoryPropertyFlags const& properties) {
+  Allocation allocation = allocate(m_device.getBufferMemoryRequirements(buffer, *m_dispatch), properties, true);
+  m_device.bindBufferMemory(buffer, allocation.memory, allocation.offset, *m_dispatch);
+  return allocation;
+}
+
+Allocation Allocator::allocate(vk::Image const& image, vk::MemoryPropertyFlags const& properties, vk::ImageTiling tiling) {
+  Allocation allocation = allocate(m_device.getImageMemoryRequirements(image, *m_dispatch), properties, tiling == vk::ImageTiling::eLinear);
+  m_device.bindImageMemory(image, allocation.memory, allocation.offset, *m_dispatch);
+  return allocation;
+}
+
+Allocation Allocator::allocate(vk::Buffer const& buffer, MemoryUsage usage) {
+  Allocation allocation = allocate(m_device.getBufferMemoryRequirements(buffer, *m_dispatch), usage, true);
+  m_device.bindBufferMemory(buffer, allocation.memory, allocation.offset, *m_dispatch);
+  return allocation;
+}
+
+Allocation Allocator::allocate(vk::Image const& image, MemoryUsage usage, vk::ImageTiling tiling) {
+  Allocation allocation = allocate(m_device.getImageMemoryRequirements(image, *m_dispatch), usage, tiling == vk::ImageTiling::eLinear);
+  m_device.bindImageMemory(image, allocation.memory, allocation.offset, *m_dispatch);
+  return allocation;
+}
+
+void Allocator::free(Allocation& allocation) {
+  if (!allocation.memory) return;
+
+  std::lock_guard<std::mutex> lock{m_mutex};
+  Block& block = m_pools[allocation.type][allocation.block];
+  auto it = block.ranges.find(allocation.offset);
+  if (it == block.ranges.end() || it->second.free) {
+    throw std::runtime_error{"Freeing unknown allocation"};
+  }
+  it->second.free = true;
+  // merge with free neighbours
+  auto next = std::next(it);
+  if (next != block.ranges.end() && next->second.free) {
+    it->second.size += next->second.size;
+    block.ranges.erase(next);
+  }
+  if (it != block.ranges.begin()) {
+    auto prev = std::prev(it);
+    if (prev->second.free) {
+      prev->second.size += it->second.size;
+      block.ranges.erase(it);
+    }
+  }
+  --block.allocation_count;
+  if (block.dedicated) {
+    release_block(block);
+  }
+  allocation = Allocation{};
+}
+
+void Allocator::flush(Allocation const& allocation, vk::DeviceSize offset, vk::DeviceSize size) const {
+  if (is_coherent(allocation)) return;
+  m_device.flushMappedMemoryRanges(mapped_range(allocation, offset, size), *m_dispatch);
+}
+
+void Allocator::invalidate(Allocation const& allocation, vk::DeviceSize offset, vk::DeviceSize size) const {
+  if (is_coherent(allocation)) return;
+  m_device.invalidateMappedMemoryRanges(mapped_range(allocation, offset, size), *m_dispatch);
+}
+
+bool Allocator::is_coherent(Allocation const& allocation) const {
+  return bool(m_mem_properties.memoryTypes[allocation.type].propertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent);
+}
+
+vk::DeviceSize Allocator::release_empty_blocks() {
+  std::lock_guard<std::mutex> lock{m_mutex};
+  vk::DeviceSize freed = 0;
+  for (auto& pool : m_pools) {
+    for (auto& block : pool) {
+      if (block.memory && block.allocation_count == 0) {
+        freed += block.size;
+        release_block(block);
+      }
+    }
+  }
+  return freed;
+}
+
+Allocator::Statistics Allocator::statistics() const {
+  std::lock_guard<std::mutex> lock{m_mutex};
+  Statistics stats{};
+  for (auto const& pool : m_pools) {
+    for (auto const& block : pool) {
+      if (!block.memory) continue;
+      ++stats.block_count;
+      stats.allocation_count += block.allocation_count;
+      stats.bytes_reserved += block.size;
+      for (auto const& range : block.ranges) {
+        if (range.second.free) {
+          ++stats.free_range_count;
+          stats.largest_free_range = std::max(stats.largest_free_range, range.second.size);
+        }
+        else {
+          stats.bytes_used += range.second.size;
+        }
+      }
+    }
+  }
+  return stats;
+}
+
+bool Allocator::allocate_from(Block& block, vk::MemoryRequirements const& requirements, bool linear, vk::DeviceSize& offset) {
+  // first fit over free ranges
+  for (auto it = block.ranges.begin(); it != block.ranges.end(); ++it) {
+    if (!it->second.free || it->second.size < requirements.size) continue;
+
+    vk::DeviceSize begin = it->first;
+    vk::DeviceSize end = begin + it->second.size;
+    vk::DeviceSize start = align_up(begin, requirements.alignment);
+    // linear and optimal resources may not share a granularity page
+    if (it != block.ranges.begin()) {
+      auto prev = std::prev(it);
+      if (!prev->second.free && prev->second.linear != linear
+       && same_page(prev->first + prev->second.size - 1, start, m_granularity)) {
+        start = align_up(start, m_granularity);
+      }
+    }
+    if (start + requirements.size > end) continue;
+    auto next = std::next(it);
+    if (next != block.ranges.end() && !next->second.free && next->second.linear != linear
+     && same_page(start + requirements.size - 1, next->first, m_granularity)) {
+      continue;
+    }
+    // split range into padding, allocation and remainder
+    if (start > begin) {
+      it->second.size = start - begin;
+    }
+    else {
+      block.ranges.erase(it);
+    }
+    Range used{};
+    used.size = requirements.size;
+    used.free = false;
+    used.linear = linear;
+    block.ranges[start] = used;
+    if (start + requirements.size < end) {
+      Range rest{};
+      rest.size = end - (start + requirements.size);
+      rest.free = true;
+      rest.linear = false;
+      block.ranges[start + requirements.size] = rest;
+    }
+    ++block.allocation_count;
+    offset = start;
+    return true;
+  }
+  return false;
+}
+
+uint32_t Allocator::add_block(uint32_t type, vk::DeviceSize size, bool dedicated) {
+  vk::MemoryType const& mem_type = m_mem_properties.memoryTypes[type];
+  if (!dedicated) {
+    // keep small heaps from being exhausted by a single block
+    vk::DeviceSize heap_size = m_mem_properties.memoryHeaps[mem_type.heapIndex].size;
+    size = std::max(size, std::min(m_block_size, heap_size / 8));
+  }
+
+  vk::MemoryAllocateInfo info_memory{};
+  info_memory.allocationSize = size;
+  info_memory.memoryTypeIndex = type;
+
+  Block block{};
+  block.memory = m_device.allocateMemory(info_memory, nullptr, *m_dispatch);
+  block.size = size;
+  block.ptr = nullptr;
+  block.allocation_count = 0;
+  block.dedicated = dedicated;
+  if (mem_type.propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible) {
+    block.ptr = static_cast<uint8_t*>(m_device.mapMemory(block.memory, 0, VK_WHOLE_SIZE, vk::MemoryMapFlags{}, *m_dispatch));
+  }
+  Range range{};
+  range.size = size;
+  range.free = true;
+  range.linear = false;
+  block.ranges[0] = range;
+
+  auto& pool = m_pools[type];
+  // reuse slot of released block
+  for (uint32_t i = 0; i < pool.size(); ++i) {
+    if (!pool[i].memory) {
+      pool[i] = std::move(block);
+      return i;
+    }
+  }
+  pool.push_back(std::move(block));
+  return uint32_t(pool.size() - 1);
+}
+
+vk::MappedMemoryRange Allocator::mapped_range(Allocation const& allocation, vk::DeviceSize offset, vk::DeviceSize size) const {
+  vk::DeviceSize begin = allocation.offset + offset;
+  vk::DeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : begin + size;
+  vk::DeviceSize block_size = 0;
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    block_size = m_pools[allocation.type][allocation.block].size;
+  }
+  // ranges must start and end on atom boundaries or end at the end of the memory
+  vk::MappedMemoryRange range{};
+  range.memory = allocation.memory;
+  range.offset = begin / m_atom_size * m_atom_size;
+  end = align_up(end, m_atom_size);
+  range.size = end >= block_size ? VK_WHOLE_SIZE : end - range.offset;
+  return range;
+}
+
+void Allocator::release_block(Block& block) {
+  if (block.memory) {
+    if (block.ptr) {
+      m_device.unmapMemory(block.memory, *m_dispatch);
+    }
+    m_device.freeMemory(block.memory, nullptr, *m_dispatch);
+    block.memory = vk::DeviceMemory{};
+    block.ptr = nullptr;
+    block.ranges.clear();
+    block.allocation_count = 0;
+  }
+}
@@ -0,0 +1,222 @@
+#include "benchmark.hpp"
+#include "bring_up.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+BenchmarkResult::BenchmarkResult()
+ :name{}
+ ,variant{}
+ ,bytes{0}
+ ,items{0}
+ ,clock{}
+ ,samples_ms{}
+{}
+
+BenchmarkResult::BenchmarkResult(std::string const& name, std::string const& variant, uint64_t bytes, uint64_t items, std::string const& clock)
+ :name{name}
+ ,variant{variant}
+ ,bytes{bytes}
+ ,items{items}
+ ,clock{clock}
+ ,samples_ms{}
+{}
+
+HeadlessDevice::HeadlessDevice()
+ :instance{}
+ ,selection{}
+ ,device{}
+ ,queue{}
+{}
+
+BenchmarkSubmitter::BenchmarkSubmitter()
+ :m_device{}
+ ,m_dispatch{nullptr}
+ ,m_queue{}
+ ,m_command_pool{}
+ ,m_command_buffer{}
+ ,m_fence{}
+ ,m_query_pool{}
+ ,m_timestamp_mask{0}
+ ,m_timestamp_period{0.0}
+ ,m_clock{"host"}
+{}
+
+BenchmarkSubmitter::BenchmarkSubmitter(HeadlessDevice const& headless)
+ :BenchmarkSubmitter{}
+{
+  m_device = headless.device;
+  m_dispatch = &device_dispatch(m_device);
+  m_queue = headless.queue;
+  uint32_t queue_family = headless.selection.queue_family;
+
+  vk::CommandPoolCreateInfo info_command_pool{};
+  info_command_pool.queueFamilyIndex = queue_family;
+  info_command_pool.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+  m_command_pool = Handle<vk::CommandPool>{m_device, m_device.createCommandPool(info_command_pool, nullptr, *m_dispatch)};
+  vk::CommandBufferAllocateInfo info_command_buffer{};
+  info_command_buffer.commandPool = m_command_pool.get();
+  info_command_buffer.level = vk::CommandBufferLevel::ePrimary;
+  info_command_buffer.commandBufferCount = 1;
+  m_command_buffer = m_device.allocateCommandBuffers(info_command_buffer, *m_dispatch).front();
+  m_fence = Handle<vk::Fence>{m_device, m_device.createFence(vk::FenceCreateInfo{}, nullptr, *m_dispatch)};
+
+  uint32_t valid_bits = headless.selection.capabilities.queue_families[queue_family].timestampValidBits;
+  if (valid_bits > 0) {
+    m_timestamp_mask = valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+    m_timestamp_period = double(headless.selection.phys_device.getProperties().limits.timestampPeriod);
+    vk::QueryPoolCreateInfo info_pool{};
+    info_pool.queryType = vk::QueryType::eTimestamp;
+    info_pool.queryCount = 2;
+    m_query_pool = Handle<vk::QueryPool>{m_device, m_device.createQueryPool(info_pool, nullptr, *m_dispatch)};
+    m_clock = "gpu";
+  }
+}
+
+double BenchmarkSubmitter::submit(std::function<void(vk::CommandBuffer const&)> const& fn, bool timed) {
+  bool timestamps = timed && m_query_pool.get();
+  vk::CommandBufferBeginInfo info_cb_begin{};
+  info_cb_begin.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+  m_command_buffer.begin(info_cb_begin, *m_dispatch);
+  if (timestamps) {
+    m_command_buffer.resetQueryPool(m_query_pool.get(), 0, 2, *m_dispatch);
+    m_command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, m_query_pool.get(), 0, *m_dispatch);
+  }
+  fn(m_command_buffer);
+  if (timestamps) {
+    m_command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_query_pool.get(), 1, *m_dispatch);
+  }
+  m_command_buffer.end(*m_dispatch);
+  vk::SubmitInfo info_submit{};
+  info_submit.commandBufferCount = 1;
+  info_submit.pCommandBuffers = &m_command_buffer;
+  auto start = std::chrono::steady_clock::now();
+  m_queue.submit(info_submit, m_fence.get(), *m_dispatch);
+  m_device.waitForFences(m_fence.get(), VK_TRUE, UINT64_MAX, *m_dispatch);
+  double time_host = elapsed_ms(start);
+  m_device.resetFences(m_fence.get(), *m_dispatch);
+  m_command_buffer.reset(vk::CommandBufferResetFlags{}, *m_dispatch);
+  if (!timestamps) return time_host;
+
+  uint64_t values[2] = {0, 0};
+  m_device.getQueryPoolResults(m_query_pool.get(), 0, 2, sizeof(values), values, sizeof(uint64_t), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait, *m_dispatch);
+  return double((values[1] - values[0]) & m_timestamp_mask) * m_timestamp_period * 1e-6;
+}
+
+std::string const& BenchmarkSubmitter::clock() const {
+  return m_clock;
+}
+
+vk::CommandBuffer const& BenchmarkSubmitter::command_buffer() const {
+  return m_command_buffer;
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point const& start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+double median(std::vector<double> samples) {
+  if (samples.empty()) return 0.0;
+  std::sort(samples.begin(), samples.end());
+  size_t middle = samples.size() / 2;
+  return samples.size() % 2 ? samples[middle] : (samples[middle - 1] + samples[middle]) * 0.5;
+}
+
+BenchmarkResult collect_samples(BenchmarkResult result, uint32_t repetitions, std::function<double()> const& run) {
+  run();
+  for (uint32_t r = 0; r < repetitions; ++r) {
+    result.samples_ms.push_back(run());
+  }
+  return result;
+}
+
+static double baseline_speedup(std::vector<BenchmarkResult> const& results, BenchmarkResult const& result, std::string const& baseline) {
+  if (baseline.empty()) return 0.0;
+  for (auto const& other : results) {
+    if (other.variant == baseline && other.name == result.name && other.bytes == result.bytes && other.items == result.items) {
+      return median(other.samples_ms) / median(result.samples_ms);
+    }
+  }
+  return 0.0;
+}
+
+// median, minimum and the derived rates of a result
+struct Summary {
+  Summary(std::vector<BenchmarkResult> const& results, BenchmarkResult const& result, std::string const& baseline)
+   :median_ms{median(result.samples_ms)}
+   ,min_ms{result.samples_ms.empty() ? 0.0 : *std::min_element(result.samples_ms.begin(), result.samples_ms.end())}
+   ,gb_per_s{double(result.bytes) / (median_ms * 1e6)}
+   ,items_per_s{double(result.items) / median_ms * 1000.0}
+   ,speedup{baseline_speedup(results, result, baseline)}
+  {}
+
+  double median_ms;
+  double min_ms;
+  double gb_per_s;
+  double items_per_s;
+  double speedup;
+};
+
+void print_csv(std::vector<BenchmarkResult> const& results, std::string const& baseline) {
+  std::cout << "name,variant,bytes,items,clock,median_ms,min_ms,gb_per_s,items_per_s,speedup" << std::endl;
+  for (auto const& result : results) {
+    Summary summary{results, result, baseline};
+    std::cout << result.name << "," << result.variant << "," << result.bytes << "," << result.items << "," << result.clock << ","
+              << summary.median_ms << "," << summary.min_ms << "," << summary.gb_per_s << "," << summary.items_per_s << ","
+              << summary.speedup << std::endl;
+  }
+}
+
+// quoted json string, escaping quotes, backslashes and control characters
+static std::string json_string(std::string const& value) {
+  std::string escaped{"\""};
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    }
+    else if (static_cast<unsigned char>(c) < 0x20) {
+      char code[8];
+      std::snprintf(code, sizeof(code), "\\u%04x", unsigned(static_cast<unsigned char>(c)));
+      escaped += code;
+    }
+    else {
+      escaped += c;
+    }
+  }
+  return escaped + "\"";
+}
+
+void print_json(std::vector<BenchmarkResult> const& results, std::map<std::string, std::string> const& properties, std::string const& baseline) {
+  std::cout << "{";
+  for (auto const& property : properties) {
+    std::cout << json_string(property.first) << ":" << json_string(property.second) << ",";
+  }
+  std::cout << "\"results\":[";
+  for (size_t i = 0; i < results.size(); ++i) {
+    BenchmarkResult const& result = results[i];
+    Summary summary{results, result, baseline};
+    std::cout << (i > 0 ? "," : "") << "\n{\"name\":" << json_string(result.name) << ",\"variant\":" << json_string(result.variant)
+              << ",\"bytes\":" << result.bytes << ",\"items\":" << result.items << ",\"clock\":" << json_string(result.clock)
+              << ",\"median_ms\":" << summary.median_ms << ",\"min_ms\":" << summary.min_ms
+              << ",\"gb_per_s\":" << summary.gb_per_s << ",\"items_per_s\":" << summary.items_per_s
+              << ",\"speedup\":" << summary.speedup << "}";
+  }
+  std::cout << "\n]}" << std::endl;
+}
+
+HeadlessDevice create_headless_device(uint32_t api_version) {
+  HeadlessDevice headless{};
+  headless.instance = create_instance({}, false, api_version);
+  headless.selection = DeviceSelector{headless.instance, api_version}.select();
+  headless.device = create_device(headless.selection);
+  headless.queue = headless.device.getQueue(headless.selection.queue_family, 0, device_dispatch(headless.device));
+  std::cerr << "benchmarking " << headless.selection.capabilities.name << std::endl;
+  return headless;
+}
+
+void destroy_headless_device(HeadlessDevice const& headless) {
+  destroy_device(headless.device);
+  headless.instance.destroy();
+}
@@ -0,0 +1,180 @@
+#include "bring_up.hpp"
+#include "debug_reporter.hpp"
+#include "profiler.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// function statics avoid depending on static initialization order
+static std::mutex& cache_mutex() {
+  static std::mutex mutex{};
+  return mutex;
+}
+
+static std::map<VkDevice, std::unique_ptr<vk::DispatchLoaderDynamic>>& dispatch_tables() {
+  static std::map<VkDevice, std::unique_ptr<vk::DispatchLoaderDynamic>> tables{};
+  return tables;
+}
+
+static bool contains(std::vector<vk::ExtensionProperties> const& extensions, std::string const& name) {
+  for (auto const& extension : extensions) {
+    if (name == extension.extensionName) return true;
+  }
+  return false;
+}
+
+static void add_unique(std::vector<char const*>& names, char const* name) {
+  for (auto existing : names) {
+    if (std::strcmp(existing, name) == 0) return;
+  }
+  names.push_back(name);
+}
+
+// without the instance only device level functions are loaded
+static std::unique_ptr<vk::DispatchLoaderDynamic> load_dispatch(vk::Instance const& instance, vk::Device const& device) {
+  return std::unique_ptr<vk::DispatchLoaderDynamic>{new vk::DispatchLoaderDynamic{static_cast<VkInstance>(instance), vkGetInstanceProcAddr, static_cast<VkDevice>(device), vkGetDeviceProcAddr}};
+}
+
+vk::DispatchLoaderDynamic const& device_dispatch(vk::Device const& device) {
+  std::lock_guard<std::mutex> lock{cache_mutex()};
+  std::unique_ptr<vk::DispatchLoaderDynamic>& dispatch = dispatch_tables()[static_cast<VkDevice>(device)];
+  if (!dispatch) {
+    dispatch = load_dispatch(vk::Instance{}, device);
+  }
+  return *dispatch;
+}
+
+std::vector<vk::ExtensionProperties> const& instance_extensions() {
+  // the loader scans all manifests on each enumeration
+  static std::vector<vk::ExtensionProperties> const extensions = []() {
+    PROFILE_SCOPE("enumerate instance extensions");
+    return vk::enumerateInstanceExtensionProperties();
+  }();
+  return extensions;
+}
+
+std::vector<vk::LayerProperties> const& instance_layers() {
+  static std::vector<vk::LayerProperties> const layers = []() {
+    PROFILE_SCOPE("enumerate instance layers");
+    return vk::enumerateInstanceLayerProperties();
+  }();
+  return layers;
+}
+
+std::vector<vk::ExtensionProperties> const& device_extensions(vk::PhysicalDevice const& phys_device) {
+  static std::map<VkPhysicalDevice, std::vector<vk::ExtensionProperties>> extensions{};
+  std::lock_guard<std::mutex> lock{cache_mutex()};
+  auto found = extensions.find(static_cast<VkPhysicalDevice>(phys_device));
+  if (found == extensions.end()) {
+    PROFILE_SCOPE("enumerate device extensions");
+    found = extensions.emplace(static_cast<VkPhysicalDevice>(phys_device), phys_device.enumerateDeviceExtensionProperties()).first;
+  }
+  return found->second;
+}
+
+bool instance_extension_supported(std::string const& name) {
+  return contains(instance_extensions(), name);
+}
+
+bool instance_layer_supported(std::string const& name) {
+  for (auto const& layer : instance_layers()) {
+    if (name == layer.layerName) return true;
+  }
+  return false;
+}
+
+bool device_extension_supported(vk::PhysicalDevice const& phys_device, std::string const& name) {
+  return contains(device_extensions(phys_device), name);
+}
+
+bool validation_requested() {
+  char const* value = std::getenv("VULKAN_MINIMAL_VALIDATION");
+  return value && std::strcmp(value, "") != 0 && std::strcmp(value, "0") != 0;
+}
+
+std::string validation_layer() {
+  for (auto const& name : {"VK_LAYER_KHRONOS_validation", "VK_LAYER_LUNARG_standard_validation"}) {
+    if (instance_layer_supported(name)) return name;
+  }
+  return "";
+}
+
+vk::Instance create_instance(std::vector<char const*> const& extensions, bool validation, uint32_t api_version) {
+  PROFILE_SCOPE("create instance");
+  std::vector<char const*> enabled_extensions{};
+  for (auto name : extensions) {
+    if (!instance_extension_supported(name)) {
+      throw std::runtime_error{"Instance extension " + std::string{name} + " is not supported"};
+    }
+    add_unique(enabled_extensions, name);
+  }
+  std::string layer{};
+  std::vector<char const*> layers{};
+  if (validation) {
+    layer = validation_layer();
+    if (!layer.empty()) {
+      layers.push_back(layer.c_str());
+    }
+    else {
+      std::cerr << "Validation requested, but no validation layer is installed" << std::endl;
+    }
+    // the DebugReporter falls back to debug report without debug utils
+    if (DebugReporter::utils_supported()) {
+      add_unique(enabled_extensions, VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    }
+    else if (instance_extension_supported(VK_EXT_DEBUG_REPORT_EXTENSION_NAME)) {
+      add_unique(enabled_extensions, VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+    }
+  }
+
+  vk::ApplicationInfo info_app{};
+  info_app.apiVersion = api_version;
+
+  vk::InstanceCreateInfo info_instance{};
+  info_instance.pApplicationInfo = &info_app;
+  info_instance.enabledLayerCount = uint32_t(layers.size());
+  info_instance.ppEnabledLayerNames = layers.data();
+  info_instance.enabledExtensionCount = uint32_t(enabled_extensions.size());
+  info_instance.ppEnabledExtensionNames = enabled_extensions.data();
+  return vk::createInstance(info_instance);
+}
+
+vk::Device create_device(DeviceSelection const& selection, std::vector<char const*> const& extensions) {
+  PROFILE_SCOPE("create device");
+  for (auto name : extensions) {
+    if (!device_extension_supported(selection.phys_device, name)) {
+      throw std::runtime_error{"Device extension " + std::string{name} + " is not supported"};
+    }
+  }
+  std::vector<vk::DeviceQueueCreateInfo> infos_queue = selection.queue_infos();
+  vk::DeviceCreateInfo info_device{};
+  info_device.queueCreateInfoCount = uint32_t(infos_queue.size());
+  info_device.pQueueCreateInfos = infos_queue.data();
+  info_device.enabledExtensionCount = uint32_t(extensions.size());
+  info_device.ppEnabledExtensionNames = extensions.data();
+  vk::Device device = selection.phys_device.createDevice(info_device);
+
+  std::unique_ptr<vk::DispatchLoaderDynamic> dispatch{};
+  try {
+    dispatch = load_dispatch(selection.instance, device);
+  }
+  catch (...) {
+    device.destroy();
+    throw;
+  }
+  std::lock_guard<std::mutex> lock{cache_mutex()};
+  dispatch_tables()[static_cast<VkDevice>(device)] = std::move(dispatch);
+  return device;
+}
+
+void destroy_device(vk::Device const& device) {
+  {
+    std::lock_guard<std::mutex> lock{cache_mutex()};
+    dispatch_tables().erase(static_cast<VkDevice>(device));
+  }
+  device.destroy();
+}
@@ -0,0 +1,203 @@
+#include "compute_pipeline.hpp"
+
+ComputePipeline::ComputePipeline()
+ :m_device{}
+ ,m_dispatch{nullptr}
+ ,m_set_layouts{}
+ ,m_bindings{}
+ ,m_layout{}
+ ,m_pipeline{}
+ ,m_pool{}
+ ,m_workgroup_size{1}
+{}
+
+ComputePipeline::ComputePipeline(vk::Device const& device, Shader const& shader, vk::PipelineCache const& cache, glm::uvec3 const& workgroup_size, std::map<uint32_t, uint32_t> const& constants, uint32_t max_sets)
+ :ComputePipeline{}
+{
+  if (shader.stage() != vk::ShaderStageFlagBits::eCompute) {
+    throw std::runtime_error{"Shader '" + shader.entry_point() + "' is not a compute shader"};
+  }
+  m_device = device;
+  m_dispatch = &device_dispatch(device);
+  m_workgroup_size = shader.local_size();
+  // sort bindings by set
+  for (auto const& binding : shader.bindings()) {
+    if (binding.set >= m_bindings.size()) {
+      m_bindings.resize(binding.set + 1);
+    }
+    m_bindings[binding.set].push_back(binding);
+  }
+  std::map<vk::DescriptorType, uint32_t> pool_counts{};
+  for (auto const& set : m_bindings) {
+    std::vector<vk::DescriptorSetLayoutBinding> layout_bindings{};
+    for (auto const& binding : set) {
+      vk::DescriptorSetLayoutBinding layout_binding{};
+      layout_binding.binding = binding.binding;
+      layout_binding.descriptorType = binding.type;
+      layout_binding.descriptorCount = binding.count;
+      layout_binding.stageFlags = vk::ShaderStageFlagBits::eCompute;
+      layout_bindings.push_back(layout_binding);
+      pool_counts[binding.type] += binding.count * max_sets;
+    }
+    vk::DescriptorSetLayoutCreateInfo info_set_layout{};
+    info_set_layout.bindingCount = uint32_t(layout_bindings.size());
+    info_set_layout.pBindings = layout_bindings.data();
+    m_set_layouts.push_back(m_device.createDescriptorSetLayout(info_set_layout, nullptr, *m_dispatch));
+  }
+  // create layout
+  vk::PushConstantRange push_range{};
+  push_range.stageFlags = vk::ShaderStageFlagBits::eCompute;
+  push_range.offset = 0;
+  push_range.size = shader.push_constant_size();
+
+  vk::PipelineLayoutCreateInfo info_layout{};
+  info_layout.setLayoutCount = uint32_t(m_set_layouts.size());
+  info_layout.pSetLayouts = m_set_layouts.data();
+  info_layout.pushConstantRangeCount = push_range.size > 0 ? 1 : 0;
+  info_layout.pPushConstantRanges = &push_range;
+  m_layout = m_device.createPipelineLayout(info_layout, nullptr, *m_dispatch);
+
+  if (!pool_counts.empty()) {
+    std::vector<vk::DescriptorPoolSize> pool_sizes{};
+    for (auto const& count : pool_counts) {
+      vk::DescriptorPoolSize pool_size{};
+      pool_size.type = count.first;
+      pool_size.descriptorCount = count.second;
+      pool_sizes.push_back(pool_size);
+    }
+    vk::DescriptorPoolCreateInfo info_pool{};
+    info_pool.maxSets = max_sets * uint32_t(m_set_layouts.size());
+    info_pool.poolSizeCount = uint32_t(pool_sizes.size());
+    info_pool.pPoolSizes = pool_sizes.data();
+    m_pool = m_device.createDescriptorPool(info_pool, nullptr, *m_dispatch);
+  }
+
+  // collect specialization constants
+  std::map<uint32_t, uint32_t> spec_values{constants};
+  for (int c = 0; c < 3; ++c) {
+    if (workgroup_size[c] == 0) continue;
+    if (shader.local_size_ids()[c] >= 0) {
+      spec_values[uint32_t(shader.local_size_ids()[c])] = workgroup_size[c];
+      m_workgroup_size[c] = workgroup_size[c];
+    }
+    else if (workgroup_size[c] != m_workgroup_size[c]) {
+      throw std::runtime_error{"Workgroup size of shader is not specializable"};
+    }
+  }
+  std::vector<vk::SpecializationMapEntry> spec_entries{};
+  std::vector<uint32_t> spec_data{};
+  for (auto const& value : spec_values) {
+    vk::SpecializationMapEntry entry{};
+    entry.constantID = value.first;
+    entry.offset = uint32_t(spec_data.size() * sizeof(uint32_t));
+    entry.size = sizeof(uint32_t);
+    spec_entries.push_back(entry);
+    spec_data.push_back(value.second);
+  }
+  vk::SpecializationInfo info_spec{};
+  info_spec.mapEntryCount = uint32_t(spec_entries.size());
+  info_spec.pMapEntries = spec_entries.data();
+  info_spec.dataSize = spec_data.size() * sizeof(uint32_t);
+  info_spec.pData = spec_data.data();
+
+  vk::ComputePipelineCreateInfo info_pipeline{};
+  info_pipeline.stage.stage = vk::ShaderStageFlagBits::eCompute;
+  info_pipeline.stage.module = shader.module();
+  info_pipeline.stage.pName = shader.entry_point().c_str();
+  info_pipeline.stage.pSpecializationInfo = spec_entries.empty() ? nullptr : &info_spec;
+  info_pipeline.layout = m_layout;
+  m_pipeline = m_device.createComputePipeline(cache, info_pipeline, nullptr, *m_dispatch);
+}
+
+ComputePipeline::ComputePipeline(ComputePipeline&& rhs)
+ :ComputePipeline{}
+{
+  std::swap(m_device, rhs.m_device);
+  std::swap(m_dispatch, rhs.m_dispatch);
+  std::swap(m_set_layouts, rhs.m_set_layouts);
+  std::swap(m_bindings, rhs.m_bindings);
+  std::swap(m_layout, rhs.m_layout);
+  std::swap(m_pipeline, rhs.m_pipeline);
+  std::swap(m_pool, rhs.m_pool);
+  std::swap(m_workgroup_size, rhs.m_workgroup_size);
+}
+
+ComputePipeline& ComputePipeline::operator=(ComputePipeline&& rhs) {
+  cleanup();
+  std::swap(m_device, rhs.m_device);
+  std::swap(m_dispatch, rhs.m_dispatch);
+  std::swap(m_set_layouts, rhs.m_set_layouts);
+  std::swap(m_bindings, rhs.m_bindings);
+  std::swap(m_layout, rhs.m_layout);
+  std::swap(m_pipeline, rhs.m_pipeline);
+  std::swap(m_pool, rhs.m_pool);
+  std::swap(m_workgroup_size, rhs.m_workgroup_size);
+  return *this;
+}
+
+ComputePipeline::~ComputePipeline() {
+  cleanup();
+}
+
+void ComputePipeline::cleanup() {
+  if (m_pipeline) {
+    m_device.destroyPipeline(m_pipeline, nullptr, *m_dispatch);
+    m_pipeline = vk::Pipeline{};
+  }
+  if (m_layout) {
+    m_device.destroyPipelineLayout(m_layout, nullptr, *m_dispatch);
+    m_layout = vk::PipelineLayout{};
+  }
+  if (m_pool) {
+    m_device.destroyDescriptorPool(m_pool, nullptr, *m_dispatch);
+    m_pool = vk::DescriptorPool{};
+  }
+  for (auto const& set_layout : m_set_layouts) {
+    m_device.destroyDescriptorSetLayout(set_layout, nullptr, *m_dispatch);
+  }
+  m_set_layouts.clear();
+  m_bindings.clear();
+}
+
+DescriptorSet ComputePipeline::allocate_set(uint32_t set) {
+  return allocate_set(m_pool, set);
+}
+
+DescriptorSet ComputePipeline::allocate_set(vk::DescriptorPool const& pool, uint32_t set) const {
+  if (set >= m_set_layouts.size()) {
+    throw std::runtime_error{"Pipeline has no descriptor set " + std::to_string(set)};
+  }
+  vk::DescriptorSetAllocateInfo info_set{};
+  info_set.descriptorPool = pool;
+  info_set.descriptorSetCount = 1;
+  info_set.pSetLayouts = &m_set_layouts[set];
+  return DescriptorSet{m_device, *m_dispatch, m_device.allocateDescriptorSets(info_set, *m_dispatch).front(), m_bindings[set]};
+}
+
+void ComputePipeline::bind(vk::CommandBuffer const& command_buffer, std::vector<vk::DescriptorSet> const& sets) const {
+  command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline, *m_dispatch);
+  if (!sets.empty()) {
+    command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_layout, 0, sets, nullptr, *m_dispatch);
+  }
+}
+
+void ComputePipeline::push_constants(vk::CommandBuffer const& command_buffer, void const* data, uint32_t size, uint32_t offset) const {
+  command_buffer.pushConstants(m_layout, vk::ShaderStageFlagBits::eCompute, offset, size, data, *m_dispatch);
+}
+
+void ComputePipeline::dispatch(vk::CommandBuffer const& command_buffer, glm::uvec3 const& invocations) const {
+  glm::uvec3 groups = (invocations + m_workgroup_size - glm::uvec3{1}) / m_workgroup_size;
+  command_buffer.dispatch(groups.x, groups.y, groups.z, *m_dispatch);
+}
+
+glm::uvec3 const& ComputePipeline::workgroup_size() const {
+  return m_workgroup_size;
+}
+
+vk::Pipeline const& ComputePipeline::get() const {
+  return m_pipeline;
+}
+
+vk::PipelineLayout const& ComputePipeline::layout() const {
+  return m_layout;
+}
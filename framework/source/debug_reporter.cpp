@@ -1,62 +1,360 @@
 #include "debug_reporter.hpp"
+#include "bring_up.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
-static VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(
+// must be a power of two
+static uint64_t const queue_size = 1024;
+static size_t const text_size = 1024;
+static size_t const id_name_size = 96;
+
+enum class Severity : uint32_t {
+  eVerbose,
+  eInfo,
+  eWarning,
+  ePerformance,
+  eError
+};
+
+static char const* severity_name(Severity severity) {
+  switch (severity) {
+    case Severity::eVerbose: return "Debug";
+    case Severity::eInfo: return "Info";
+    case Severity::eWarning: return "Warning";
+    case Severity::ePerformance: return "Performance";
+    default: return "Error";
+  }
+}
+
+struct Message {
+  Severity severity;
+  int32_t id;
+  char id_name[id_name_size];
+  char text[text_size];
+};
+
+// bounded multi-producer queue, a slot is free for position p when its sequence is p
+// and readable when it is p + 1
+struct Slot {
+  std::atomic<uint64_t> sequence;
+  Message message;
+};
+
+struct IdState {
+  std::chrono::steady_clock::time_point window_begin;
+  uint32_t printed;
+  uint64_t suppressed;
+  uint64_t suppressed_total;
+  std::string name;
+};
+
+static uint64_t hash_text(char const* text) {
+  uint64_t hash = 14695981039346656037ull;
+  for (; *text; ++text) {
+    hash = (hash ^ uint8_t(*text)) * 1099511628211ull;
+  }
+  return hash;
+}
+
+struct DebugReporter::Channel {
+  Channel(uint32_t limit)
+   :slots{new Slot[queue_size]}
+   ,head{0}
+   ,tail{0}
+   ,dropped{0}
+   ,errors{0}
+   ,rate_limit{limit}
+   ,ids{}
+   ,last_error{}
+   ,drained{0}
+   ,running{true}
+   ,mutex{}
+   ,cv_message{}
+   ,cv_drained{}
+   ,thread{}
+#ifdef VK_EXT_debug_utils
+   ,messenger{VK_NULL_HANDLE}
+   ,set_object_name{nullptr}
+   ,cmd_begin_label{nullptr}
+   ,cmd_end_label{nullptr}
+   ,cmd_insert_label{nullptr}
+#endif
+   ,callback{VK_NULL_HANDLE}
+  {
+    for (uint64_t i = 0; i < queue_size; ++i) {
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    thread = std::thread{&Channel::print_loop, this};
+  }
+
+  ~Channel() {
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      running = false;
+    }
+    cv_message.notify_one();
+    thread.join();
+  }
+
+  // called from driver threads, never blocks or allocates
+  void push(Severity severity, int32_t id, char const* id_name, char const* text, char const* objects) {
+    if (severity == Severity::eError) {
+      errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    uint64_t position = head.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    while (true) {
+      slot = &slots[position & (queue_size - 1)];
+      uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+      int64_t difference = int64_t(sequence) - int64_t(position);
+      if (difference == 0) {
+        if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+      }
+      else if (difference < 0) {
+        // full, the printing thread is behind
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      else {
+        position = head.load(std::memory_order_relaxed);
+      }
+    }
+    Message& message = slot->message;
+    message.severity = severity;
+    message.id = id;
+    std::snprintf(message.id_name, id_name_size, "%s", id_name ? id_name : "");
+    std::snprintf(message.text, text_size, "%s%s", text ? text : "", objects ? objects : "");
+    slot->sequence.store(position + 1, std::memory_order_release);
+    // other messages are picked up by the next poll
+    if (severity == Severity::eError) {
+      cv_message.notify_one();
+    }
+  }
+
+  bool pop(Message& message) {
+    Slot& slot = slots[tail & (queue_size - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != tail + 1) return false;
+    message = slot.message;
+    slot.sequence.store(tail + queue_size, std::memory_order_release);
+    ++tail;
+    return true;
+  }
+
+  void print(Message const& message) {
+    auto now = std::chrono::steady_clock::now();
+    // layers without ids are deduplicated by text
+    uint64_t key = message.id != 0 ? uint64_t(uint32_t(message.id)) : (hash_text(message.text) | (uint64_t(1) << 63));
+    auto it = ids.find(key);
+    if (it == ids.end()) {
+      IdState state{};
+      state.window_begin = now;
+      state.name = std::string{message.id_name} + " " + std::to_string(message.id);
+      it = ids.emplace(key, state).first;
+    }
+    IdState& state = it->second;
+    if (now - state.window_begin >= std::chrono::seconds{1}) {
+      if (state.suppressed > 0) {
+        std::cerr << "Suppressed " << state.suppressed << " more '" << state.name << "' messages" << '\n';
+      }
+      state.window_begin = now;
+      state.printed = 0;
+      state.suppressed = 0;
+    }
+    if (message.severity == Severity::eError) {
+      std::lock_guard<std::mutex> lock{mutex};
+      last_error = std::string{message.id_name} + " - " + message.text;
+    }
+    if (state.printed >= rate_limit) {
+      ++state.suppressed;
+      ++state.suppressed_total;
+      return;
+    }
+    ++state.printed;
+    std::cerr << severity_name(message.severity) << " " << message.id_name << " " << message.id << " - " << message.text << '\n';
+  }
+
+  void print_loop() {
+    Message message{};
+    std::unique_lock<std::mutex> lock{mutex};
+    while (true) {
+      bool stop = !running;
+      lock.unlock();
+      bool printed = false;
+      while (pop(message)) {
+        print(message);
+        printed = true;
+      }
+      // one flush per batch instead of per message
+      if (printed) {
+        std::cerr.flush();
+      }
+      lock.lock();
+      drained = tail;
+      cv_drained.notify_all();
+      if (stop) break;
+      cv_message.wait_for(lock, std::chrono::milliseconds{10});
+    }
+    lock.unlock();
+    for (auto const& entry : ids) {
+      if (entry.second.suppressed_total > 0) {
+        std::cerr << "Suppressed " << entry.second.suppressed_total << " '" << entry.second.name << "' messages in total" << '\n';
+      }
+    }
+    if (dropped.load() > 0) {
+      std::cerr << "Dropped " << dropped.load() << " validation messages" << '\n';
+    }
+    std::cerr.flush();
+  }
+
+  std::unique_ptr<Slot[]> slots;
+  std::atomic<uint64_t> head;
+  // only accessed by the printing thread
+  uint64_t tail;
+  std::atomic<uint64_t> dropped;
+  std::atomic<uint32_t> errors;
+  uint32_t rate_limit;
+  std::unordered_map<uint64_t, IdState> ids;
+  // guarded by mutex
+  std::string last_error;
+  uint64_t drained;
+  bool running;
+  std::mutex mutex;
+  std::condition_variable cv_message;
+  std::condition_variable cv_drained;
+  std::thread thread;
+
+#ifdef VK_EXT_debug_utils
+  VkDebugUtilsMessengerEXT messenger;
+  PFN_vkSetDebugUtilsObjectNameEXT set_object_name;
+  PFN_vkCmdBeginDebugUtilsLabelEXT cmd_begin_label;
+  PFN_vkCmdEndDebugUtilsLabelEXT cmd_end_label;
+  PFN_vkCmdInsertDebugUtilsLabelEXT cmd_insert_label;
+#endif
+  VkDebugReportCallbackEXT callback;
+};
+
+#ifdef VK_EXT_debug_utils
+static VKAPI_ATTR VkBool32 VKAPI_CALL utils_callback(
+  VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+  VkDebugUtilsMessageTypeFlagsEXT types,
+  VkDebugUtilsMessengerCallbackDataEXT const* data,
+  void* user_data)
+{
+  Severity message_severity = Severity::eVerbose;
+  if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+    message_severity = Severity::eError;
+  }
+  else if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+    message_severity = (types & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT) ? Severity::ePerformance : Severity::eWarning;
+  }
+  else if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) {
+    message_severity = Severity::eInfo;
+  }
+  // attribute message to named objects and the innermost label
+  char objects[256] = {};
+  size_t length = 0;
+  for (uint32_t i = 0; i < data->objectCount && length < sizeof(objects); ++i) {
+    if (!data->pObjects[i].pObjectName) continue;
+    int written = std::snprintf(objects + length, sizeof(objects) - length, "%s'%s'", length == 0 ? " [objects " : ", ", data->pObjects[i].pObjectName);
+    length += written > 0 ? size_t(written) : 0;
+  }
+  if (data->cmdBufLabelCount > 0 && length < sizeof(objects)) {
+    int written = std::snprintf(objects + length, sizeof(objects) - length, "%s label '%s'", length == 0 ? " [" : "", data->pCmdBufLabels[data->cmdBufLabelCount - 1].pLabelName);
+    length += written > 0 ? size_t(written) : 0;
+  }
+  if (length > 0 && length < sizeof(objects)) {
+    std::snprintf(objects + length, sizeof(objects) - length, "]");
+  }
+  static_cast<DebugReporter::Channel*>(user_data)->push(message_severity, data->messageIdNumber, data->pMessageIdName, data->pMessage, objects);
+  return VK_FALSE;
+}
+#endif
+
+static VKAPI_ATTR VkBool32 VKAPI_CALL report_callback(
   VkDebugReportFlagsEXT flags,
-  VkDebugReportObjectTypeEXT objType,
-  uint64_t obj,
-  size_t location,
+  VkDebugReportObjectTypeEXT,
+  uint64_t,
+  size_t,
   int32_t code,
   const char* layerPrefix,
   const char* msg,
-  void* userData) 
+  void* userData)
 {
-  std::string msg_type;
-  bool throwing = false; 
+  Severity severity = Severity::eVerbose;
   if (flags & VK_DEBUG_REPORT_ERROR_BIT_EXT) {
-    msg_type = "Error ";
-    throwing = true;
+    severity = Severity::eError;
   }
   else if (flags & VK_DEBUG_REPORT_WARNING_BIT_EXT) {
-    msg_type = "Warning ";
+    severity = Severity::eWarning;
   }
   else if (flags & VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT) {
-    msg_type = "Performance ";
+    severity = Severity::ePerformance;
   }
   else if (flags & VK_DEBUG_REPORT_INFORMATION_BIT_EXT) {
-    msg_type = "Info ";
-  }
-  else if (flags & VK_DEBUG_REPORT_DEBUG_BIT_EXT) {
-    msg_type = "Debug ";
-  }
-  std::cerr << msg_type << std::to_string(code) << " - " << msg << std::endl;
-  if (throwing) {
-    throw std::runtime_error{"Vulkan Validation " + msg_type + std::to_string(code)};
+    severity = Severity::eInfo;
   }
+  static_cast<DebugReporter::Channel*>(userData)->push(severity, code, layerPrefix, msg, nullptr);
   return VK_FALSE;
 }
 
 DebugReporter::DebugReporter()
  :m_instance{}
- ,m_callback{}
+ ,m_channel{}
 {}
 
-DebugReporter::DebugReporter(vk::Instance const& inst, vk::DebugReportFlagsEXT const& flags)
+DebugReporter::DebugReporter(vk::Instance const& inst, uint32_t rate_limit, bool verbose)
  :m_instance{inst}
- ,m_callback{}
+ ,m_channel{new Channel{rate_limit}}
 {
-  vk::DebugReportCallbackCreateInfoEXT info_callback{};
-  info_callback.flags = flags;
-  info_callback.pfnCallback = debug_callback;
+#ifdef VK_EXT_debug_utils
+  if (utils_supported()) {
+    VkDebugUtilsMessengerCreateInfoEXT info_messenger{};
+    info_messenger.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+    info_messenger.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
+    if (verbose) {
+      info_messenger.messageSeverity |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+    }
+    info_messenger.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+    info_messenger.pfnUserCallback = utils_callback;
+    info_messenger.pUserData = m_channel.get();
+    // get construction function address
+    auto fptr_create = (PFN_vkCreateDebugUtilsMessengerEXT) vkGetInstanceProcAddr(m_instance, "vkCreateDebugUtilsMessengerEXT");
+    if (fptr_create == nullptr) {
+      throw std::runtime_error{"Failed to get function address"};
+    }
+    if (fptr_create(m_instance, &info_messenger, nullptr, &m_channel->messenger) != VK_SUCCESS) {
+      throw std::runtime_error{"Failed to create debug messenger"};
+    }
+    m_channel->set_object_name = (PFN_vkSetDebugUtilsObjectNameEXT) vkGetInstanceProcAddr(m_instance, "vkSetDebugUtilsObjectNameEXT");
+    m_channel->cmd_begin_label = (PFN_vkCmdBeginDebugUtilsLabelEXT) vkGetInstanceProcAddr(m_instance, "vkCmdBeginDebugUtilsLabelEXT");
+    m_channel->cmd_end_label = (PFN_vkCmdEndDebugUtilsLabelEXT) vkGetInstanceProcAddr(m_instance, "vkCmdEndDebugUtilsLabelEXT");
+    m_channel->cmd_insert_label = (PFN_vkCmdInsertDebugUtilsLabelEXT) vkGetInstanceProcAddr(m_instance, "vkCmdInsertDebugUtilsLabelEXT");
+    return;
+  }
+#endif
+  VkDebugReportCallbackCreateInfoEXT info_callback{};
+  info_callback.sType = VK_STRUCTURE_TYPE_DEBUG_REPORT_CALLBACK_CREATE_INFO_EXT;
+  info_callback.flags = VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT | VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT;
+  if (verbose) {
+    info_callback.flags |= VK_DEBUG_REPORT_INFORMATION_BIT_EXT | VK_DEBUG_REPORT_DEBUG_BIT_EXT;
+  }
+  info_callback.pfnCallback = report_callback;
+  info_callback.pUserData = m_channel.get();
   // get construction function address
   auto fptr_create = (PFN_vkCreateDebugReportCallbackEXT) vkGetInstanceProcAddr(m_instance, "vkCreateDebugReportCallbackEXT");
   if (fptr_create != nullptr) {
-    auto result = fptr_create(m_instance, reinterpret_cast<const VkDebugReportCallbackCreateInfoEXT*>(&info_callback), nullptr, reinterpret_cast<VkDebugReportCallbackEXT*>(&m_callback));
+    auto result = fptr_create(m_instance, &info_callback, nullptr, &m_channel->callback);
     if (result != VK_SUCCESS) {
       throw std::runtime_error{"Failed to create debug callback"};
     }
-  } 
+  }
   else {
     throw std::runtime_error{"Failed to get function address"};
   }
@@ -66,13 +364,13 @@ DebugReporter::DebugReporter(DebugReporter&& rhs)
  :DebugReporter{}
 {
   std::swap(m_instance, rhs.m_instance);
-  std::swap(m_callback, rhs.m_callback);
+  std::swap(m_channel, rhs.m_channel);
 }
 
 DebugReporter const& DebugReporter::operator=(DebugReporter&& rhs)  {
   cleanup();
   std::swap(m_instance, rhs.m_instance);
-  std::swap(m_callback, rhs.m_callback);
+  std::swap(m_channel, rhs.m_channel);
   return *this;
 }
 
@@ -80,16 +378,133 @@ DebugReporter::~DebugReporter() {
   cleanup();
 }
 
-void DebugReporter::cleanup() { 
-  if (m_callback) {
+void DebugReporter::cleanup() {
+  if (!m_channel) return;
+#ifdef VK_EXT_debug_utils
+  if (m_channel->messenger != VK_NULL_HANDLE) {
+    auto fptr_destroy = (PFN_vkDestroyDebugUtilsMessengerEXT) vkGetInstanceProcAddr(m_instance, "vkDestroyDebugUtilsMessengerEXT");
+    if (fptr_destroy != nullptr) {
+      fptr_destroy(m_instance, m_channel->messenger, nullptr);
+    }
+  }
+#endif
+  if (m_channel->callback != VK_NULL_HANDLE) {
     // get destruction function address
     auto fptr_destroy = (PFN_vkDestroyDebugReportCallbackEXT) vkGetInstanceProcAddr(m_instance, "vkDestroyDebugReportCallbackEXT");
     if (fptr_destroy != nullptr) {
-      fptr_destroy(m_instance, m_callback, nullptr);
+      fptr_destroy(m_instance, m_channel->callback, nullptr);
     }
-    else {
-      throw std::runtime_error{"Failed to get function address"};
-    }
-    m_callback = vk::DebugReportCallbackEXT{};
   }
+  // joins the printing thread after the remaining messages
+  m_channel.reset();
+}
+
+void DebugReporter::set_object_name(vk::Device const& device, uint32_t type, uint64_t handle, std::string const& name) const {
+#ifdef VK_EXT_debug_utils
+  if (!m_channel || !m_channel->set_object_name) return;
+  VkDebugUtilsObjectNameInfoEXT info_name{};
+  info_name.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+  info_name.objectType = VkObjectType(type);
+  info_name.objectHandle = handle;
+  info_name.pObjectName = name.c_str();
+  m_channel->set_object_name(device, &info_name);
+#else
+  (void)device;
+  (void)type;
+  (void)handle;
+  (void)name;
+#endif
+}
+
+#ifdef VK_EXT_debug_utils
+void DebugReporter::set_name(vk::Device const& device, vk::Buffer const& buffer, std::string const& name) const {
+  set_object_name(device, VK_OBJECT_TYPE_BUFFER, uint64_t(static_cast<VkBuffer>(buffer)), name);
+}
+
+void DebugReporter::set_name(vk::Device const& device, vk::Image const& image, std::string const& name) const {
+  set_object_name(device, VK_OBJECT_TYPE_IMAGE, uint64_t(static_cast<VkImage>(image)), name);
+}
+
+void DebugReporter::set_name(vk::Device const& device, vk::ImageView const& view, std::string const& name) const {
+  set_object_name(device, VK_OBJECT_TYPE_IMAGE_VIEW, uint64_t(static_cast<VkImageView>(view)), name);
+}
+
+void DebugReporter::set_name(vk::Device const& device, vk::Pipeline const& pipeline, std::string const& name) const {
+  set_object_name(device, VK_OBJECT_TYPE_PIPELINE, uint64_t(static_cast<VkPipeline>(pipeline)), name);
+}
+
+void DebugReporter::set_name(vk::Device const& device, vk::CommandBuffer const& command_buffer, std::string const& name) const {
+  set_object_name(device, VK_OBJECT_TYPE_COMMAND_BUFFER, uint64_t(static_cast<VkCommandBuffer>(command_buffer)), name);
+}
+
+void DebugReporter::set_name(vk::Device const& device, vk::Queue const& queue, std::string const& name) const {
+  set_object_name(device, VK_OBJECT_TYPE_QUEUE, uint64_t(static_cast<VkQueue>(queue)), name);
+}
+
+static VkDebugUtilsLabelEXT make_label(std::string const& name) {
+  VkDebugUtilsLabelEXT label{};
+  label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+  label.pLabelName = name.c_str();
+  return label;
+}
+
+void DebugReporter::begin_label(vk::CommandBuffer const& command_buffer, std::string const& name) const {
+  if (!m_channel || !m_channel->cmd_begin_label) return;
+  VkDebugUtilsLabelEXT label = make_label(name);
+  m_channel->cmd_begin_label(command_buffer, &label);
+}
+
+void DebugReporter::end_label(vk::CommandBuffer const& command_buffer) const {
+  if (!m_channel || !m_channel->cmd_end_label) return;
+  m_channel->cmd_end_label(command_buffer);
+}
+
+void DebugReporter::insert_label(vk::CommandBuffer const& command_buffer, std::string const& name) const {
+  if (!m_channel || !m_channel->cmd_insert_label) return;
+  VkDebugUtilsLabelEXT label = make_label(name);
+  m_channel->cmd_insert_label(command_buffer, &label);
+}
+#else
+// headers without debug utils, names and labels are dropped
+void DebugReporter::set_name(vk::Device const&, vk::Buffer const&, std::string const&) const {}
+void DebugReporter::set_name(vk::Device const&, vk::Image const&, std::string const&) const {}
+void DebugReporter::set_name(vk::Device const&, vk::ImageView const&, std::string const&) const {}
+void DebugReporter::set_name(vk::Device const&, vk::Pipeline const&, std::string const&) const {}
+void DebugReporter::set_name(vk::Device const&, vk::CommandBuffer const&, std::string const&) const {}
+void DebugReporter::set_name(vk::Device const&, vk::Queue const&, std::string const&) const {}
+void DebugReporter::begin_label(vk::CommandBuffer const&, std::string const&) const {}
+void DebugReporter::end_label(vk::CommandBuffer const&) const {}
+void DebugReporter::insert_label(vk::CommandBuffer const&, std::string const&) const {}
+#endif
+
+void DebugReporter::flush() const {
+  if (!m_channel) return;
+  uint64_t target = m_channel->head.load();
+  std::unique_lock<std::mutex> lock{m_channel->mutex};
+  m_channel->cv_message.notify_one();
+  m_channel->cv_drained.wait(lock, [this, target]() {
+    return m_channel->drained >= target;
+  });
+}
+
+uint32_t DebugReporter::error_count() const {
+  return m_channel ? m_channel->errors.load() : 0;
+}
+
+std::string DebugReporter::last_error() const {
+  if (!m_channel) return "";
+  std::lock_guard<std::mutex> lock{m_channel->mutex};
+  return m_channel->last_error;
+}
+
+uint64_t DebugReporter::dropped_count() const {
+  return m_channel ? m_channel->dropped.load() : 0;
+}
+
+bool DebugReporter::utils_supported() {
+#ifdef VK_EXT_debug_utils
+  return instance_extension_supported(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+#else
+  return false;
+#endif
 }
@@ -0,0 +1,68 @@
+#include "deletion_queue.hpp"
+
+#include <algorithm>
+#include <vector>
+
+DeletionQueue::DeletionQueue()
+ :m_entries{}
+{}
+
+DeletionQueue::DeletionQueue(DeletionQueue&& rhs)
+ :DeletionQueue{}
+{
+  std::lock_guard<std::mutex> lock{rhs.m_mutex};
+  std::swap(m_entries, rhs.m_entries);
+}
+
+DeletionQueue& DeletionQueue::operator=(DeletionQueue&& rhs) {
+  flush();
+  std::lock(m_mutex, rhs.m_mutex);
+  std::lock_guard<std::mutex> lock{m_mutex, std::adopt_lock};
+  std::lock_guard<std::mutex> lock_rhs{rhs.m_mutex, std::adopt_lock};
+  std::swap(m_entries, rhs.m_entries);
+  return *this;
+}
+
+DeletionQueue::~DeletionQueue() {
+  flush();
+}
+
+void DeletionQueue::push(uint64_t value, std::function<void()> const& deleter) {
+  std::lock_guard<std::mutex> lock{m_mutex};
+  Entry entry{value, deleter};
+  // values normally arrive in order, so this appends
+  auto position = std::upper_bound(m_entries.begin(), m_entries.end(), value, [](uint64_t v, Entry const& e) {
+    return v < e.value;
+  });
+  m_entries.insert(position, entry);
+}
+
+size_t DeletionQueue::retire(uint64_t completed) {
+  std::vector<std::function<void()>> deleters{};
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    while (!m_entries.empty() && m_entries.front().value < completed) {
+      deleters.push_back(std::move(m_entries.front().deleter));
+      m_entries.pop_front();
+    }
+  }
+  // deleters may push new entries
+  for (auto const& deleter : deleters) {
+    deleter();
+  }
+  return deleters.size();
+}
+
+size_t DeletionQueue::flush() {
+  size_t count = 0;
+  // repeat for entries pushed by deleters
+  while (size() > 0) {
+    count += retire(UINT64_MAX);
+  }
+  return count;
+}
+
+size_t DeletionQueue::size() const {
+  std::lock_guard<std::mutex> lock{m_mutex};
+  return m_entries.size();
+}
@@ -0,0 +1,111 @@
+#include "descriptor_set.hpp"
+
+#include <utility>
+
+DescriptorSet::DescriptorSet()
+ :m_device{}
+ ,m_dispatch{nullptr}
+ ,m_set{}
+ ,m_bindings{}
+ ,m_writes{}
+ ,m_buffer_infos{}
+ ,m_image_infos{}
+{}
+
+DescriptorSet::DescriptorSet(vk::Device const& device, vk::DispatchLoaderDynamic const& dispatch, vk::DescriptorSet const& set, std::vector<ShaderBinding> const& bindings)
+ :m_device{device}
+ ,m_dispatch{&dispatch}
+ ,m_set{set}
+ ,m_bindings{bindings}
+ ,m_writes{}
+ ,m_buffer_infos{}
+ ,m_image_infos{}
+{}
+
+// swapping deques keeps their elements in place, so pending writes stay valid
+DescriptorSet::DescriptorSet(DescriptorSet&& rhs)
+ :DescriptorSet{}
+{
+  std::swap(m_device, rhs.m_device);
+  std::swap(m_dispatch, rhs.m_dispatch);
+  std::swap(m_set, rhs.m_set);
+  std::swap(m_bindings, rhs.m_bindings);
+  std::swap(m_writes, rhs.m_writes);
+  std::swap(m_buffer_infos, rhs.m_buffer_infos);
+  std::swap(m_image_infos, rhs.m_image_infos);
+}
+
+DescriptorSet& DescriptorSet::operator=(DescriptorSet&& rhs) {
+  cleanup();
+  std::swap(m_device, rhs.m_device);
+  std::swap(m_dispatch, rhs.m_dispatch);
+  std::swap(m_set, rhs.m_set);
+  std::swap(m_bindings, rhs.m_bindings);
+  std::swap(m_writes, rhs.m_writes);
+  std::swap(m_buffer_infos, rhs.m_buffer_infos);
+  std::swap(m_image_infos, rhs.m_image_infos);
+  return *this;
+}
+
+void DescriptorSet::cleanup() {
+  m_set = vk::DescriptorSet{};
+  m_writes.clear();
+  m_buffer_infos.clear();
+  m_image_infos.clear();
+}
+
+DescriptorSet& DescriptorSet::write(uint32_t binding, vk::Buffer const& buffer, vk::DeviceSize offset, vk::DeviceSize range) {
+  vk::DescriptorBufferInfo info_buffer{};
+  info_buffer.buffer = buffer;
+  info_buffer.offset = offset;
+  info_buffer.range = range;
+  m_buffer_infos.push_back(info_buffer);
+
+  vk::WriteDescriptorSet info_write{};
+  info_write.dstSet = m_set;
+  info_write.dstBinding = binding;
+  info_write.descriptorCount = 1;
+  info_write.descriptorType = type(binding);
+  info_write.pBufferInfo = &m_buffer_infos.back();
+  m_writes.push_back(info_write);
+  return *this;
+}
+
+DescriptorSet& DescriptorSet::write(uint32_t binding, vk::ImageView const& view, vk::ImageLayout layout, vk::Sampler const& sampler) {
+  vk::DescriptorImageInfo info_image{};
+  info_image.imageView = view;
+  info_image.imageLayout = layout;
+  info_image.sampler = sampler;
+  m_image_infos.push_back(info_image);
+
+  vk::WriteDescriptorSet info_write{};
+  info_write.dstSet = m_set;
+  info_write.dstBinding = binding;
+  info_write.descriptorCount = 1;
+  info_write.descriptorType = type(binding);
+  info_write.pImageInfo = &m_image_infos.back();
+  m_writes.push_back(info_write);
+  return *this;
+}
+
+void DescriptorSet::update() {
+  if (!m_writes.empty()) {
+    m_device.updateDescriptorSets(m_writes, nullptr, *m_dispatch);
+  }
+  m_writes.clear();
+  m_buffer_infos.clear();
+  m_image_infos.clear();
+}
+
+vk::DescriptorSet const& DescriptorSet::get() const {
+  return m_set;
+}
+
+vk::DescriptorType DescriptorSet::type(uint32_t binding) const {
+  for (auto const& entry : m_bindings) {
+    if (entry.binding == binding) {
+      return entry.type;
+    }
+  }
+  throw std::runtime_error{"Descriptor set has no binding " + std::to_string(binding)};
+}
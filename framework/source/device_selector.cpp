@@ -0,0 +1,268 @@
+#include "device_selector.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static uint32_t const cache_version = 3;
+
+DeviceCapabilities::DeviceCapabilities()
+ :name{}
+ ,vendor_id{0}
+ ,device_id{0}
+ ,driver_version{0}
+ ,api_version{0}
+ ,effective_api_version{0}
+ ,type{vk::PhysicalDeviceType::eOther}
+ ,device_memory{0}
+ ,max_workgroup_invocations{0}
+ ,max_shared_memory{0}
+ ,subgroup_size{0}
+ ,subgroup_operations{0}
+ ,queue_families{}
+{}
+
+DeviceSelection::DeviceSelection()
+ :instance{}
+ ,phys_device{}
+ ,capabilities{}
+ ,score{0.0f}
+ ,queue_family{0}
+ ,queue_family_compute{0}
+{}
+
+std::vector<vk::DeviceQueueCreateInfo> DeviceSelection::queue_infos() const {
+  static float const priority = 1.0f;
+  std::vector<vk::DeviceQueueCreateInfo> infos{};
+  for (uint32_t family : {queue_family, queue_family_compute}) {
+    bool duplicate = false;
+    for (auto const& info : infos) {
+      duplicate = duplicate || info.queueFamilyIndex == family;
+    }
+    if (duplicate) continue;
+    vk::DeviceQueueCreateInfo info_queue{};
+    info_queue.queueFamilyIndex = family;
+    info_queue.queueCount = 1;
+    info_queue.pQueuePriorities = &priority;
+    infos.push_back(info_queue);
+  }
+  return infos;
+}
+
+DeviceSelector::DeviceSelector(vk::Instance const& instance, uint32_t api_version, std::string const& cache_path)
+ :m_instance{instance}
+ ,m_devices{instance.enumeratePhysicalDevices()}
+ ,m_capabilities{}
+ ,m_cache_path{cache_path}
+ ,m_api_version{api_version}
+{
+  std::vector<DeviceCapabilities> cached = load_cache();
+  bool changed = false;
+  for (auto const& phys_device : m_devices) {
+    // identifying properties are cheap, the remaining queries are skipped on a hit
+    vk::PhysicalDeviceProperties properties = phys_device.getProperties();
+    bool hit = false;
+    for (auto const& entry : cached) {
+      if (entry.vendor_id == properties.vendorID && entry.device_id == properties.deviceID
+       && entry.driver_version == properties.driverVersion && entry.api_version == properties.apiVersion
+       && entry.effective_api_version == std::min(m_api_version, properties.apiVersion) && entry.name == properties.deviceName) {
+        m_capabilities.push_back(entry);
+        hit = true;
+        break;
+      }
+    }
+    if (!hit) {
+      m_capabilities.push_back(query(phys_device, m_api_version));
+      changed = true;
+    }
+  }
+  if (changed || cached.size() != m_capabilities.size()) {
+    save_cache();
+  }
+}
+
+DeviceCapabilities DeviceSelector::query(vk::PhysicalDevice const& phys_device, uint32_t instance_api_version) {
+  DeviceCapabilities capabilities{};
+  vk::PhysicalDeviceProperties properties = phys_device.getProperties();
+  capabilities.name = properties.deviceName;
+  capabilities.vendor_id = properties.vendorID;
+  capabilities.device_id = properties.deviceID;
+  capabilities.driver_version = properties.driverVersion;
+  capabilities.api_version = properties.apiVersion;
+  // functionality beyond the version of the instance must not be used
+  capabilities.effective_api_version = std::min(instance_api_version, properties.apiVersion);
+  capabilities.type = properties.deviceType;
+  capabilities.max_workgroup_invocations = properties.limits.maxComputeWorkGroupInvocations;
+  capabilities.max_shared_memory = properties.limits.maxComputeSharedMemorySize;
+
+  vk::PhysicalDeviceMemoryProperties memory = phys_device.getMemoryProperties();
+  for (uint32_t i = 0; i < memory.memoryHeapCount; ++i) {
+    if (memory.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal) {
+      capabilities.device_memory = std::max(capabilities.device_memory, memory.memoryHeaps[i].size);
+    }
+  }
+#ifdef VK_VERSION_1_1
+  // subgroup properties are core since 1.1, getProperties2 needs a 1.1 instance
+  if (capabilities.effective_api_version >= VK_API_VERSION_1_1) {
+    vk::PhysicalDeviceSubgroupProperties subgroup{};
+    vk::PhysicalDeviceProperties2 properties2{};
+    properties2.pNext = &subgroup;
+    phys_device.getProperties2(&properties2);
+    capabilities.subgroup_size = subgroup.subgroupSize;
+    if (subgroup.supportedStages & vk::ShaderStageFlagBits::eCompute) {
+      capabilities.subgroup_operations = uint32_t(subgroup.supportedOperations);
+    }
+  }
+#endif
+  capabilities.queue_families = phys_device.getQueueFamilyProperties();
+  return capabilities;
+}
+
+float DeviceSelector::score(DeviceCapabilities const& capabilities) {
+  if (find_queue_family(capabilities, vk::QueueFlagBits::eCompute) < 0) {
+    return -1.0f;
+  }
+  // device type dominates, cpu implementations are only chosen without gpus
+  float score = 0.0f;
+  switch (capabilities.type) {
+    case vk::PhysicalDeviceType::eDiscreteGpu: score = 1000.0f; break;
+    case vk::PhysicalDeviceType::eIntegratedGpu: score = 500.0f; break;
+    case vk::PhysicalDeviceType::eVirtualGpu: score = 300.0f; break;
+    case vk::PhysicalDeviceType::eCpu: score = 100.0f; break;
+    default: score = 0.0f; break;
+  }
+  // 10 points per GiB up to 32 GiB
+  double memory_gib = double(capabilities.device_memory) / double(1024 * 1024 * 1024);
+  score += float(std::min(memory_gib, 32.0) * 10.0);
+  score += float(std::log2(double(std::max(capabilities.max_workgroup_invocations, 1u)))) * 5.0f;
+  score += float(capabilities.max_shared_memory / 1024) * 0.5f;
+  // devices reporting subgroups support the subgroup shader variants
+  if (capabilities.subgroup_size > 0) {
+    score += 20.0f;
+  }
+  // a dedicated compute family allows overlapping compute with other work
+  if (find_queue_family(capabilities, vk::QueueFlagBits::eCompute, vk::QueueFlagBits::eGraphics) >= 0) {
+    score += 50.0f;
+  }
+  return score;
+}
+
+int32_t DeviceSelector::find_queue_family(DeviceCapabilities const& capabilities, vk::QueueFlags const& required, vk::QueueFlags const& avoided) {
+  for (uint32_t i = 0; i < capabilities.queue_families.size(); ++i) {
+    vk::QueueFamilyProperties const& family = capabilities.queue_families[i];
+    if (family.queueCount > 0 && (family.queueFlags & required) == required && !(family.queueFlags & avoided)) {
+      return int32_t(i);
+    }
+  }
+  return -1;
+}
+
+DeviceSelection DeviceSelector::select() const {
+  DeviceSelection selection{};
+  int32_t best = -1;
+  for (uint32_t i = 0; i < m_capabilities.size(); ++i) {
+    float score_device = score(m_capabilities[i]);
+    if (score_device >= 0.0f && (best < 0 || score_device > selection.score)) {
+      best = int32_t(i);
+      selection.score = score_device;
+    }
+  }
+  if (best < 0) {
+    throw std::runtime_error{"No device supports compute"};
+  }
+  selection.instance = m_instance;
+  selection.phys_device = m_devices[uint32_t(best)];
+  selection.capabilities = m_capabilities[uint32_t(best)];
+  DeviceCapabilities const& capabilities = selection.capabilities;
+
+  // compute families implicitly support transfers
+  int32_t family = find_queue_family(capabilities, vk::QueueFlagBits::eCompute | vk::QueueFlagBits::eGraphics);
+  if (family < 0) {
+    family = find_queue_family(capabilities, vk::QueueFlagBits::eCompute);
+  }
+  selection.queue_family = uint32_t(family);
+
+  int32_t family_compute = find_queue_family(capabilities, vk::QueueFlagBits::eCompute, vk::QueueFlagBits::eGraphics);
+  selection.queue_family_compute = family_compute >= 0 ? uint32_t(family_compute) : selection.queue_family;
+  return selection;
+}
+
+std::vector<vk::PhysicalDevice> const& DeviceSelector::devices() const {
+  return m_devices;
+}
+
+std::vector<DeviceCapabilities> const& DeviceSelector::capabilities() const {
+  return m_capabilities;
+}
+
+// one device per line, the name takes the rest of the line
+std::vector<DeviceCapabilities> DeviceSelector::load_cache() const {
+  std::vector<DeviceCapabilities> cached{};
+  if (m_cache_path.empty()) return cached;
+  std::ifstream file{m_cache_path};
+  std::string line{};
+  uint32_t version = 0;
+  if (!std::getline(file, line) || !(std::istringstream{line} >> version) || version != cache_version) {
+    return cached;
+  }
+  while (std::getline(file, line)) {
+    std::istringstream stream{line};
+    DeviceCapabilities entry{};
+    uint32_t type = 0;
+    size_t family_count = 0;
+    stream >> entry.vendor_id >> entry.device_id >> entry.driver_version >> entry.api_version >> entry.effective_api_version >> type
+           >> entry.device_memory >> entry.max_workgroup_invocations >> entry.max_shared_memory
+           >> entry.subgroup_size >> entry.subgroup_operations >> family_count;
+    entry.type = vk::PhysicalDeviceType(type);
+    for (size_t i = 0; i < family_count && stream; ++i) {
+      vk::QueueFamilyProperties family{};
+      uint32_t flags = 0;
+      stream >> flags >> family.queueCount >> family.timestampValidBits
+             >> family.minImageTransferGranularity.width >> family.minImageTransferGranularity.height
+             >> family.minImageTransferGranularity.depth;
+      family.queueFlags = vk::QueueFlags{flags};
+      entry.queue_families.push_back(family);
+    }
+    std::getline(stream >> std::ws, entry.name);
+    // discard whole cache if damaged
+    if (!stream || entry.queue_families.size() != family_count) {
+      return {};
+    }
+    cached.push_back(entry);
+  }
+  return cached;
+}
+
+void DeviceSelector::save_cache() const {
+  if (m_cache_path.empty()) return;
+  std::string path_tmp = m_cache_path + ".tmp";
+  {
+    std::ofstream file{path_tmp, std::ios::trunc};
+    file << cache_version << "\n";
+    for (auto const& entry : m_capabilities) {
+      file << entry.vendor_id << " " << entry.device_id << " " << entry.driver_version << " " << entry.api_version << " " << entry.effective_api_version << " "
+           << uint32_t(entry.type) << " " << entry.device_memory << " " << entry.max_workgroup_invocations << " "
+           << entry.max_shared_memory << " " << entry.subgroup_size << " " << entry.subgroup_operations << " " << entry.queue_families.size();
+      for (auto const& family : entry.queue_families) {
+        file << " " << uint32_t(family.queueFlags) << " " << family.queueCount << " " << family.timestampValidBits
+             << " " << family.minImageTransferGranularity.width << " " << family.minImageTransferGranularity.height
+             << " " << family.minImageTransferGranularity.depth;
+      }
+      file << " " << entry.name << "\n";
+    }
+    if (!file) {
+      std::cerr << "Failed to write device cache '" << path_tmp << "'" << std::endl;
+      return;
+    }
+  }
+#ifdef _WIN32
+  // rename does not replace existing files on windows
+  std::remove(m_cache_path.c_str());
+#endif
+  if (std::rename(path_tmp.c_str(), m_cache_path.c_str()) != 0) {
+    std::cerr << "Failed to replace device cache '" << m_cache_path << "'" << std::endl;
+  }
+}
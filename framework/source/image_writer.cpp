@@ -0,0 +1,613 @@
+#include "image_writer.hpp"
+#include "profiler.hpp"
+
+#include <lodepng.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+// filtered bytes per strip, each strip is a separate deflate segment
+static size_t const strip_size = 256 * 1024;
+static uint32_t const window_size = 32768;
+static uint32_t const hash_bits = 15;
+static uint32_t const match_min = 4;
+static uint32_t const match_max = 258;
+
+static uint16_t const length_base[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static uint8_t const length_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static uint16_t const distance_base[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static uint8_t const distance_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// deflate writes bits least significant first
+class BitWriter {
+ public:
+  BitWriter(std::vector<uint8_t>& out)
+   :m_out(out)
+   ,m_bits{0}
+   ,m_count{0}
+  {}
+
+  void put(uint32_t value, uint32_t length) {
+    m_bits |= uint64_t(value) << m_count;
+    m_count += length;
+    while (m_count >= 8) {
+      m_out.push_back(uint8_t(m_bits));
+      m_bits >>= 8;
+      m_count -= 8;
+    }
+  }
+
+  void align() {
+    if (m_count > 0) {
+      m_out.push_back(uint8_t(m_bits));
+    }
+    m_bits = 0;
+    m_count = 0;
+  }
+
+ private:
+  std::vector<uint8_t>& m_out;
+  uint64_t m_bits;
+  uint32_t m_count;
+};
+
+// huffman codes of the fixed deflate block type, bit reversed for the writer
+struct FixedCodes {
+  FixedCodes() {
+    for (uint32_t symbol = 0; symbol < 288; ++symbol) {
+      uint32_t code = 0;
+      if (symbol < 144) {
+        code = 0x30 + symbol;
+        literal_lengths[symbol] = 8;
+      }
+      else if (symbol < 256) {
+        code = 0x190 + symbol - 144;
+        literal_lengths[symbol] = 9;
+      }
+      else if (symbol < 280) {
+        code = symbol - 256;
+        literal_lengths[symbol] = 7;
+      }
+      else {
+        code = 0xC0 + symbol - 280;
+        literal_lengths[symbol] = 8;
+      }
+      literal_codes[symbol] = uint16_t(reverse(code, literal_lengths[symbol]));
+    }
+    for (uint32_t symbol = 0; symbol < 30; ++symbol) {
+      distance_codes[symbol] = uint8_t(reverse(symbol, 5));
+    }
+    for (uint32_t length = match_min; length <= match_max; ++length) {
+      uint32_t symbol = 0;
+      while (symbol < 28 && length_base[symbol + 1] <= length) ++symbol;
+      length_symbols[length] = uint8_t(symbol);
+    }
+  }
+
+  static uint32_t reverse(uint32_t code, uint32_t length) {
+    uint32_t reversed = 0;
+    for (uint32_t i = 0; i < length; ++i) {
+      reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+    return reversed;
+  }
+
+  uint16_t literal_codes[288];
+  uint8_t literal_lengths[288];
+  uint8_t distance_codes[30];
+  uint8_t length_symbols[match_max + 1];
+};
+
+static FixedCodes const& fixed_codes() {
+  static FixedCodes const codes{};
+  return codes;
+}
+
+static uint32_t read_u32(uint8_t const* ptr) {
+  uint32_t value = 0;
+  std::memcpy(&value, ptr, 4);
+  return value;
+}
+
+static void write_u32_be(std::vector<uint8_t>& out, uint32_t value) {
+  out.push_back(uint8_t(value >> 24));
+  out.push_back(uint8_t(value >> 16));
+  out.push_back(uint8_t(value >> 8));
+  out.push_back(uint8_t(value));
+}
+
+// greedy lz77 with a single hash candidate and fixed codes
+// non-final segments end with an empty stored block to be byte aligned, like a zlib sync flush
+static void deflate_segment(uint8_t const* data, size_t size, bool final, std::vector<uint8_t>& out) {
+  FixedCodes const& codes = fixed_codes();
+  BitWriter writer{out};
+  writer.put(final ? 1 : 0, 1);
+  writer.put(1, 2);
+
+  std::vector<int32_t> head(size_t(1) << hash_bits, -1);
+  auto hash = [](uint32_t value) {
+    return (value * 2654435761u) >> (32 - hash_bits);
+  };
+  size_t i = 0;
+  while (i < size) {
+    uint32_t length = 0;
+    size_t distance = 0;
+    if (i + match_min <= size) {
+      uint32_t h = hash(read_u32(data + i));
+      int32_t candidate = head[h];
+      head[h] = int32_t(i);
+      if (candidate >= 0 && i - size_t(candidate) <= window_size) {
+        size_t limit = std::min(size - i, size_t(match_max));
+        uint8_t const* a = data + candidate;
+        uint8_t const* b = data + i;
+        size_t n = 0;
+        while (n < limit && a[n] == b[n]) ++n;
+        if (n >= match_min) {
+          length = uint32_t(n);
+          distance = i - size_t(candidate);
+        }
+      }
+    }
+    if (length > 0) {
+      uint32_t symbol = codes.length_symbols[length];
+      writer.put(codes.literal_codes[257 + symbol], codes.literal_lengths[257 + symbol]);
+      writer.put(length - length_base[symbol], length_extra[symbol]);
+      uint32_t symbol_distance = uint32_t(std::upper_bound(distance_base, distance_base + 30, distance) - distance_base) - 1;
+      writer.put(codes.distance_codes[symbol_distance], 5);
+      writer.put(uint32_t(distance) - distance_base[symbol_distance], distance_extra[symbol_distance]);
+      // index skipped positions so following matches can refer to them
+      size_t end = i + length;
+      for (++i; i < end; ++i) {
+        if (i + match_min <= size) {
+          head[hash(read_u32(data + i))] = int32_t(i);
+        }
+      }
+    }
+    else {
+      writer.put(codes.literal_codes[data[i]], codes.literal_lengths[data[i]]);
+      ++i;
+    }
+  }
+  // end of block
+  writer.put(codes.literal_codes[256], codes.literal_lengths[256]);
+  if (!final) {
+    writer.put(0, 3);
+    writer.align();
+    out.push_back(0x00);
+    out.push_back(0x00);
+    out.push_back(0xFF);
+    out.push_back(0xFF);
+  }
+  else {
+    writer.align();
+  }
+}
+
+static uint32_t adler32(uint8_t const* data, size_t size) {
+  uint32_t a = 1;
+  uint32_t b = 0;
+  while (size > 0) {
+    // largest block without overflowing b
+    size_t block = std::min(size, size_t(5552));
+    for (size_t i = 0; i < block; ++i) {
+      a += data[i];
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+    data += block;
+    size -= block;
+  }
+  return b << 16 | a;
+}
+
+// checksum of the concatenation, as adler32_combine in zlib
+static uint32_t adler32_combine(uint32_t adler1, uint32_t adler2, size_t size2) {
+  uint32_t const base = 65521;
+  uint32_t remainder = uint32_t(size2 % base);
+  uint32_t sum1 = adler1 & 0xffff;
+  uint32_t sum2 = uint32_t(uint64_t(remainder) * sum1 % base);
+  sum1 += (adler2 & 0xffff) + base - 1;
+  sum2 += (adler1 >> 16) + (adler2 >> 16) + base - remainder;
+  if (sum1 >= base) sum1 -= base;
+  if (sum1 >= base) sum1 -= base;
+  if (sum2 >= (base << 1)) sum2 -= (base << 1);
+  if (sum2 >= base) sum2 -= base;
+  return sum2 << 16 | sum1;
+}
+
+static uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
+  int p = int(a) + int(b) - int(c);
+  int pa = std::abs(p - int(a));
+  int pb = std::abs(p - int(b));
+  int pc = std::abs(p - int(c));
+  if (pa <= pb && pa <= pc) return a;
+  if (pb <= pc) return b;
+  return c;
+}
+
+// tries all filters and keeps the one with the smallest sum of absolute residuals, like lodepng
+// scratch holds three rows of residuals, the row above the first is all zero
+static void filter_row(uint8_t const* row, uint8_t const* prev, size_t size, uint8_t* scratch, uint8_t* out) {
+  size_t const bpp = 4;
+  uint8_t* sub = scratch;
+  uint8_t* up = scratch + size;
+  uint8_t* avg_paeth = scratch + size * 2;
+  size_t sums[4] = {0, 0, 0, 0};
+  auto filter = [&](size_t i, uint8_t left, uint8_t above_left) {
+    sub[i] = uint8_t(row[i] - left);
+    up[i] = uint8_t(row[i] - prev[i]);
+    avg_paeth[i] = uint8_t(row[i] - paeth(left, prev[i], above_left));
+    sums[0] += size_t(std::abs(int(int8_t(row[i]))));
+    sums[1] += size_t(std::abs(int(int8_t(sub[i]))));
+    sums[2] += size_t(std::abs(int(int8_t(up[i]))));
+    sums[3] += size_t(std::abs(int(int8_t(avg_paeth[i]))));
+  };
+  // first pixel has no left neighbour
+  for (size_t i = 0; i < bpp && i < size; ++i) {
+    filter(i, 0, 0);
+  }
+  for (size_t i = bpp; i < size; ++i) {
+    filter(i, row[i - bpp], prev[i - bpp]);
+  }
+  uint8_t const* rows[4] = {row, sub, up, avg_paeth};
+  uint8_t const types[4] = {0, 1, 2, 4};
+  size_t best = 0;
+  for (size_t f = 1; f < 4; ++f) {
+    if (sums[f] < sums[best]) best = f;
+  }
+  out[0] = types[best];
+  std::memcpy(out + 1, rows[best], size);
+}
+
+static void append_chunk(std::vector<uint8_t>& out, char const* type, std::vector<uint8_t> const& data) {
+  write_u32_be(out, uint32_t(data.size()));
+  size_t start = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data.begin(), data.end());
+  write_u32_be(out, lodepng_crc32(&out[start], out.size() - start));
+}
+
+// signature and header of an 8 bit rgba image
+static std::vector<uint8_t> png_header(uint32_t width, uint32_t height) {
+  std::vector<uint8_t> out{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  std::vector<uint8_t> header{};
+  write_u32_be(header, width);
+  write_u32_be(header, height);
+  // 8 bit rgba, deflate, adaptive filtering, no interlacing
+  header.insert(header.end(), {8, 6, 0, 0, 0});
+  append_chunk(out, "IHDR", header);
+  return out;
+}
+
+// zlib trailer in a separate chunk, it is only known once all strips are done
+static void append_png_trailer(std::vector<uint8_t>& out, uint32_t adler) {
+  std::vector<uint8_t> trailer{};
+  write_u32_be(trailer, adler);
+  append_chunk(out, "IDAT", trailer);
+  append_chunk(out, "IEND", {});
+}
+
+static uint32_t png_strip_rows(size_t row_size) {
+  return uint32_t(std::max(strip_size / (row_size + 1), size_t(1)));
+}
+
+// every strip becomes its own IDAT chunk, checksums are combined in order
+struct PngStrip {
+  std::vector<uint8_t> chunk;
+  uint32_t adler;
+  size_t size;
+};
+
+// prev is the row above the first one, nullptr at the top of the image
+static void encode_png_strip(uint8_t const* pixels, size_t row_pitch, size_t row_size, uint32_t row_count, uint8_t const* prev, bool first, bool final, PngStrip& strip) {
+  PROFILE_SCOPE("encode png strip");
+  std::vector<uint8_t> filtered(row_count * (row_size + 1));
+  std::vector<uint8_t> scratch(row_size * 4, 0);
+  for (uint32_t y = 0; y < row_count; ++y) {
+    uint8_t const* above = y > 0 ? pixels + (y - 1) * row_pitch : (prev ? prev : &scratch[row_size * 3]);
+    filter_row(pixels + y * row_pitch, above, row_size, scratch.data(), &filtered[y * (row_size + 1)]);
+  }
+  strip.adler = adler32(filtered.data(), filtered.size());
+  strip.size = filtered.size();
+
+  std::vector<uint8_t> data{};
+  data.reserve(filtered.size() / 2);
+  if (first) {
+    // zlib header, deflate with 32k window and fastest level
+    data.push_back(0x78);
+    data.push_back(0x01);
+  }
+  deflate_segment(filtered.data(), filtered.size(), final, data);
+  strip.chunk.clear();
+  append_chunk(strip.chunk, "IDAT", data);
+}
+
+static std::vector<uint8_t> encode_qoi(uint8_t const* pixels, uint32_t width, uint32_t height, size_t row_pitch) {
+  std::vector<uint8_t> out{};
+  out.reserve(size_t(width) * height * 2 + 22);
+  out.insert(out.end(), {'q', 'o', 'i', 'f'});
+  write_u32_be(out, width);
+  write_u32_be(out, height);
+  out.push_back(4);
+  out.push_back(0);
+
+  uint8_t index[64][4] = {};
+  uint8_t prev[4] = {0, 0, 0, 255};
+  uint32_t run = 0;
+  uint64_t const count = uint64_t(width) * height;
+  uint64_t position = 0;
+  for (uint32_t y = 0; y < height; ++y) {
+    uint8_t const* row = pixels + y * row_pitch;
+    for (uint32_t x = 0; x < width; ++x, ++position) {
+      uint8_t const* px = row + x * 4;
+      if (std::memcmp(px, prev, 4) == 0) {
+        ++run;
+        if (run == 62 || position + 1 == count) {
+          out.push_back(uint8_t(0xC0 | (run - 1)));
+          run = 0;
+        }
+        continue;
+      }
+      if (run > 0) {
+        out.push_back(uint8_t(0xC0 | (run - 1)));
+        run = 0;
+      }
+      uint32_t hash = (px[0] * 3u + px[1] * 5u + px[2] * 7u + px[3] * 11u) % 64;
+      if (std::memcmp(index[hash], px, 4) == 0) {
+        out.push_back(uint8_t(hash));
+      }
+      else {
+        std::memcpy(index[hash], px, 4);
+        if (px[3] == prev[3]) {
+          int vr = int8_t(uint8_t(px[0] - prev[0]));
+          int vg = int8_t(uint8_t(px[1] - prev[1]));
+          int vb = int8_t(uint8_t(px[2] - prev[2]));
+          int vg_r = vr - vg;
+          int vg_b = vb - vg;
+          if (vr >= -2 && vr <= 1 && vg >= -2 && vg <= 1 && vb >= -2 && vb <= 1) {
+            out.push_back(uint8_t(0x40 | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2)));
+          }
+          else if (vg >= -32 && vg <= 31 && vg_r >= -8 && vg_r <= 7 && vg_b >= -8 && vg_b <= 7) {
+            out.push_back(uint8_t(0x80 | (vg + 32)));
+            out.push_back(uint8_t((vg_r + 8) << 4 | (vg_b + 8)));
+          }
+          else {
+            out.insert(out.end(), {0xFE, px[0], px[1], px[2]});
+          }
+        }
+        else {
+          out.insert(out.end(), {0xFF, px[0], px[1], px[2], px[3]});
+        }
+      }
+      std::memcpy(prev, px, 4);
+    }
+  }
+  out.insert(out.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+  return out;
+}
+
+ImageWriter::ImageWriter(uint32_t thread_count, size_t max_pending)
+ :m_jobs{thread_count}
+ ,m_requests{}
+ ,m_max_pending{std::max(max_pending, size_t(1))}
+ ,m_busy{false}
+ ,m_running{true}
+ ,m_mutex{}
+ ,m_cv_request{}
+ ,m_cv_done{}
+ ,m_thread{}
+{
+  m_thread = std::thread{&ImageWriter::work, this};
+}
+
+ImageWriter::~ImageWriter() {
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_running = false;
+  }
+  m_cv_request.notify_all();
+  m_thread.join();
+}
+
+std::shared_future<void> ImageWriter::write(std::string const& path, ImageFormat format, uint8_t const* pixels, uint32_t width, uint32_t height, size_t row_pitch, PixelFormat pixel_format) {
+  std::unique_lock<std::mutex> lock{m_mutex};
+  // bounds memory held by queued frames
+  m_cv_done.wait(lock, [this]{ return m_requests.size() < m_max_pending; });
+  m_requests.push_back(Request{path, format, pixels, width, height, row_pitch, pixel_format, std::promise<void>{}});
+  std::shared_future<void> future = m_requests.back().promise.get_future().share();
+  lock.unlock();
+  m_cv_request.notify_one();
+  return future;
+}
+
+std::vector<uint8_t> ImageWriter::encode(ImageFormat format, uint8_t const* pixels, uint32_t width, uint32_t height, size_t row_pitch, PixelFormat pixel_format) {
+  if (width == 0 || height == 0) {
+    throw std::runtime_error{"Cannot encode empty image"};
+  }
+  if (row_pitch < size_t(width) * pixel_size(pixel_format)) {
+    throw std::runtime_error{"Row pitch is smaller than a row"};
+  }
+  // other formats are converted to packed rgba8 first, in parallel row ranges
+  std::vector<uint8_t> converted{};
+  if (pixel_format != PixelFormat::eRgba8Unorm && pixel_format != PixelFormat::eRgba8Srgb) {
+    PROFILE_SCOPE("convert pixels");
+    PixelFormat target = is_srgb(pixel_format) ? PixelFormat::eRgba8Srgb : PixelFormat::eRgba8Unorm;
+    size_t const row_size = size_t(width) * 4;
+    converted.resize(row_size * height);
+    m_jobs.parallel_for(height, 64, [&](uint32_t begin, uint32_t end, uint32_t) {
+      convert_pixels(pixel_format, pixels + begin * row_pitch, row_pitch, target, &converted[begin * row_size], row_size, width, end - begin);
+    });
+    pixels = converted.data();
+    row_pitch = row_size;
+  }
+  if (format == ImageFormat::ePng) {
+    return encode_png(pixels, width, height, row_pitch);
+  }
+  else if (format == ImageFormat::eQoi) {
+    PROFILE_SCOPE("encode qoi");
+    return encode_qoi(pixels, width, height, row_pitch);
+  }
+  PROFILE_SCOPE("encode lodepng");
+  // lodepng needs tightly packed rows
+  std::vector<uint8_t> packed{};
+  uint8_t const* data = pixels;
+  size_t const row_size = size_t(width) * 4;
+  if (row_pitch != row_size) {
+    packed.resize(row_size * height);
+    convert_pixels(PixelFormat::eRgba8Unorm, pixels, row_pitch, PixelFormat::eRgba8Unorm, packed.data(), row_size, width, height);
+    data = packed.data();
+  }
+  std::vector<uint8_t> out{};
+  unsigned error = lodepng::encode(out, data, width, height);
+  if (error) {
+    throw std::runtime_error{std::string{"Failed to encode png: "} + lodepng_error_text(error)};
+  }
+  return out;
+}
+
+std::vector<uint8_t> ImageWriter::encode_png(uint8_t const* pixels, uint32_t width, uint32_t height, size_t row_pitch) {
+  PROFILE_SCOPE("encode png");
+  size_t const row_size = size_t(width) * 4;
+  uint32_t const strip_rows = png_strip_rows(row_size);
+  uint32_t const strip_count = (height + strip_rows - 1) / strip_rows;
+
+  std::vector<PngStrip> strips(strip_count);
+  m_jobs.parallel_for(strip_count, 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+    for (uint32_t strip = begin; strip < end; ++strip) {
+      uint32_t row_begin = strip * strip_rows;
+      uint32_t row_end = std::min(row_begin + strip_rows, height);
+      uint8_t const* prev = row_begin > 0 ? pixels + (row_begin - 1) * row_pitch : nullptr;
+      encode_png_strip(pixels + row_begin * row_pitch, row_pitch, row_size, row_end - row_begin, prev, strip == 0, strip + 1 == strip_count, strips[strip]);
+    }
+  });
+
+  std::vector<uint8_t> out = png_header(width, height);
+  uint32_t adler = strips[0].adler;
+  for (uint32_t strip = 0; strip < strip_count; ++strip) {
+    out.insert(out.end(), strips[strip].chunk.begin(), strips[strip].chunk.end());
+    if (strip > 0) {
+      adler = adler32_combine(adler, strips[strip].adler, strips[strip].size);
+    }
+  }
+  append_png_trailer(out, adler);
+  return out;
+}
+
+void ImageWriter::wait_idle() {
+  std::unique_lock<std::mutex> lock{m_mutex};
+  m_cv_done.wait(lock, [this]{ return m_requests.empty() && !m_busy; });
+}
+
+void ImageWriter::work() {
+  PROFILE_THREAD_NAME("image writer");
+  std::unique_lock<std::mutex> lock{m_mutex};
+  while (true) {
+    m_cv_request.wait(lock, [this]{ return !m_requests.empty() || !m_running; });
+    // pending writes are finished before shutting down
+    if (m_requests.empty()) return;
+
+    Request request = std::move(m_requests.front());
+    m_requests.pop_front();
+    m_busy = true;
+    lock.unlock();
+    m_cv_done.notify_all();
+
+    try {
+      std::vector<uint8_t> data = encode(request.format, request.pixels, request.width, request.height, request.row_pitch, request.pixel_format);
+      PROFILE_SCOPE("write file");
+      std::ofstream file{request.path, std::ios::binary | std::ios::trunc};
+      file.write(reinterpret_cast<char const*>(data.data()), std::streamsize(data.size()));
+      if (!file) {
+        throw std::runtime_error{"Failed to write image '" + request.path + "'"};
+      }
+      request.promise.set_value();
+    }
+    catch (...) {
+      request.promise.set_exception(std::current_exception());
+    }
+
+    lock.lock();
+    m_busy = false;
+    m_cv_done.notify_all();
+  }
+}
+
+PngStream::PngStream(std::string const& path, uint32_t width, uint32_t height, JobSystem* jobs)
+ :m_path{path}
+ ,m_file{path, std::ios::binary | std::ios::trunc}
+ ,m_jobs{jobs}
+ ,m_width{width}
+ ,m_height{height}
+ ,m_rows{0}
+ ,m_adler{1}
+ ,m_prev(size_t(width) * 4)
+{
+  if (width == 0 || height == 0) {
+    throw std::runtime_error{"Cannot encode empty image"};
+  }
+  write(png_header(width, height));
+}
+
+void PngStream::write_rows(uint8_t const* pixels, uint32_t row_count, size_t row_pitch) {
+  PROFILE_SCOPE("stream png rows");
+  size_t const row_size = size_t(m_width) * 4;
+  if (row_pitch < row_size) {
+    throw std::runtime_error{"Row pitch is smaller than a row"};
+  }
+  if (row_count > m_height - m_rows) {
+    throw std::runtime_error{"Image stream exceeds image height"};
+  }
+  if (row_count == 0) return;
+
+  uint32_t const strip_rows = png_strip_rows(row_size);
+  uint32_t const strip_count = (row_count + strip_rows - 1) / strip_rows;
+  std::vector<PngStrip> strips(strip_count);
+  auto encode_strips = [&](uint32_t begin, uint32_t end, uint32_t) {
+    for (uint32_t strip = begin; strip < end; ++strip) {
+      uint32_t row_begin = strip * strip_rows;
+      uint32_t row_end = std::min(row_begin + strip_rows, row_count);
+      uint8_t const* prev = row_begin > 0 ? pixels + (row_begin - 1) * row_pitch : (m_rows > 0 ? m_prev.data() : nullptr);
+      bool first = m_rows == 0 && strip == 0;
+      bool final = m_rows + row_end == m_height;
+      encode_png_strip(pixels + row_begin * row_pitch, row_pitch, row_size, row_end - row_begin, prev, first, final, strips[strip]);
+    }
+  };
+  if (m_jobs) {
+    m_jobs->parallel_for(strip_count, 1, encode_strips);
+  }
+  else {
+    encode_strips(0, strip_count, 0);
+  }
+
+  for (uint32_t strip = 0; strip < strip_count; ++strip) {
+    write(strips[strip].chunk);
+    m_adler = m_rows == 0 && strip == 0 ? strips[strip].adler : adler32_combine(m_adler, strips[strip].adler, strips[strip].size);
+  }
+  std::memcpy(m_prev.data(), pixels + (row_count - 1) * row_pitch, row_size);
+  m_rows += row_count;
+}
+
+void PngStream::finish() {
+  if (m_rows != m_height) {
+    throw std::runtime_error{"Image stream ended after " + std::to_string(m_rows) + " of " + std::to_string(m_height) + " rows"};
+  }
+  std::vector<uint8_t> out{};
+  append_png_trailer(out, m_adler);
+  write(out);
+  m_file.close();
+}
+
+uint32_t PngStream::rows_written() const {
+  return m_rows;
+}
+
+void PngStream::write(std::vector<uint8_t> const& data) {
+  m_file.write(reinterpret_cast<char const*>(data.data()), std::streamsize(data.size()));
+  if (!m_file) {
+    throw std::runtime_error{"Failed to write image '" + m_path + "'"};
+  }
+}
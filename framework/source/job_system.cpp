@@ -0,0 +1,157 @@
+#include "job_system.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <string>
+
+// job system and index of the worker running on this thread
+static thread_local JobSystem const* current_system = nullptr;
+static thread_local uint32_t current_worker = 0;
+
+JobSystem::Group::Group()
+ :unfinished{0}
+ ,exception{}
+{}
+
+JobSystem::JobSystem(uint32_t thread_count)
+ :m_queues(std::max(thread_count, 1u))
+ ,m_threads{}
+ ,m_next{0}
+ ,m_queued{0}
+ ,m_submitted{}
+ ,m_running{true}
+{
+  for (uint32_t i = 0; i < m_queues.size(); ++i) {
+    m_threads.push_back(std::thread{&JobSystem::work, this, i});
+  }
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_running = false;
+  }
+  m_cv_work.notify_all();
+  for (auto& thread : m_threads) {
+    thread.join();
+  }
+}
+
+void JobSystem::submit(Task const& task) {
+  enqueue(task, m_submitted);
+}
+
+void JobSystem::parallel_for(uint32_t count, uint32_t grain_size, std::function<void(uint32_t, uint32_t, uint32_t)> const& fn) {
+  grain_size = std::max(grain_size, 1u);
+  Group group{};
+  for (uint32_t begin = 0; begin < count; begin += grain_size) {
+    uint32_t end = std::min(count, begin + grain_size);
+    enqueue([&fn, begin, end](uint32_t worker) { fn(begin, end, worker); }, group);
+  }
+  wait(group);
+}
+
+void JobSystem::wait() {
+  wait(m_submitted);
+}
+
+void JobSystem::enqueue(Task const& task, Group& group) {
+  ++group.unfinished;
+  Queue& queue = m_queues[m_next++ % m_queues.size()];
+  {
+    std::lock_guard<std::mutex> lock{queue.mutex};
+    queue.jobs.push_back(Job{task, &group});
+  }
+  {
+    // increment under lock so sleeping workers cannot miss it
+    std::lock_guard<std::mutex> lock{m_mutex};
+    ++m_queued;
+  }
+  m_cv_work.notify_one();
+}
+
+void JobSystem::execute(Job& job, uint32_t index) {
+  Group& group = *job.group;
+  try {
+    PROFILE_SCOPE("job");
+    job.task(index);
+  }
+  catch (...) {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (!group.exception) {
+      group.exception = std::current_exception();
+    }
+  }
+  // the group may be destroyed by its waiter once the count reaches zero
+  if (--group.unfinished == 0) {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_cv_done.notify_all();
+  }
+}
+
+void JobSystem::wait(Group& group) {
+  if (current_system == this) {
+    // blocking a worker could leave the group without anyone to execute it
+    while (group.unfinished > 0) {
+      Job job{};
+      if (pop(current_worker, job) || steal(current_worker, job)) {
+        execute(job, current_worker);
+      }
+      else {
+        std::this_thread::yield();
+      }
+    }
+  }
+  std::unique_lock<std::mutex> lock{m_mutex};
+  m_cv_done.wait(lock, [&group]{ return group.unfinished == 0; });
+  if (group.exception) {
+    std::exception_ptr exception{};
+    std::swap(exception, group.exception);
+    std::rethrow_exception(exception);
+  }
+}
+
+uint32_t JobSystem::thread_count() const {
+  return uint32_t(m_threads.size());
+}
+
+void JobSystem::work(uint32_t index) {
+  PROFILE_THREAD_NAME("worker " + std::to_string(index));
+  current_system = this;
+  current_worker = index;
+  while (true) {
+    Job job{};
+    if (pop(index, job) || steal(index, job)) {
+      execute(job, index);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_cv_work.wait(lock, [this]{ return m_queued > 0 || !m_running; });
+    if (!m_running && m_queued == 0) return;
+  }
+}
+
+bool JobSystem::pop(uint32_t index, Job& job) {
+  Queue& queue = m_queues[index];
+  std::lock_guard<std::mutex> lock{queue.mutex};
+  if (queue.jobs.empty()) return false;
+  // own work is taken from the back for locality
+  job = std::move(queue.jobs.back());
+  queue.jobs.pop_back();
+  --m_queued;
+  return true;
+}
+
+bool JobSystem::steal(uint32_t index, Job& job) {
+  for (size_t i = 1; i < m_queues.size(); ++i) {
+    Queue& queue = m_queues[(index + i) % m_queues.size()];
+    std::lock_guard<std::mutex> lock{queue.mutex};
+    if (!queue.jobs.empty()) {
+      job = std::move(queue.jobs.front());
+      queue.jobs.pop_front();
+      --m_queued;
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,79 @@
+#include "parallel_recorder.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+
+ParallelRecorder::ParallelRecorder(vk::Device const& device, uint32_t queue_family, JobSystem& jobs)
+ :m_device{device}
+ ,m_dispatch{&device_dispatch(device)}
+ ,m_jobs{&jobs}
+ ,m_pools(jobs.thread_count())
+{
+  vk::CommandPoolCreateInfo info_command_pool{};
+  info_command_pool.queueFamilyIndex = queue_family;
+  info_command_pool.flags = vk::CommandPoolCreateFlagBits::eTransient;
+  for (auto& pool : m_pools) {
+    pool.pool = m_device.createCommandPool(info_command_pool, nullptr, *m_dispatch);
+    pool.used_primaries = 0;
+    pool.used_secondaries = 0;
+  }
+}
+
+ParallelRecorder::~ParallelRecorder() {
+  for (auto& pool : m_pools) {
+    m_device.destroyCommandPool(pool.pool, nullptr, *m_dispatch);
+  }
+}
+
+std::vector<vk::CommandBuffer> ParallelRecorder::record(vk::CommandBufferLevel level, uint32_t count, uint32_t chunk_size, Function const& fn) {
+  chunk_size = std::max(chunk_size, 1u);
+  std::vector<vk::CommandBuffer> command_buffers((count + chunk_size - 1) / chunk_size);
+  // secondary buffers are executed outside of a render pass
+  vk::CommandBufferInheritanceInfo info_inheritance{};
+  vk::CommandBufferBeginInfo info_cb_begin{};
+  info_cb_begin.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+  if (level == vk::CommandBufferLevel::eSecondary) {
+    info_cb_begin.pInheritanceInfo = &info_inheritance;
+  }
+
+  m_jobs->parallel_for(count, chunk_size, [&](uint32_t begin, uint32_t end, uint32_t worker) {
+    PROFILE_SCOPE("record chunk");
+    // each pool is only used by its own worker
+    vk::CommandBuffer command_buffer = acquire(m_pools[worker], level);
+    command_buffer.begin(info_cb_begin, *m_dispatch);
+    fn(command_buffer, begin, end);
+    command_buffer.end(*m_dispatch);
+    // chunks are stored by position to keep submission order deterministic
+    command_buffers[begin / chunk_size] = command_buffer;
+  });
+  return command_buffers;
+}
+
+void ParallelRecorder::record(vk::CommandBuffer const& primary, uint32_t count, uint32_t chunk_size, Function const& fn) {
+  std::vector<vk::CommandBuffer> secondaries = record(vk::CommandBufferLevel::eSecondary, count, chunk_size, fn);
+  if (!secondaries.empty()) {
+    primary.executeCommands(secondaries, *m_dispatch);
+  }
+}
+
+void ParallelRecorder::reset() {
+  for (auto& pool : m_pools) {
+    m_device.resetCommandPool(pool.pool, vk::CommandPoolResetFlags{}, *m_dispatch);
+    pool.used_primaries = 0;
+    pool.used_secondaries = 0;
+  }
+}
+
+vk::CommandBuffer ParallelRecorder::acquire(WorkerPool& pool, vk::CommandBufferLevel level) {
+  bool primary = level == vk::CommandBufferLevel::ePrimary;
+  std::vector<vk::CommandBuffer>& command_buffers = primary ? pool.primaries : pool.secondaries;
+  size_t& used = primary ? pool.used_primaries : pool.used_secondaries;
+  if (used == command_buffers.size()) {
+    vk::CommandBufferAllocateInfo info_command_buffer{};
+    info_command_buffer.commandPool = pool.pool;
+    info_command_buffer.level = level;
+    info_command_buffer.commandBufferCount = 1;
+    command_buffers.push_back(m_device.allocateCommandBuffers(info_command_buffer, *m_dispatch).front());
+  }
+  return command_buffers[used++];
+}
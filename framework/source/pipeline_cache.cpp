@@ -0,0 +1,166 @@
+#include "pipeline_cache.hpp"
+
+#include "bring_up.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// file layout: magic, blob size, blob checksum, driver blob
+static char const file_magic[4] = {'V', 'M', 'P', 'C'};
+static size_t const file_header_size = 4 + 8 + 4;
+// size of VkPipelineCacheHeaderVersionOne
+static size_t const driver_header_size = 16 + VK_UUID_SIZE;
+
+// header fields are stored least significant byte first
+static uint32_t read_u32(uint8_t const* ptr) {
+  return uint32_t(ptr[0]) | uint32_t(ptr[1]) << 8 | uint32_t(ptr[2]) << 16 | uint32_t(ptr[3]) << 24;
+}
+
+static void write_u32(uint8_t* ptr, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    ptr[i] = uint8_t(value >> (8 * i));
+  }
+}
+
+// FNV-1a
+static uint32_t checksum(uint8_t const* data, size_t size) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ data[i]) * 16777619u;
+  }
+  return hash;
+}
+
+// returns driver blob or nothing if the file is missing or damaged
+static std::vector<uint8_t> read_blob(std::string const& path) {
+  std::ifstream file{path, std::ios::binary | std::ios::ate};
+  if (!file) return {};
+  std::streamsize size = file.tellg();
+  if (size < std::streamsize(file_header_size)) return {};
+
+  std::vector<uint8_t> data(size_t(size), 0);
+  file.seekg(0);
+  file.read(reinterpret_cast<char*>(data.data()), size);
+  if (!file || std::memcmp(data.data(), file_magic, 4) != 0) return {};
+
+  uint64_t blob_size = uint64_t(read_u32(&data[4])) | uint64_t(read_u32(&data[8])) << 32;
+  if (blob_size != data.size() - file_header_size) return {};
+  if (checksum(&data[file_header_size], size_t(blob_size)) != read_u32(&data[12])) return {};
+
+  return std::vector<uint8_t>(data.begin() + file_header_size, data.end());
+}
+
+PipelineCache::PipelineCache()
+ :m_device{}
+ ,m_dispatch{nullptr}
+ ,m_cache{}
+ ,m_path{}
+ ,m_warm{false}
+{}
+
+PipelineCache::PipelineCache(vk::Device const& device, vk::PhysicalDevice const& phys_device, std::string const& path)
+ :m_device{device}
+ ,m_dispatch{&device_dispatch(device)}
+ ,m_cache{}
+ ,m_path{path}
+ ,m_warm{false}
+{
+  std::vector<uint8_t> blob = read_blob(m_path);
+  m_warm = validate(blob, phys_device.getProperties());
+  if (!m_warm && !blob.empty()) {
+    std::cerr << "Discarding stale pipeline cache '" << m_path << "'" << std::endl;
+  }
+
+  vk::PipelineCacheCreateInfo info_cache{};
+  if (m_warm) {
+    info_cache.initialDataSize = blob.size();
+    info_cache.pInitialData = blob.data();
+  }
+  m_cache = m_device.createPipelineCache(info_cache, nullptr, *m_dispatch);
+}
+
+PipelineCache::PipelineCache(PipelineCache&& rhs)
+ :PipelineCache{}
+{
+  std::swap(m_device, rhs.m_device);
+  std::swap(m_dispatch, rhs.m_dispatch);
+  std::swap(m_cache, rhs.m_cache);
+  std::swap(m_path, rhs.m_path);
+  std::swap(m_warm, rhs.m_warm);
+}
+
+PipelineCache& PipelineCache::operator=(PipelineCache&& rhs) {
+  cleanup();
+  std::swap(m_device, rhs.m_device);
+  std::swap(m_dispatch, rhs.m_dispatch);
+  std::swap(m_cache, rhs.m_cache);
+  std::swap(m_path, rhs.m_path);
+  std::swap(m_warm, rhs.m_warm);
+  return *this;
+}
+
+PipelineCache::~PipelineCache() {
+  cleanup();
+}
+
+void PipelineCache::cleanup() {
+  if (m_cache) {
+    save();
+    m_device.destroyPipelineCache(m_cache, nullptr, *m_dispatch);
+    m_cache = vk::PipelineCache{};
+  }
+}
+
+void PipelineCache::save() const {
+  std::vector<uint8_t> blob = m_device.getPipelineCacheData(m_cache, *m_dispatch);
+  if (blob.empty()) return;
+
+  uint8_t header[file_header_size];
+  std::memcpy(header, file_magic, 4);
+  write_u32(&header[4], uint32_t(uint64_t(blob.size())));
+  write_u32(&header[8], uint32_t(uint64_t(blob.size()) >> 32));
+  write_u32(&header[12], checksum(blob.data(), blob.size()));
+
+  // write next to target and rename, so readers never see partial files
+  std::string path_tmp = m_path + ".tmp";
+  {
+    std::ofstream file{path_tmp, std::ios::binary | std::ios::trunc};
+    file.write(reinterpret_cast<char const*>(header), file_header_size);
+    file.write(reinterpret_cast<char const*>(blob.data()), std::streamsize(blob.size()));
+    if (!file) {
+      std::cerr << "Failed to write pipeline cache '" << path_tmp << "'" << std::endl;
+      return;
+    }
+  }
+#ifdef _WIN32
+  // rename does not replace existing files on windows
+  std::remove(m_path.c_str());
+#endif
+  if (std::rename(path_tmp.c_str(), m_path.c_str()) != 0) {
+    std::cerr << "Failed to replace pipeline cache '" << m_path << "'" << std::endl;
+  }
+}
+
+vk::PipelineCache const& PipelineCache::get() const {
+  return m_cache;
+}
+
+bool PipelineCache::warm() const {
+  return m_warm;
+}
+
+bool PipelineCache::validate(std::vector<uint8_t> const& blob, vk::PhysicalDeviceProperties const& properties) {
+  if (blob.size() < driver_header_size) return false;
+
+  uint32_t header_size = read_u32(&blob[0]);
+  uint32_t header_version = read_u32(&blob[4]);
+  uint32_t vendor_id = read_u32(&blob[8]);
+  uint32_t device_id = read_u32(&blob[12]);
+  // VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+  if (header_size < driver_header_size || header_size > blob.size() || header_version != 1) return false;
+  if (vendor_id != properties.vendorID || device_id != properties.deviceID) return false;
+  // uuid changes with driver version
+  return std::memcmp(&blob[16], properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
@@ -0,0 +1,82 @@
+#include "pipeline_table.hpp"
+
+#include <stdexcept>
+
+#ifdef SHADERS_EMBEDDED
+#include "shaders/blur_comp.hpp"
+#include "shaders/fill_comp.hpp"
+#include "shaders/histogram_comp.hpp"
+#include "shaders/histogram_subgroup_comp.hpp"
+#include "shaders/radix_count_comp.hpp"
+#include "shaders/radix_scatter_comp.hpp"
+#include "shaders/radix_scatter_subgroup_comp.hpp"
+#include "shaders/reduce_comp.hpp"
+#include "shaders/reduce_subgroup_comp.hpp"
+#include "shaders/scan_add_comp.hpp"
+#include "shaders/scan_comp.hpp"
+#include "shaders/scan_subgroup_comp.hpp"
+#endif
+
+PipelineParameters::PipelineParameters()
+ :shader{}
+ ,workgroup_size{0}
+ ,constants{}
+{}
+
+PipelineParameters::PipelineParameters(std::string const& shader, glm::uvec3 const& workgroup_size, std::map<uint32_t, uint32_t> const& constants)
+ :shader{shader}
+ ,workgroup_size{workgroup_size}
+ ,constants{constants}
+{}
+
+std::vector<PipelineParameters> const& sample_pipelines() {
+  static std::vector<PipelineParameters> const pipelines{
+    PipelineParameters{"fill", glm::uvec3{16, 16, 1}},
+    PipelineParameters{"blur", glm::uvec3{16, 16, 1}}
+  };
+  return pipelines;
+}
+
+PipelineParameters const& sample_pipeline(std::string const& shader) {
+  for (auto const& parameters : sample_pipelines()) {
+    if (parameters.shader == shader) return parameters;
+  }
+  throw std::runtime_error{"No sample pipeline uses shader " + shader};
+}
+
+#ifdef SHADERS_EMBEDDED
+template<size_t N>
+static std::vector<uint32_t> embedded(uint32_t const (&code)[N]) {
+  return std::vector<uint32_t>{code, code + N};
+}
+
+static std::vector<uint32_t> embedded_code(std::string const& name) {
+  if (name == "fill") return embedded(shaders::fill_comp);
+  if (name == "blur") return embedded(shaders::blur_comp);
+  if (name == "reduce") return embedded(shaders::reduce_comp);
+  if (name == "reduce_subgroup") return embedded(shaders::reduce_subgroup_comp);
+  if (name == "scan") return embedded(shaders::scan_comp);
+  if (name == "scan_subgroup") return embedded(shaders::scan_subgroup_comp);
+  if (name == "scan_add") return embedded(shaders::scan_add_comp);
+  if (name == "histogram") return embedded(shaders::histogram_comp);
+  if (name == "histogram_subgroup") return embedded(shaders::histogram_subgroup_comp);
+  if (name == "radix_count") return embedded(shaders::radix_count_comp);
+  if (name == "radix_scatter") return embedded(shaders::radix_scatter_comp);
+  if (name == "radix_scatter_subgroup") return embedded(shaders::radix_scatter_subgroup_comp);
+  throw std::runtime_error{"No embedded shader " + name};
+}
+#endif
+
+Shader load_shader(vk::Device const& device, std::string const& shader_dir, std::string const& name) {
+#ifdef SHADERS_EMBEDDED
+  (void)shader_dir;
+  return Shader{device, embedded_code(name)};
+#else
+  return Shader{device, shader_dir + name + ".comp.spv"};
+#endif
+}
+
+ComputePipeline create_pipeline(vk::Device const& device, std::string const& shader_dir, vk::PipelineCache const& cache, PipelineParameters const& parameters, uint32_t max_sets) {
+  Shader shader = load_shader(device, shader_dir, parameters.shader);
+  return ComputePipeline{device, shader, cache, parameters.workgroup_size, parameters.constants, max_sets};
+}
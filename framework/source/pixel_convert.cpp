@@ -0,0 +1,723 @@
+#include "pixel_convert.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define PIXEL_CONVERT_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// simd kernels are compiled for their instruction set without changing the global flags
+#if defined(PIXEL_CONVERT_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2,f16c")))
+#else
+#define TARGET_SSE41
+#define TARGET_AVX2
+#endif
+
+static float const inv_255 = 1.0f / 255.0f;
+static float const inv_1023 = 1.0f / 1023.0f;
+static float const inv_3 = 1.0f / 3.0f;
+
+static uint32_t float_bits(float value) {
+  uint32_t bits = 0;
+  std::memcpy(&bits, &value, 4);
+  return bits;
+}
+
+static float bits_float(uint32_t bits) {
+  float value = 0.0f;
+  std::memcpy(&value, &bits, 4);
+  return value;
+}
+
+// clamps to [0, 1] with NaN mapped to 0, in the operand order of maxps and minps
+static float saturate(float value) {
+  value = value > 0.0f ? value : 0.0f;
+  return value < 1.0f ? value : 1.0f;
+}
+
+// constants of the half conversions, see Fabian Giesen's branchless float/half conversions
+static uint32_t const half_magic = (254 - 15) << 23;
+static uint32_t const half_max = (127 + 16) << 23;
+static uint32_t const half_min_normal = (127 - 14) << 23;
+static uint32_t const half_subnormal_magic = ((127 - 15) + (23 - 10) + 1) << 23;
+static uint32_t const half_normal_bias = 0xfff - ((127 - 15) << 23);
+
+static float half_to_float_scalar(uint16_t half) {
+  uint32_t exponent_mantissa = half & 0x7fffu;
+  // rescaling the shifted bits by 2^112 handles normals and subnormals alike
+  uint32_t bits = float_bits(bits_float(exponent_mantissa << 13) * bits_float(half_magic));
+  if (exponent_mantissa > 0x7bffu) {
+    bits |= 255u << 23;
+  }
+  return bits_float(bits | uint32_t(half & 0x8000u) << 16);
+}
+
+static uint16_t float_to_half_scalar(float value) {
+  uint32_t bits = float_bits(value);
+  uint32_t sign = bits & 0x80000000u;
+  bits ^= sign;
+  uint32_t half = 0;
+  if (bits >= half_max) {
+    // infinity, or a quiet NaN
+    half = bits > 0x7f800000u ? 0x7e00u : 0x7c00u;
+  }
+  else if (bits < half_min_normal) {
+    // adding the magic value rounds the mantissa into the low bits
+    half = float_bits(bits_float(bits) + bits_float(half_subnormal_magic)) - half_subnormal_magic;
+  }
+  else {
+    uint32_t odd = (bits >> 13) & 1;
+    half = (bits + half_normal_bias + odd) >> 13;
+  }
+  return uint16_t(half | sign >> 16);
+}
+
+// srgb decoding table and a piecewise linear fit of the encoding, after stb_image_resize
+// the encoder splits [2^-13, 1) into 104 buckets of 8 per octave, each interpolated over
+// the next 8 mantissa bits in 16.16 fixed point
+struct SrgbTables {
+  SrgbTables() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      double value = i / 255.0;
+      decode[i] = float(value <= 0.04045 ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4));
+    }
+    for (uint32_t bucket = 0; bucket < 104; ++bucket) {
+      // least squares over the centers of the 256 steps
+      double sum_t = 0.0;
+      double sum_tt = 0.0;
+      double sum_y = 0.0;
+      double sum_ty = 0.0;
+      for (uint32_t t = 0; t < 256; ++t) {
+        double y = 255.0 * encode_exact(bits_float(min_bits + (bucket << 20) + (t << 12) + (1 << 11)));
+        sum_t += t;
+        sum_tt += double(t) * t;
+        sum_y += y;
+        sum_ty += t * y;
+      }
+      double slope = (256.0 * sum_ty - sum_t * sum_y) / (256.0 * sum_tt - sum_t * sum_t);
+      double offset = (sum_y - slope * sum_t) / 256.0;
+      // the half step makes the final shift round to nearest
+      bias[bucket] = uint32_t((offset + 0.5) * 65536.0 + 0.5);
+      scale[bucket] = uint32_t(slope * 65536.0 + 0.5);
+    }
+  }
+
+  static double encode_exact(double value) {
+    return value <= 0.0031308 ? value * 12.92 : 1.055 * std::pow(value, 1.0 / 2.4) - 0.055;
+  }
+
+  static uint32_t const min_bits = (127 - 13) << 23;
+  static uint32_t const almost_one_bits = 0x3f7fffff;
+
+  float decode[256];
+  uint32_t bias[104];
+  uint32_t scale[104];
+};
+
+static SrgbTables const& srgb_tables() {
+  static SrgbTables const tables{};
+  return tables;
+}
+
+static uint8_t linear_to_srgb8_scalar(float value, SrgbTables const& tables) {
+  // written so NaN ends up at the lower bound
+  float clamped = value > bits_float(SrgbTables::min_bits) ? value : bits_float(SrgbTables::min_bits);
+  clamped = clamped < bits_float(SrgbTables::almost_one_bits) ? clamped : bits_float(SrgbTables::almost_one_bits);
+  uint32_t bits = float_bits(clamped);
+  uint32_t bucket = (bits - SrgbTables::min_bits) >> 20;
+  uint32_t t = (bits >> 12) & 0xff;
+  return uint8_t((tables.bias[bucket] + tables.scale[bucket] * t) >> 16);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// scalar reference
+
+static void unorm8_to_float_scalar(uint8_t const* src, float* dst, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    dst[i] = float(src[i]) * inv_255;
+  }
+}
+
+static void float_to_unorm8_scalar(float const* src, uint8_t* dst, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    dst[i] = uint8_t(saturate(src[i]) * 255.0f + 0.5f);
+  }
+}
+
+static void half_to_float_scalar(uint16_t const* src, float* dst, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    dst[i] = half_to_float_scalar(src[i]);
+  }
+}
+
+static void float_to_half_scalar(float const* src, uint16_t* dst, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    dst[i] = float_to_half_scalar(src[i]);
+  }
+}
+
+static void srgb8_to_linear_scalar(uint8_t const* src, float* dst, size_t pixel_count) {
+  SrgbTables const& tables = srgb_tables();
+  for (size_t i = 0; i < pixel_count * 4; i += 4) {
+    dst[i] = tables.decode[src[i]];
+    dst[i + 1] = tables.decode[src[i + 1]];
+    dst[i + 2] = tables.decode[src[i + 2]];
+    dst[i + 3] = float(src[i + 3]) * inv_255;
+  }
+}
+
+static void linear_to_srgb8_scalar(float const* src, uint8_t* dst, size_t pixel_count) {
+  SrgbTables const& tables = srgb_tables();
+  for (size_t i = 0; i < pixel_count * 4; i += 4) {
+    dst[i] = linear_to_srgb8_scalar(src[i], tables);
+    dst[i + 1] = linear_to_srgb8_scalar(src[i + 1], tables);
+    dst[i + 2] = linear_to_srgb8_scalar(src[i + 2], tables);
+    dst[i + 3] = uint8_t(saturate(src[i + 3]) * 255.0f + 0.5f);
+  }
+}
+
+static void unpack_a2b10g10r10_scalar(uint32_t const* src, float* dst, size_t pixel_count) {
+  for (size_t i = 0; i < pixel_count; ++i) {
+    dst[i * 4] = float(src[i] & 0x3ff) * inv_1023;
+    dst[i * 4 + 1] = float(src[i] >> 10 & 0x3ff) * inv_1023;
+    dst[i * 4 + 2] = float(src[i] >> 20 & 0x3ff) * inv_1023;
+    dst[i * 4 + 3] = float(src[i] >> 30) * inv_3;
+  }
+}
+
+static void pack_a2b10g10r10_scalar(float const* src, uint32_t* dst, size_t pixel_count) {
+  for (size_t i = 0; i < pixel_count; ++i) {
+    dst[i] = uint32_t(saturate(src[i * 4]) * 1023.0f + 0.5f)
+           | uint32_t(saturate(src[i * 4 + 1]) * 1023.0f + 0.5f) << 10
+           | uint32_t(saturate(src[i * 4 + 2]) * 1023.0f + 0.5f) << 20
+           | uint32_t(saturate(src[i * 4 + 3]) * 3.0f + 0.5f) << 30;
+  }
+}
+
+static void swizzle_rgba8_scalar(uint8_t const* src, uint8_t* dst, size_t pixel_count, uint8_t const order[4]) {
+  // copy first so src and dst may alias
+  for (size_t i = 0; i < pixel_count * 4; i += 4) {
+    uint8_t pixel[4] = {src[i], src[i + 1], src[i + 2], src[i + 3]};
+    dst[i] = pixel[order[0]];
+    dst[i + 1] = pixel[order[1]];
+    dst[i + 2] = pixel[order[2]];
+    dst[i + 3] = pixel[order[3]];
+  }
+}
+
+#ifdef PIXEL_CONVERT_X86
+///////////////////////////////////////////////////////////////////////////////
+// sse 4.1, remainders are handled by the scalar kernels
+
+TARGET_SSE41 static void unorm8_to_float_sse41(uint8_t const* src, float* dst, size_t count) {
+  __m128 const scale = _mm_set1_ps(inv_255);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(bytes)), scale));
+    _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bytes, 4))), scale));
+    _mm_storeu_ps(dst + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bytes, 8))), scale));
+    _mm_storeu_ps(dst + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bytes, 12))), scale));
+  }
+  unorm8_to_float_scalar(src + i, dst + i, count - i);
+}
+
+// clamps like saturate, maxps returns the second operand for NaN
+TARGET_SSE41 static __m128i float_to_unorm_sse41(__m128 value, __m128 scale) {
+  value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+  return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, scale), _mm_set1_ps(0.5f)));
+}
+
+TARGET_SSE41 static void float_to_unorm8_sse41(float const* src, uint8_t* dst, size_t count) {
+  __m128 const scale = _mm_set1_ps(255.0f);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i a = float_to_unorm_sse41(_mm_loadu_ps(src + i), scale);
+    __m128i b = float_to_unorm_sse41(_mm_loadu_ps(src + i + 4), scale);
+    __m128i c = float_to_unorm_sse41(_mm_loadu_ps(src + i + 8), scale);
+    __m128i d = float_to_unorm_sse41(_mm_loadu_ps(src + i + 12), scale);
+    __m128i bytes = _mm_packus_epi16(_mm_packus_epi32(a, b), _mm_packus_epi32(c, d));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), bytes);
+  }
+  float_to_unorm8_scalar(src + i, dst + i, count - i);
+}
+
+// expects one half in the low bits of each lane
+TARGET_SSE41 static __m128 half_to_float_sse41(__m128i half) {
+  __m128i exponent_mantissa = _mm_and_si128(half, _mm_set1_epi32(0x7fff));
+  __m128i sign = _mm_slli_epi32(_mm_xor_si128(half, exponent_mantissa), 16);
+  __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(exponent_mantissa, 13)), _mm_castsi128_ps(_mm_set1_epi32(int(half_magic))));
+  __m128i was_inf_nan = _mm_cmpgt_epi32(exponent_mantissa, _mm_set1_epi32(0x7bff));
+  __m128i inf_nan = _mm_and_si128(was_inf_nan, _mm_set1_epi32(255 << 23));
+  return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, inf_nan)));
+}
+
+TARGET_SSE41 static void half_to_float_sse41(uint16_t const* src, float* dst, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i halves = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+    _mm_storeu_ps(dst + i, half_to_float_sse41(_mm_cvtepu16_epi32(halves)));
+    _mm_storeu_ps(dst + i + 4, half_to_float_sse41(_mm_cvtepu16_epi32(_mm_srli_si128(halves, 8))));
+  }
+  half_to_float_scalar(src + i, dst + i, count - i);
+}
+
+// returns one half in the low bits of each lane
+TARGET_SSE41 static __m128i float_to_half_sse41(__m128 value) {
+  __m128i bits = _mm_castps_si128(value);
+  __m128i sign = _mm_and_si128(bits, _mm_set1_epi32(int(0x80000000u)));
+  __m128i absolute = _mm_xor_si128(bits, sign);
+  __m128i is_nan = _mm_cmpgt_epi32(absolute, _mm_set1_epi32(0x7f800000));
+  __m128i is_regular = _mm_cmpgt_epi32(_mm_set1_epi32(int(half_max)), absolute);
+  __m128i inf_nan = _mm_or_si128(_mm_and_si128(is_nan, _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7c00));
+
+  __m128i is_subnormal = _mm_cmpgt_epi32(_mm_set1_epi32(int(half_min_normal)), absolute);
+  __m128 subnormal_sum = _mm_add_ps(_mm_castsi128_ps(absolute), _mm_castsi128_ps(_mm_set1_epi32(int(half_subnormal_magic))));
+  __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(subnormal_sum), _mm_set1_epi32(int(half_subnormal_magic)));
+
+  // odd mantissas round up on ties
+  __m128i odd = _mm_and_si128(_mm_srli_epi32(absolute, 13), _mm_set1_epi32(1));
+  __m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(absolute, _mm_set1_epi32(int(half_normal_bias))), odd), 13);
+
+  __m128i finite = _mm_blendv_epi8(normal, subnormal, is_subnormal);
+  __m128i half = _mm_blendv_epi8(inf_nan, finite, is_regular);
+  return _mm_or_si128(half, _mm_srli_epi32(sign, 16));
+}
+
+TARGET_SSE41 static void float_to_half_sse41(float const* src, uint16_t* dst, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i a = float_to_half_sse41(_mm_loadu_ps(src + i));
+    __m128i b = float_to_half_sse41(_mm_loadu_ps(src + i + 4));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi32(a, b));
+  }
+  float_to_half_scalar(src + i, dst + i, count - i);
+}
+
+TARGET_SSE41 static void linear_to_srgb8_sse41(float const* src, uint8_t* dst, size_t pixel_count) {
+  SrgbTables const& tables = srgb_tables();
+  __m128 const min_value = _mm_castsi128_ps(_mm_set1_epi32(int(SrgbTables::min_bits)));
+  __m128 const almost_one = _mm_castsi128_ps(_mm_set1_epi32(int(SrgbTables::almost_one_bits)));
+  __m128 const scale_alpha = _mm_set1_ps(255.0f);
+  size_t i = 0;
+  for (; i + 4 <= pixel_count; i += 4) {
+    __m128i results[4];
+    for (size_t p = 0; p < 4; ++p) {
+      __m128 value = _mm_loadu_ps(src + (i + p) * 4);
+      __m128i bits = _mm_castps_si128(_mm_min_ps(_mm_max_ps(value, min_value), almost_one));
+      __m128i bucket = _mm_srli_epi32(_mm_sub_epi32(bits, _mm_set1_epi32(int(SrgbTables::min_bits))), 20);
+      __m128i t = _mm_and_si128(_mm_srli_epi32(bits, 12), _mm_set1_epi32(0xff));
+      // no gather before avx2
+      __m128i bias = _mm_setr_epi32(
+        int(tables.bias[_mm_extract_epi32(bucket, 0)]), int(tables.bias[_mm_extract_epi32(bucket, 1)]),
+        int(tables.bias[_mm_extract_epi32(bucket, 2)]), int(tables.bias[_mm_extract_epi32(bucket, 3)]));
+      __m128i scale = _mm_setr_epi32(
+        int(tables.scale[_mm_extract_epi32(bucket, 0)]), int(tables.scale[_mm_extract_epi32(bucket, 1)]),
+        int(tables.scale[_mm_extract_epi32(bucket, 2)]), int(tables.scale[_mm_extract_epi32(bucket, 3)]));
+      __m128i color = _mm_srli_epi32(_mm_add_epi32(bias, _mm_mullo_epi32(scale, t)), 16);
+      results[p] = _mm_blend_epi16(color, float_to_unorm_sse41(value, scale_alpha), 0xc0);
+    }
+    __m128i bytes = _mm_packus_epi16(_mm_packus_epi32(results[0], results[1]), _mm_packus_epi32(results[2], results[3]));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), bytes);
+  }
+  linear_to_srgb8_scalar(src + i * 4, dst + i * 4, pixel_count - i);
+}
+
+TARGET_SSE41 static void unpack_a2b10g10r10_sse41(uint32_t const* src, float* dst, size_t pixel_count) {
+  // shifting each channel to the top and back keeps the alpha lane scaled by 256,
+  // which the power of two in its scale undoes exactly
+  __m128i const shift = _mm_setr_epi32(1 << 22, 1 << 12, 1 << 2, 1);
+  __m128i const mask = _mm_setr_epi32(0x3ff, 0x3ff, 0x3ff, 0x300);
+  __m128 const scale = _mm_setr_ps(inv_1023, inv_1023, inv_1023, inv_3 / 256.0f);
+  for (size_t i = 0; i < pixel_count; ++i) {
+    __m128i pixel = _mm_set1_epi32(int(src[i]));
+    __m128i channels = _mm_and_si128(_mm_srli_epi32(_mm_mullo_epi32(pixel, shift), 22), mask);
+    _mm_storeu_ps(dst + i * 4, _mm_mul_ps(_mm_cvtepi32_ps(channels), scale));
+  }
+}
+
+TARGET_SSE41 static void pack_a2b10g10r10_sse41(float const* src, uint32_t* dst, size_t pixel_count) {
+  __m128 const scale = _mm_setr_ps(1023.0f, 1023.0f, 1023.0f, 3.0f);
+  __m128i const shift = _mm_setr_epi32(1, 1 << 10, 1 << 20, 1 << 30);
+  size_t i = 0;
+  for (; i + 4 <= pixel_count; i += 4) {
+    __m128i channels[4];
+    for (size_t p = 0; p < 4; ++p) {
+      channels[p] = _mm_mullo_epi32(float_to_unorm_sse41(_mm_loadu_ps(src + (i + p) * 4), scale), shift);
+    }
+    // channel bits do not overlap, so horizontal sums combine them
+    __m128i packed = _mm_hadd_epi32(_mm_hadd_epi32(channels[0], channels[1]), _mm_hadd_epi32(channels[2], channels[3]));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+  }
+  pack_a2b10g10r10_scalar(src + i * 4, dst + i, pixel_count - i);
+}
+
+TARGET_SSE41 static void swizzle_rgba8_sse41(uint8_t const* src, uint8_t* dst, size_t pixel_count, uint8_t const order[4]) {
+  char indices[16];
+  for (int i = 0; i < 16; ++i) {
+    indices[i] = char(i / 4 * 4 + order[i % 4]);
+  }
+  __m128i const shuffle = _mm_loadu_si128(reinterpret_cast<__m128i const*>(indices));
+  size_t i = 0;
+  for (; i + 4 <= pixel_count; i += 4) {
+    __m128i pixels = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i * 4));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_shuffle_epi8(pixels, shuffle));
+  }
+  swizzle_rgba8_scalar(src + i * 4, dst + i * 4, pixel_count - i, order);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// avx2 with f16c
+
+TARGET_AVX2 static void unorm8_to_float_avx2(uint8_t const* src, float* dst, size_t count) {
+  __m256 const scale = _mm256_set1_ps(inv_255);
+  size_t i = 0;
+  for (; i + 32 <= count; i += 32) {
+    for (size_t j = 0; j < 32; j += 8) {
+      __m128i bytes = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(src + i + j));
+      _mm256_storeu_ps(dst + i + j, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes)), scale));
+    }
+  }
+  unorm8_to_float_sse41(src + i, dst + i, count - i);
+}
+
+TARGET_AVX2 static __m256i float_to_unorm_avx2(__m256 value, __m256 scale) {
+  value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+  return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(value, scale), _mm256_set1_ps(0.5f)));
+}
+
+TARGET_AVX2 static void float_to_unorm8_avx2(float const* src, uint8_t* dst, size_t count) {
+  __m256 const scale = _mm256_set1_ps(255.0f);
+  // packs work within 128 bit lanes, the permute restores the order
+  __m256i const order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  size_t i = 0;
+  for (; i + 32 <= count; i += 32) {
+    __m256i a = float_to_unorm_avx2(_mm256_loadu_ps(src + i), scale);
+    __m256i b = float_to_unorm_avx2(_mm256_loadu_ps(src + i + 8), scale);
+    __m256i c = float_to_unorm_avx2(_mm256_loadu_ps(src + i + 16), scale);
+    __m256i d = float_to_unorm_avx2(_mm256_loadu_ps(src + i + 24), scale);
+    __m256i bytes = _mm256_packus_epi16(_mm256_packus_epi32(a, b), _mm256_packus_epi32(c, d));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permutevar8x32_epi32(bytes, order));
+  }
+  float_to_unorm8_sse41(src + i, dst + i, count - i);
+}
+
+TARGET_AVX2 static void half_to_float_avx2(uint16_t const* src, float* dst, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i))));
+  }
+  half_to_float_scalar(src + i, dst + i, count - i);
+}
+
+TARGET_AVX2 static void float_to_half_avx2(float const* src, uint16_t* dst, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i halves = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), halves);
+  }
+  float_to_half_scalar(src + i, dst + i, count - i);
+}
+
+TARGET_AVX2 static void srgb8_to_linear_avx2(uint8_t const* src, float* dst, size_t pixel_count) {
+  SrgbTables const& tables = srgb_tables();
+  __m256 const scale = _mm256_set1_ps(inv_255);
+  size_t i = 0;
+  for (; i + 2 <= pixel_count; i += 2) {
+    __m256i bytes = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(src + i * 4)));
+    __m256 color = _mm256_i32gather_ps(tables.decode, bytes, 4);
+    __m256 alpha = _mm256_mul_ps(_mm256_cvtepi32_ps(bytes), scale);
+    _mm256_storeu_ps(dst + i * 4, _mm256_blend_ps(color, alpha, 0x88));
+  }
+  srgb8_to_linear_scalar(src + i * 4, dst + i * 4, pixel_count - i);
+}
+
+TARGET_AVX2 static void linear_to_srgb8_avx2(float const* src, uint8_t* dst, size_t pixel_count) {
+  SrgbTables const& tables = srgb_tables();
+  __m256 const min_value = _mm256_castsi256_ps(_mm256_set1_epi32(int(SrgbTables::min_bits)));
+  __m256 const almost_one = _mm256_castsi256_ps(_mm256_set1_epi32(int(SrgbTables::almost_one_bits)));
+  __m256 const scale_alpha = _mm256_set1_ps(255.0f);
+  __m256i const order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  size_t i = 0;
+  for (; i + 8 <= pixel_count; i += 8) {
+    __m256i results[4];
+    for (size_t p = 0; p < 4; ++p) {
+      __m256 value = _mm256_loadu_ps(src + (i + p * 2) * 4);
+      __m256i bits = _mm256_castps_si256(_mm256_min_ps(_mm256_max_ps(value, min_value), almost_one));
+      __m256i bucket = _mm256_srli_epi32(_mm256_sub_epi32(bits, _mm256_set1_epi32(int(SrgbTables::min_bits))), 20);
+      __m256i t = _mm256_and_si256(_mm256_srli_epi32(bits, 12), _mm256_set1_epi32(0xff));
+      __m256i bias = _mm256_i32gather_epi32(reinterpret_cast<int const*>(tables.bias), bucket, 4);
+      __m256i scale = _mm256_i32gather_epi32(reinterpret_cast<int const*>(tables.scale), bucket, 4);
+      __m256i color = _mm256_srli_epi32(_mm256_add_epi32(bias, _mm256_mullo_epi32(scale, t)), 16);
+      results[p] = _mm256_blend_epi32(color, float_to_unorm_avx2(value, scale_alpha), 0x88);
+    }
+    __m256i bytes = _mm256_packus_epi16(_mm256_packus_epi32(results[0], results[1]), _mm256_packus_epi32(results[2], results[3]));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_permutevar8x32_epi32(bytes, order));
+  }
+  linear_to_srgb8_sse41(src + i * 4, dst + i * 4, pixel_count - i);
+}
+
+TARGET_AVX2 static void swizzle_rgba8_avx2(uint8_t const* src, uint8_t* dst, size_t pixel_count, uint8_t const order[4]) {
+  char indices[32];
+  for (int i = 0; i < 32; ++i) {
+    indices[i] = char(i % 16 / 4 * 4 + order[i % 4]);
+  }
+  __m256i const shuffle = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(indices));
+  size_t i = 0;
+  for (; i + 8 <= pixel_count; i += 8) {
+    __m256i pixels = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i * 4));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_shuffle_epi8(pixels, shuffle));
+  }
+  swizzle_rgba8_sse41(src + i * 4, dst + i * 4, pixel_count - i, order);
+}
+
+static void cpuid(uint32_t leaf, uint32_t registers[4]) {
+#if defined(_MSC_VER)
+  int values[4] = {0, 0, 0, 0};
+  __cpuidex(values, int(leaf), 0);
+  for (int i = 0; i < 4; ++i) registers[i] = uint32_t(values[i]);
+#else
+  registers[0] = registers[1] = registers[2] = registers[3] = 0;
+  __cpuid_count(leaf, 0, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+// whether the os saves the ymm registers
+static bool avx_enabled() {
+#if defined(_MSC_VER)
+  return (_xgetbv(0) & 0x6) == 0x6;
+#else
+  uint32_t low = 0;
+  uint32_t high = 0;
+  __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+  return (low & 0x6) == 0x6;
+#endif
+}
+#endif
+
+static SimdLevel detect_simd_level() {
+#ifdef PIXEL_CONVERT_X86
+  uint32_t registers[4];
+  cpuid(0, registers);
+  uint32_t max_leaf = registers[0];
+  cpuid(1, registers);
+  bool sse41 = registers[2] & (1u << 19);
+  bool f16c = registers[2] & (1u << 29);
+  bool avx = (registers[2] & (1u << 27)) && (registers[2] & (1u << 28)) && avx_enabled();
+  bool avx2 = false;
+  if (max_leaf >= 7) {
+    cpuid(7, registers);
+    avx2 = registers[1] & (1u << 5);
+  }
+  if (avx && avx2 && f16c) return SimdLevel::eAvx2;
+  if (sse41) return SimdLevel::eSse41;
+#endif
+  return SimdLevel::eScalar;
+}
+
+SimdLevel simd_level() {
+  static SimdLevel const level = detect_simd_level();
+  return level;
+}
+
+char const* simd_level_name(SimdLevel level) {
+  switch (level) {
+    case SimdLevel::eScalar: return "scalar";
+    case SimdLevel::eSse41: return "sse4.1";
+    case SimdLevel::eAvx2: return "avx2";
+  }
+  return "unknown";
+}
+
+size_t pixel_size(PixelFormat format) {
+  switch (format) {
+    case PixelFormat::eRgba8Unorm:
+    case PixelFormat::eBgra8Unorm:
+    case PixelFormat::eRgba8Srgb:
+    case PixelFormat::eBgra8Srgb:
+    case PixelFormat::eA2b10g10r10Unorm:
+      return 4;
+    case PixelFormat::eRgba16Float:
+      return 8;
+    case PixelFormat::eRgba32Float:
+      return 16;
+  }
+  throw std::runtime_error{"Unknown pixel format"};
+}
+
+bool is_srgb(PixelFormat format) {
+  return format == PixelFormat::eRgba8Srgb || format == PixelFormat::eBgra8Srgb;
+}
+
+// the kernels of the levels that are compiled in and supported
+#ifdef PIXEL_CONVERT_X86
+#define DISPATCH(name, ...) \
+  switch (std::min(level, simd_level())) { \
+    case SimdLevel::eAvx2: name##_avx2(__VA_ARGS__); return; \
+    case SimdLevel::eSse41: name##_sse41(__VA_ARGS__); return; \
+    case SimdLevel::eScalar: name##_scalar(__VA_ARGS__); return; \
+  }
+#define DISPATCH_SSE41(name, ...) \
+  if (std::min(level, simd_level()) >= SimdLevel::eSse41) { \
+    name##_sse41(__VA_ARGS__); \
+    return; \
+  } \
+  name##_scalar(__VA_ARGS__);
+#else
+#define DISPATCH(name, ...) (void)level; name##_scalar(__VA_ARGS__);
+#define DISPATCH_SSE41(name, ...) (void)level; name##_scalar(__VA_ARGS__);
+#endif
+
+void unorm8_to_float(uint8_t const* src, float* dst, size_t count, SimdLevel level) {
+  DISPATCH(unorm8_to_float, src, dst, count)
+}
+
+void float_to_unorm8(float const* src, uint8_t* dst, size_t count, SimdLevel level) {
+  DISPATCH(float_to_unorm8, src, dst, count)
+}
+
+void half_to_float(uint16_t const* src, float* dst, size_t count, SimdLevel level) {
+  DISPATCH(half_to_float, src, dst, count)
+}
+
+void float_to_half(float const* src, uint16_t* dst, size_t count, SimdLevel level) {
+  DISPATCH(float_to_half, src, dst, count)
+}
+
+void srgb8_to_linear(uint8_t const* src, float* dst, size_t pixel_count, SimdLevel level) {
+  // table lookups only pay off with gathers
+#ifdef PIXEL_CONVERT_X86
+  if (std::min(level, simd_level()) == SimdLevel::eAvx2) {
+    srgb8_to_linear_avx2(src, dst, pixel_count);
+    return;
+  }
+#endif
+  (void)level;
+  srgb8_to_linear_scalar(src, dst, pixel_count);
+}
+
+void linear_to_srgb8(float const* src, uint8_t* dst, size_t pixel_count, SimdLevel level) {
+  DISPATCH(linear_to_srgb8, src, dst, pixel_count)
+}
+
+void unpack_a2b10g10r10(uint32_t const* src, float* dst, size_t pixel_count, SimdLevel level) {
+  DISPATCH_SSE41(unpack_a2b10g10r10, src, dst, pixel_count)
+}
+
+void pack_a2b10g10r10(float const* src, uint32_t* dst, size_t pixel_count, SimdLevel level) {
+  DISPATCH_SSE41(pack_a2b10g10r10, src, dst, pixel_count)
+}
+
+void swizzle_rgba8(uint8_t const* src, uint8_t* dst, size_t pixel_count, uint8_t const order[4], SimdLevel level) {
+  DISPATCH(swizzle_rgba8, src, dst, pixel_count, order)
+}
+
+static bool is_bgra(PixelFormat format) {
+  return format == PixelFormat::eBgra8Unorm || format == PixelFormat::eBgra8Srgb;
+}
+
+static bool is_8bit(PixelFormat format) {
+  return format != PixelFormat::eRgba16Float && format != PixelFormat::eRgba32Float && format != PixelFormat::eA2b10g10r10Unorm;
+}
+
+static uint8_t const order_bgra[4] = {2, 1, 0, 3};
+
+// bytes holds one row of 8 bit pixels for swizzling
+static void decode_row(PixelFormat format, uint8_t const* src, float* dst, uint8_t* bytes, size_t width, SimdLevel level) {
+  if (is_bgra(format)) {
+    swizzle_rgba8(src, bytes, width, order_bgra, level);
+    src = bytes;
+  }
+  switch (format) {
+    case PixelFormat::eRgba8Unorm:
+    case PixelFormat::eBgra8Unorm:
+      unorm8_to_float(src, dst, width * 4, level);
+      break;
+    case PixelFormat::eRgba8Srgb:
+    case PixelFormat::eBgra8Srgb:
+      srgb8_to_linear(src, dst, width, level);
+      break;
+    case PixelFormat::eRgba16Float:
+      half_to_float(reinterpret_cast<uint16_t const*>(src), dst, width * 4, level);
+      break;
+    case PixelFormat::eRgba32Float:
+      std::memcpy(dst, src, width * 16);
+      break;
+    case PixelFormat::eA2b10g10r10Unorm:
+      unpack_a2b10g10r10(reinterpret_cast<uint32_t const*>(src), dst, width, level);
+      break;
+  }
+}
+
+static void encode_row(PixelFormat format, float const* src, uint8_t* dst, size_t width, SimdLevel level) {
+  switch (format) {
+    case PixelFormat::eRgba8Unorm:
+    case PixelFormat::eBgra8Unorm:
+      float_to_unorm8(src, dst, width * 4, level);
+      break;
+    case PixelFormat::eRgba8Srgb:
+    case PixelFormat::eBgra8Srgb:
+      linear_to_srgb8(src, dst, width, level);
+      break;
+    case PixelFormat::eRgba16Float:
+      float_to_half(src, reinterpret_cast<uint16_t*>(dst), width * 4, level);
+      break;
+    case PixelFormat::eRgba32Float:
+      std::memcpy(dst, src, width * 16);
+      break;
+    case PixelFormat::eA2b10g10r10Unorm:
+      pack_a2b10g10r10(src, reinterpret_cast<uint32_t*>(dst), width, level);
+      break;
+  }
+  // in place, the swizzle is its own inverse
+  if (is_bgra(format)) {
+    swizzle_rgba8(dst, dst, width, order_bgra, level);
+  }
+}
+
+void convert_pixels(PixelFormat src_format, void const* src, size_t src_pitch, PixelFormat dst_format, void* dst, size_t dst_pitch, uint32_t width, uint32_t height, SimdLevel level) {
+  size_t const src_row_size = size_t(width) * pixel_size(src_format);
+  size_t const dst_row_size = size_t(width) * pixel_size(dst_format);
+  if (src_pitch < src_row_size || dst_pitch < dst_row_size) {
+    throw std::runtime_error{"Row pitch is smaller than a row"};
+  }
+  uint8_t const* src_rows = static_cast<uint8_t const*>(src);
+  uint8_t* dst_rows = static_cast<uint8_t*>(dst);
+
+  if (src_format == dst_format) {
+    if (src_pitch == src_row_size && dst_pitch == dst_row_size) {
+      std::memcpy(dst_rows, src_rows, src_row_size * height);
+      return;
+    }
+    for (uint32_t y = 0; y < height; ++y) {
+      std::memcpy(dst_rows + y * dst_pitch, src_rows + y * src_pitch, src_row_size);
+    }
+    return;
+  }
+  // same transfer function, only the channel order differs
+  if (is_8bit(src_format) && is_8bit(dst_format) && is_srgb(src_format) == is_srgb(dst_format)) {
+    for (uint32_t y = 0; y < height; ++y) {
+      swizzle_rgba8(src_rows + y * src_pitch, dst_rows + y * dst_pitch, width, order_bgra, level);
+    }
+    return;
+  }
+
+  std::vector<float> floats(size_t(width) * 4);
+  std::vector<uint8_t> bytes(size_t(width) * 4);
+  for (uint32_t y = 0; y < height; ++y) {
+    decode_row(src_format, src_rows + y * src_pitch, floats.data(), bytes.data(), width, level);
+    encode_row(dst_format, floats.data(), dst_rows + y * dst_pitch, width, level);
+  }
+}
@@ -0,0 +1,342 @@
+#include "primitives.hpp"
+
+#include <algorithm>
+
+// must match ITEMS and RADIX_BITS of shaders/primitives.glsl
+static uint32_t const items_per_invocation = 4;
+static uint32_t const radix_bits = 4;
+// groups in x before spilling into y, below the guaranteed limit of 65535
+static uint32_t const max_groups_x = 32768;
+// enough to fill the device, each group merges its shared bins once
+static uint32_t const histogram_groups = 512;
+// sets per descriptor pool of a batch and the most bindings of a kernel
+static uint32_t const pool_sets = 64;
+static uint32_t const max_bindings = 6;
+
+static std::string kernel_name(Primitives::Kernel kernel) {
+  switch (kernel) {
+    case Primitives::Kernel::eReduce: return "reduce";
+    case Primitives::Kernel::eScan: return "scan";
+    case Primitives::Kernel::eScanAdd: return "scan_add";
+    case Primitives::Kernel::eHistogram: return "histogram";
+    case Primitives::Kernel::eRadixCount: return "radix_count";
+    case Primitives::Kernel::eRadixScatter: return "radix_scatter";
+  }
+  return "";
+}
+
+static uint32_t identity(ScanOp op) {
+  return op == ScanOp::eMin ? 0xffffffffu : 0u;
+}
+
+static uint32_t div_up(uint32_t value, uint32_t divisor) {
+  return (value + divisor - 1) / divisor;
+}
+
+// invocations covering the blocks, in two dimensions if there are too many for one
+static glm::uvec3 block_grid(uint32_t block_count, uint32_t workgroup_size) {
+  uint32_t groups_x = std::min(block_count, max_groups_x);
+  return glm::uvec3{groups_x * workgroup_size, div_up(block_count, groups_x), 1};
+}
+
+Primitives::Primitives(vk::Device const& device, DeviceCapabilities const& capabilities, vk::PipelineCache const& cache, std::string const& shader_dir, bool use_subgroups)
+ :m_device{device}
+ ,m_cache{cache}
+ ,m_shader_dir{shader_dir}
+ ,m_subgroups{false}
+ ,m_workgroup_size{capabilities.max_workgroup_invocations >= 256 ? 256u : 128u}
+ ,m_shaders{}
+ ,m_pipelines{}
+{
+  // the scans assume that subgroups fit into the workgroup
+  m_subgroups = use_subgroups
+    && capabilities.effective_api_version >= VK_API_VERSION_1_1
+    && required_subgroup_operations() != 0
+    && (capabilities.subgroup_operations & required_subgroup_operations()) == required_subgroup_operations()
+    && capabilities.subgroup_size > 0
+    && capabilities.subgroup_size <= m_workgroup_size;
+}
+
+uint32_t Primitives::required_subgroup_operations() {
+#ifdef VK_VERSION_1_1
+  return uint32_t(vk::SubgroupFeatureFlagBits::eBasic | vk::SubgroupFeatureFlagBits::eArithmetic
+    | vk::SubgroupFeatureFlagBits::eBallot | vk::SubgroupFeatureFlagBits::eShuffleRelative);
+#else
+  return 0;
+#endif
+}
+
+Shader const& Primitives::shader(std::string const& name) {
+  auto found = m_shaders.find(name);
+  if (found != m_shaders.end()) return found->second;
+  return m_shaders.emplace(name, load_shader(m_device, m_shader_dir, name)).first->second;
+}
+
+ComputePipeline const& Primitives::pipeline(Kernel kernel, ScanOp op, bool segmented) {
+  std::vector<uint32_t> key{uint32_t(kernel), uint32_t(op), segmented ? 1u : 0u};
+  auto found = m_pipelines.find(key);
+  if (found != m_pipelines.end()) return found->second;
+  PipelineParameters pipeline_parameters = parameters(kernel, op, segmented);
+  ComputePipeline pipeline{m_device, shader(pipeline_parameters.shader), m_cache, pipeline_parameters.workgroup_size, pipeline_parameters.constants, 1};
+  return m_pipelines.emplace(key, std::move(pipeline)).first->second;
+}
+
+PipelineParameters Primitives::parameters(Kernel kernel, ScanOp op, bool segmented) const {
+  // kernels without workgroup scans have a single variant
+  bool variants = kernel != Kernel::eScanAdd && kernel != Kernel::eRadixCount;
+  std::string name = kernel_name(kernel) + (m_subgroups && variants ? "_subgroup" : "");
+  // constant ids of shaders/primitives.glsl, ignored by kernels not using them
+  std::map<uint32_t, uint32_t> constants{{1, uint32_t(op)}, {2, segmented ? 1u : 0u}};
+  return PipelineParameters{name, glm::uvec3{m_workgroup_size, 0, 0}, constants};
+}
+
+std::vector<PipelineParameters> Primitives::pipeline_parameters() const {
+  std::vector<PipelineParameters> pipelines{};
+  for (ScanOp op : {ScanOp::eAdd, ScanOp::eMin, ScanOp::eMax}) {
+    pipelines.push_back(parameters(Kernel::eReduce, op));
+    pipelines.push_back(parameters(Kernel::eScan, op));
+    pipelines.push_back(parameters(Kernel::eScan, op, true));
+    pipelines.push_back(parameters(Kernel::eScanAdd, op));
+  }
+  pipelines.push_back(parameters(Kernel::eHistogram));
+  pipelines.push_back(parameters(Kernel::eRadixCount));
+  pipelines.push_back(parameters(Kernel::eRadixScatter));
+  return pipelines;
+}
+
+vk::Device const& Primitives::device() const {
+  return m_device;
+}
+
+bool Primitives::subgroups() const {
+  return m_subgroups;
+}
+
+uint32_t Primitives::workgroup_size() const {
+  return m_workgroup_size;
+}
+
+uint32_t Primitives::block_size() const {
+  return m_workgroup_size * items_per_invocation;
+}
+
+PrimitiveBatch::Step::Step()
+ :pipeline{nullptr}
+ ,set{}
+ ,constants{}
+ ,block_count{0}
+ ,buffer{}
+ ,buffer_dst{}
+ ,offset{0}
+ ,size{0}
+ ,fill_value{0}
+{}
+
+PrimitiveBatch::PrimitiveBatch(Primitives& primitives, Allocator& allocator, Scheduler* scheduler)
+ :m_primitives{&primitives}
+ ,m_allocator{&allocator}
+ ,m_scheduler{scheduler}
+ ,m_dispatch{&device_dispatch(primitives.device())}
+ ,m_steps{}
+ ,m_allocations{}
+ ,m_buffers{}
+ ,m_pools{}
+ ,m_pool_sets{0}
+{}
+
+void PrimitiveBatch::reduce(vk::Buffer const& input, uint32_t count, vk::Buffer const& output, uint32_t output_index, ScanOp op) {
+  if (count == 0) {
+    fill(output, output_index * sizeof(uint32_t), sizeof(uint32_t), identity(op));
+    return;
+  }
+  ComputePipeline const& pipeline = m_primitives->pipeline(Primitives::Kernel::eReduce, op);
+  // one value per block until a single block remains
+  vk::Buffer src = input;
+  while (true) {
+    uint32_t block_count = div_up(count, m_primitives->block_size());
+    bool last = block_count == 1;
+    vk::Buffer dst = last ? output : scratch(block_count);
+    DescriptorSet set = allocate_set(pipeline);
+    set.write(0, src).write(1, dst);
+    dispatch(pipeline, set, {count, last ? output_index : 0u}, block_count);
+    if (last) break;
+    src = dst;
+    count = block_count;
+  }
+}
+
+void PrimitiveBatch::inclusive_scan(vk::Buffer const& input, vk::Buffer const& output, uint32_t count, ScanOp op) {
+  scan(input, input, output, count, true, op, false);
+}
+
+void PrimitiveBatch::exclusive_scan(vk::Buffer const& input, vk::Buffer const& output, uint32_t count, ScanOp op) {
+  scan(input, input, output, count, false, op, false);
+}
+
+void PrimitiveBatch::segmented_scan(vk::Buffer const& input, vk::Buffer const& flags, vk::Buffer const& output, uint32_t count, bool inclusive, ScanOp op) {
+  scan(input, flags, output, count, inclusive, op, true);
+}
+
+void PrimitiveBatch::scan(vk::Buffer const& input, vk::Buffer const& flags, vk::Buffer const& output, uint32_t count, bool inclusive, ScanOp op, bool segmented) {
+  if (count == 0) return;
+  ComputePipeline const& pipeline = m_primitives->pipeline(Primitives::Kernel::eScan, op, segmented);
+  uint32_t block_count = div_up(count, m_primitives->block_size());
+  vk::Buffer totals = scratch(block_count);
+  vk::Buffer total_flags = scratch(block_count);
+  vk::Buffer first_heads = scratch(block_count);
+  DescriptorSet set = allocate_set(pipeline);
+  set.write(0, input).write(1, flags).write(2, output).write(3, totals).write(4, total_flags).write(5, first_heads);
+  dispatch(pipeline, set, {count, inclusive ? 1u : 0u}, block_count);
+  if (block_count == 1) return;
+
+  // the inclusive scan of the block totals carries into the following blocks,
+  // an exclusive one would drop the carry of blocks starting with a segment
+  scan(totals, total_flags, totals, block_count, true, op, segmented);
+  ComputePipeline const& pipeline_add = m_primitives->pipeline(Primitives::Kernel::eScanAdd, op);
+  DescriptorSet set_add = allocate_set(pipeline_add);
+  set_add.write(0, output).write(1, totals).write(2, first_heads);
+  dispatch(pipeline_add, set_add, {count}, block_count);
+}
+
+void PrimitiveBatch::sort_pairs(vk::Buffer const& keys, vk::Buffer const& values, uint32_t count, uint32_t key_bits) {
+  if (key_bits > 32) {
+    throw std::runtime_error{"Keys have at most 32 bits"};
+  }
+  if (count == 0 || key_bits == 0) return;
+  ComputePipeline const& pipeline_count = m_primitives->pipeline(Primitives::Kernel::eRadixCount);
+  ComputePipeline const& pipeline_scatter = m_primitives->pipeline(Primitives::Kernel::eRadixScatter);
+  // one key per invocation
+  uint32_t block_count = div_up(count, m_primitives->workgroup_size());
+  uint32_t offset_count = (1u << radix_bits) * block_count;
+  vk::Buffer keys_src = keys;
+  vk::Buffer values_src = values;
+  vk::Buffer keys_dst = scratch(count);
+  vk::Buffer values_dst = scratch(count);
+  vk::Buffer offsets = scratch(offset_count);
+  for (uint32_t shift = 0; shift < key_bits; shift += radix_bits) {
+    DescriptorSet set_count = allocate_set(pipeline_count);
+    set_count.write(0, keys_src).write(1, offsets);
+    dispatch(pipeline_count, set_count, {count, shift, block_count}, block_count);
+    scan(offsets, offsets, offsets, offset_count, false, ScanOp::eAdd, false);
+    DescriptorSet set_scatter = allocate_set(pipeline_scatter);
+    set_scatter.write(0, keys_src).write(1, values_src).write(2, keys_dst).write(3, values_dst).write(4, offsets);
+    dispatch(pipeline_scatter, set_scatter, {count, shift, block_count}, block_count);
+    std::swap(keys_src, keys_dst);
+    std::swap(values_src, values_dst);
+  }
+  // an odd number of passes ends in the scratch buffers
+  if (keys_src != keys) {
+    copy(keys_src, keys, count * sizeof(uint32_t));
+    copy(values_src, values, count * sizeof(uint32_t));
+  }
+}
+
+void PrimitiveBatch::histogram(vk::Buffer const& input, uint32_t count, vk::Buffer const& bins, uint32_t bin_count, uint32_t lower, uint32_t bin_width, bool accumulate) {
+  if (bin_count == 0 || bin_width == 0) {
+    throw std::runtime_error{"Histogram needs at least one bin of non-zero width"};
+  }
+  if (!accumulate) {
+    fill(bins, 0, bin_count * sizeof(uint32_t), 0);
+  }
+  if (count == 0) return;
+  ComputePipeline const& pipeline = m_primitives->pipeline(Primitives::Kernel::eHistogram);
+  DescriptorSet set = allocate_set(pipeline);
+  set.write(0, input).write(1, bins);
+  dispatch(pipeline, set, {count, lower, bin_width, bin_count}, std::min(div_up(count, m_primitives->workgroup_size()), histogram_groups));
+}
+
+void PrimitiveBatch::record(vk::CommandBuffer const& command_buffer) const {
+  // each step may depend on any earlier one
+  vk::MemoryBarrier barrier{};
+  barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite;
+  barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite
+    | vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite;
+  vk::PipelineStageFlags stages = vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer;
+  for (size_t i = 0; i < m_steps.size(); ++i) {
+    Step const& step = m_steps[i];
+    if (i > 0) {
+      command_buffer.pipelineBarrier(stages, stages, vk::DependencyFlags{}, barrier, nullptr, nullptr, *m_dispatch);
+    }
+    if (step.pipeline) {
+      step.pipeline->bind(command_buffer, {step.set});
+      step.pipeline->push_constants(command_buffer, step.constants.data(), uint32_t(step.constants.size() * sizeof(uint32_t)));
+      step.pipeline->dispatch(command_buffer, block_grid(step.block_count, step.pipeline->workgroup_size().x));
+    }
+    else if (step.buffer_dst) {
+      vk::BufferCopy region{};
+      region.size = step.size;
+      command_buffer.copyBuffer(step.buffer, step.buffer_dst, region, *m_dispatch);
+    }
+    else {
+      command_buffer.fillBuffer(step.buffer, step.offset, step.size, step.fill_value, *m_dispatch);
+    }
+  }
+}
+
+void PrimitiveBatch::clear() {
+  m_steps.clear();
+  m_buffers.clear();
+  m_allocations.clear();
+  m_pools.clear();
+  m_pool_sets = 0;
+}
+
+size_t PrimitiveBatch::step_count() const {
+  return m_steps.size();
+}
+
+vk::Buffer PrimitiveBatch::scratch(uint32_t count) {
+  vk::Device const& device = m_primitives->device();
+  vk::BufferCreateInfo info_buffer{};
+  info_buffer.size = std::max(count, 1u) * sizeof(uint32_t);
+  info_buffer.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+  Handle<vk::Buffer> buffer{device, device.createBuffer(info_buffer, nullptr, *m_dispatch), m_scheduler};
+  m_allocations.emplace_back(*m_allocator, m_allocator->allocate(buffer.get(), MemoryUsage::eDeviceLocal), m_scheduler);
+  m_buffers.push_back(std::move(buffer));
+  return m_buffers.back().get();
+}
+
+DescriptorSet PrimitiveBatch::allocate_set(ComputePipeline const& pipeline) {
+  if (m_pools.empty() || m_pool_sets == pool_sets) {
+    vk::Device const& device = m_primitives->device();
+    // all kernels only bind storage buffers
+    vk::DescriptorPoolSize pool_size{};
+    pool_size.type = vk::DescriptorType::eStorageBuffer;
+    pool_size.descriptorCount = pool_sets * max_bindings;
+    vk::DescriptorPoolCreateInfo info_pool{};
+    info_pool.maxSets = pool_sets;
+    info_pool.poolSizeCount = 1;
+    info_pool.pPoolSizes = &pool_size;
+    m_pools.emplace_back(device, device.createDescriptorPool(info_pool, nullptr, *m_dispatch), m_scheduler);
+    m_pool_sets = 0;
+  }
+  ++m_pool_sets;
+  return pipeline.allocate_set(m_pools.back().get());
+}
+
+void PrimitiveBatch::dispatch(ComputePipeline const& pipeline, DescriptorSet& set, std::vector<uint32_t> const& constants, uint32_t block_count) {
+  set.update();
+  Step step{};
+  step.pipeline = &pipeline;
+  step.set = set.get();
+  step.constants = constants;
+  step.block_count = block_count;
+  m_steps.push_back(step);
+}
+
+void PrimitiveBatch::fill(vk::Buffer const& buffer, vk::DeviceSize offset, vk::DeviceSize size, uint32_t value) {
+  Step step{};
+  step.buffer = buffer;
+  step.offset = offset;
+  step.size = size;
+  step.fill_value = value;
+  m_steps.push_back(step);
+}
+
+void PrimitiveBatch::copy(vk::Buffer const& src, vk::Buffer const& dst, vk::DeviceSize size) {
+  Step step{};
+  step.buffer = src;
+  step.buffer_dst = dst;
+  step.size = size;
+  m_steps.push_back(step);
+}
@@ -0,0 +1,296 @@
+#include "profiler.hpp"
+
+#include "bring_up.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+// events kept per thread, older ones are overwritten
+static size_t const ring_size = 16384;
+// deeper nesting is counted but not recorded
+static uint32_t const max_depth = 64;
+
+struct ThreadRing {
+  ThreadRing(uint32_t index)
+   :id{index}
+   ,name{}
+   ,events(ring_size)
+   ,count{0}
+   ,open{}
+   ,depth{0}
+  {}
+
+  uint32_t id;
+  std::string name;
+  std::vector<ProfileEvent> events;
+  // written by owning thread only, read with acquire on export
+  std::atomic<uint64_t> count;
+  ProfileEvent open[max_depth];
+  uint32_t depth;
+};
+
+// function statics avoid depending on static initialization order
+static std::mutex& registry_mutex() {
+  static std::mutex mutex{};
+  return mutex;
+}
+
+static std::vector<std::unique_ptr<ThreadRing>>& registry() {
+  static std::vector<std::unique_ptr<ThreadRing>> rings{};
+  return rings;
+}
+
+static std::vector<ProfileEvent>& external_events() {
+  static std::vector<ProfileEvent> events{};
+  return events;
+}
+
+static Profiler::clock::time_point const& epoch() {
+  static Profiler::clock::time_point const start = Profiler::clock::now();
+  return start;
+}
+
+static ThreadRing& thread_ring() {
+  // rings outlive their threads so events can still be exported
+  static thread_local ThreadRing* ring = nullptr;
+  if (!ring) {
+    std::lock_guard<std::mutex> lock{registry_mutex()};
+    registry().emplace_back(new ThreadRing{uint32_t(registry().size())});
+    ring = registry().back().get();
+  }
+  return *ring;
+}
+
+static std::string escape(char const* text) {
+  std::string escaped{};
+  for (; text && *text; ++text) {
+    char c = *text;
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+    }
+    if (c >= 0 && c < 0x20) continue;
+    escaped += c;
+  }
+  return escaped;
+}
+
+void Profiler::begin(char const* name) {
+  ThreadRing& ring = thread_ring();
+  if (ring.depth < max_depth) {
+    ProfileEvent& event = ring.open[ring.depth];
+    event.name = name;
+    event.begin = now();
+    event.end = 0;
+    event.process = 0;
+    event.thread = ring.id;
+  }
+  ++ring.depth;
+}
+
+void Profiler::end() {
+  ThreadRing& ring = thread_ring();
+  if (ring.depth == 0) return;
+  --ring.depth;
+  if (ring.depth >= max_depth) return;
+
+  ProfileEvent event = ring.open[ring.depth];
+  event.end = now();
+  uint64_t index = ring.count.load(std::memory_order_relaxed);
+  ring.events[size_t(index % ring_size)] = event;
+  ring.count.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::set_thread_name(std::string const& name) {
+  ThreadRing& ring = thread_ring();
+  std::lock_guard<std::mutex> lock{registry_mutex()};
+  ring.name = name;
+}
+
+void Profiler::add_events(std::vector<ProfileEvent> const& events) {
+  std::lock_guard<std::mutex> lock{registry_mutex()};
+  external_events().insert(external_events().end(), events.begin(), events.end());
+}
+
+std::vector<ProfileEvent> Profiler::events() {
+  std::vector<ProfileEvent> events{};
+  std::lock_guard<std::mutex> lock{registry_mutex()};
+  for (auto const& ring : registry()) {
+    uint64_t count = ring->count.load(std::memory_order_acquire);
+    uint64_t first = count > ring_size ? count - ring_size : 0;
+    for (uint64_t i = first; i < count; ++i) {
+      events.push_back(ring->events[size_t(i % ring_size)]);
+    }
+  }
+  events.insert(events.end(), external_events().begin(), external_events().end());
+  std::sort(events.begin(), events.end(), [](ProfileEvent const& a, ProfileEvent const& b) {
+    return a.begin < b.begin;
+  });
+  return events;
+}
+
+void Profiler::clear() {
+  std::lock_guard<std::mutex> lock{registry_mutex()};
+  for (auto const& ring : registry()) {
+    ring->count.store(0, std::memory_order_relaxed);
+  }
+  external_events().clear();
+}
+
+void Profiler::write_trace(std::string const& path) {
+  std::vector<ProfileEvent> trace_events = events();
+  std::ofstream file{path, std::ios::trunc};
+  file << std::fixed << std::setprecision(3);
+  file << "{\"traceEvents\":[\n";
+  file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"cpu\"}},\n";
+  file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"gpu\"}}";
+  {
+    std::lock_guard<std::mutex> lock{registry_mutex()};
+    for (auto const& ring : registry()) {
+      if (ring->name.empty()) continue;
+      file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << ring->id
+           << ",\"args\":{\"name\":\"" << escape(ring->name.c_str()) << "\"}}";
+    }
+  }
+  // complete events with microsecond timestamps
+  for (auto const& event : trace_events) {
+    file << ",\n{\"name\":\"" << escape(event.name) << "\",\"ph\":\"X\",\"pid\":" << event.process
+         << ",\"tid\":" << event.thread << ",\"ts\":" << double(event.begin) / 1000.0
+         << ",\"dur\":" << double(event.end - event.begin) / 1000.0 << "}";
+  }
+  file << "\n]}\n";
+  if (!file) {
+    throw std::runtime_error{"Failed to write trace '" + path + "'"};
+  }
+}
+
+uint64_t Profiler::to_ns(clock::time_point const& time) {
+  return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(time - epoch()).count());
+}
+
+uint64_t Profiler::now() {
+  return to_ns(clock::now());
+}
+
+GpuProfiler::GpuProfiler()
+ :m_device{}
+ ,m_dispatch{nullptr}
+ ,m_pool{}
+ ,m_names{}
+ ,m_count{0}
+ ,m_queue_family{0}
+ ,m_period{1.0}
+ ,m_mask{0}
+{}
+
+GpuProfiler::GpuProfiler(vk::Device const& device, vk::PhysicalDevice const& phys_device, uint32_t queue_family, uint32_t max_regions)
+ :GpuProfiler{}
+{
+  m_device = device;
+  m_dispatch = &device_dispatch(device);
+  m_queue_family = queue_family;
+  m_period = double(phys_device.getProperties().limits.timestampPeriod);
+  // families without valid bits do not support timestamps
+  uint32_t valid_bits = phys_device.getQueueFamilyProperties()[queue_family].timestampValidBits;
+  if (valid_bits == 0) return;
+  m_mask = valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+
+  m_names.resize(max_regions, nullptr);
+  vk::QueryPoolCreateInfo info_pool{};
+  info_pool.queryType = vk::QueryType::eTimestamp;
+  info_pool.queryCount = max_regions * 2;
+  m_pool = m_device.createQueryPool(info_pool, nullptr, *m_dispatch);
+}
+
+GpuProfiler::GpuProfiler(GpuProfiler&& rhs)
+ :GpuProfiler{}
+{
+  std::swap(m_device, rhs.m_device);
+  std::swap(m_dispatch, rhs.m_dispatch);
+  std::swap(m_pool, rhs.m_pool);
+  std::swap(m_names, rhs.m_names);
+  m_count = rhs.m_count.exchange(m_count.load());
+  std::swap(m_queue_family, rhs.m_queue_family);
+  std::swap(m_period, rhs.m_period);
+  std::swap(m_mask, rhs.m_mask);
+}
+
+GpuProfiler& GpuProfiler::operator=(GpuProfiler&& rhs) {
+  cleanup();
+  std::swap(m_device, rhs.m_device);
+  std::swap(m_dispatch, rhs.m_dispatch);
+  std::swap(m_pool, rhs.m_pool);
+  std::swap(m_names, rhs.m_names);
+  m_count = rhs.m_count.exchange(m_count.load());
+  std::swap(m_queue_family, rhs.m_queue_family);
+  std::swap(m_period, rhs.m_period);
+  std::swap(m_mask, rhs.m_mask);
+  return *this;
+}
+
+GpuProfiler::~GpuProfiler() {
+  cleanup();
+}
+
+void GpuProfiler::cleanup() {
+  if (m_pool) {
+    m_device.destroyQueryPool(m_pool, nullptr, *m_dispatch);
+    m_pool = vk::QueryPool{};
+  }
+  m_names.clear();
+  m_count = 0;
+}
+
+void GpuProfiler::reset(vk::CommandBuffer const& command_buffer) {
+  if (!m_pool) return;
+  command_buffer.resetQueryPool(m_pool, 0, uint32_t(m_names.size() * 2), *m_dispatch);
+  m_count = 0;
+}
+
+uint32_t GpuProfiler::begin(vk::CommandBuffer const& command_buffer, char const* name, vk::PipelineStageFlagBits stage) {
+  uint32_t region = m_count++;
+  if (!m_pool || region >= m_names.size()) return region;
+  m_names[region] = name;
+  command_buffer.writeTimestamp(stage, m_pool, region * 2, *m_dispatch);
+  return region;
+}
+
+void GpuProfiler::end(vk::CommandBuffer const& command_buffer, uint32_t region, vk::PipelineStageFlagBits stage) {
+  if (!m_pool || region >= m_names.size()) return;
+  command_buffer.writeTimestamp(stage, m_pool, region * 2 + 1, *m_dispatch);
+}
+
+void GpuProfiler::collect(Profiler::clock::time_point const& submit_time) {
+  uint32_t count = std::min(m_count.load(), uint32_t(m_names.size()));
+  if (!m_pool || count == 0) return;
+
+  std::vector<uint64_t> timestamps(count * 2);
+  vk::Result result = m_device.getQueryPoolResults(m_pool, 0, count * 2, timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait, *m_dispatch);
+  if (result != vk::Result::eSuccess) {
+    throw std::runtime_error{"Failed to read timestamp queries"};
+  }
+  uint64_t first = timestamps[0];
+  for (uint32_t i = 0; i < count; ++i) {
+    // earliest begin, masking handles counter wrap
+    if (((timestamps[i * 2] - first) & m_mask) > (m_mask >> 1)) {
+      first = timestamps[i * 2];
+    }
+  }
+  // ticks are scaled by timestampPeriod to ns
+  uint64_t base = Profiler::to_ns(submit_time);
+  std::vector<ProfileEvent> events(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    events[i].name = m_names[i];
+    events[i].begin = base + uint64_t(double((timestamps[i * 2] - first) & m_mask) * m_period);
+    events[i].end = base + uint64_t(double((timestamps[i * 2 + 1] - first) & m_mask) * m_period);
+    events[i].process = 1;
+    events[i].thread = m_queue_family;
+  }
+  Profiler::add_events(events);
+}
+
+bool GpuProfiler::supported() const {
+  return bool(m_pool);
+}
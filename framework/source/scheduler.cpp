@@ -0,0 +1,265 @@
+#include "scheduler.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+static double milliseconds(std::chrono::steady_clock::duration const& duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+Scheduler::Scheduler()
+ :m_device{}
+ ,m_dispatch{nullptr}
+ ,m_queue{}
+ ,m_frames{}
+ ,m_frame_index{0}
+ ,m_timings{}
+ ,m_deletions{}
+{}
+
+Scheduler::Scheduler(vk::Device const& device, uint32_t queue_family, vk::Queue const& queue, uint32_t frame_count, uint32_t thread_count)
+ :m_device{device}
+ ,m_dispatch{&device_dispatch(device)}
+ ,m_queue{queue}
+ ,m_frames(frame_count)
+ ,m_frame_index{0}
+ ,m_timings{}
+ ,m_deletions{}
+{
+  vk::CommandPoolCreateInfo info_command_pool{};
+  info_command_pool.queueFamilyIndex = queue_family;
+  // buffers are only reset together with their pool
+  info_command_pool.flags = vk::CommandPoolCreateFlagBits::eTransient;
+
+  for (auto& frame : m_frames) {
+    frame.fence = m_device.createFence(vk::FenceCreateInfo{}, nullptr, *m_dispatch);
+    frame.pools.resize(thread_count);
+    for (auto& pool : frame.pools) {
+      pool.pool = m_device.createCommandPool(info_command_pool, nullptr, *m_dispatch);
+      pool.used = 0;
+    }
+    frame.index = 0;
+    frame.pending = false;
+  }
+}
+
+Scheduler::Scheduler(Scheduler&& rhs)
+ :Scheduler{}
+{
+  std::swap(m_device, rhs.m_device);
+  std::swap(m_dispatch, rhs.m_dispatch);
+  std::swap(m_queue, rhs.m_queue);
+  std::swap(m_frames, rhs.m_frames);
+  std::swap(m_frame_index, rhs.m_frame_index);
+  std::swap(m_timings, rhs.m_timings);
+  std::swap(m_deletions, rhs.m_deletions);
+}
+
+Scheduler& Scheduler::operator=(Scheduler&& rhs) {
+  cleanup();
+  std::swap(m_device, rhs.m_device);
+  std::swap(m_dispatch, rhs.m_dispatch);
+  std::swap(m_queue, rhs.m_queue);
+  std::swap(m_frames, rhs.m_frames);
+  std::swap(m_frame_index, rhs.m_frame_index);
+  std::swap(m_timings, rhs.m_timings);
+  std::swap(m_deletions, rhs.m_deletions);
+  return *this;
+}
+
+Scheduler::~Scheduler() {
+  cleanup();
+}
+
+void Scheduler::cleanup() {
+  for (auto& frame : m_frames) {
+    retire(frame, true);
+  }
+  // objects may still be referenced by unsubmitted jobs, which are never executed
+  m_deletions.flush();
+  for (auto& frame : m_frames) {
+    m_device.destroyFence(frame.fence, nullptr, *m_dispatch);
+    for (auto& pool : frame.pools) {
+      m_device.destroyCommandPool(pool.pool, nullptr, *m_dispatch);
+    }
+    for (auto& semaphore : frame.semaphores) {
+      if (semaphore) {
+        m_device.destroySemaphore(semaphore, nullptr, *m_dispatch);
+      }
+    }
+  }
+  m_frames.clear();
+}
+
+void Scheduler::begin_frame() {
+  // collect finished frames without blocking for more accurate latencies
+  for (auto& frame : m_frames) {
+    retire(frame, false);
+  }
+  retire(m_frames[m_frame_index % m_frames.size()], true);
+  m_deletions.retire(completed_frames());
+}
+
+uint32_t Scheduler::begin_job(uint32_t thread) {
+  Frame& frame = m_frames[m_frame_index % m_frames.size()];
+  // pool is only accessed by its own thread
+  ThreadPool& pool = frame.pools[thread];
+  if (pool.used == pool.command_buffers.size()) {
+    vk::CommandBufferAllocateInfo info_command_buffer{};
+    info_command_buffer.commandPool = pool.pool;
+    info_command_buffer.level = vk::CommandBufferLevel::ePrimary;
+    info_command_buffer.commandBufferCount = 1;
+    pool.command_buffers.push_back(m_device.allocateCommandBuffers(info_command_buffer, *m_dispatch).front());
+  }
+  vk::CommandBuffer command_buffer = pool.command_buffers[pool.used++];
+
+  vk::CommandBufferBeginInfo info_cb_begin{};
+  info_cb_begin.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+  command_buffer.begin(info_cb_begin, *m_dispatch);
+
+  Job job{};
+  job.command_buffer = command_buffer;
+  job.record_begin = clock::now();
+  job.record_ms = 0.0;
+
+  std::lock_guard<std::mutex> lock{m_mutex};
+  frame.jobs.push_back(job);
+  return uint32_t(frame.jobs.size() - 1);
+}
+
+vk::CommandBuffer Scheduler::command_buffer(uint32_t job) const {
+  std::lock_guard<std::mutex> lock{m_mutex};
+  return m_frames[m_frame_index % m_frames.size()].jobs[job].command_buffer;
+}
+
+void Scheduler::end_job(uint32_t job, std::vector<uint32_t> const& dependencies, vk::PipelineStageFlags const& wait_stages) {
+  // earlier jobs are submitted first, which rules out cycles
+  for (auto dependency : dependencies) {
+    if (dependency >= job) {
+      throw std::runtime_error{"Job " + std::to_string(job) + " depends on job " + std::to_string(dependency) + " which was not begun before it"};
+    }
+  }
+  vk::CommandBuffer command_buffer = this->command_buffer(job);
+  command_buffer.end(*m_dispatch);
+  clock::time_point record_end = clock::now();
+
+  std::lock_guard<std::mutex> lock{m_mutex};
+  Job& entry = m_frames[m_frame_index % m_frames.size()].jobs[job];
+  entry.dependencies = dependencies;
+  entry.wait_stages = wait_stages;
+  entry.record_ms = milliseconds(record_end - entry.record_begin);
+}
+
+void Scheduler::end_frame() {
+  PROFILE_SCOPE("submit frame");
+  Frame& frame = m_frames[m_frame_index % m_frames.size()];
+  {
+    // deferred deletions read the index from other threads
+    std::lock_guard<std::mutex> lock{m_mutex};
+    ++m_frame_index;
+  }
+  if (frame.jobs.empty()) return;
+
+  // one semaphore per edge, signalled by the dependency and waited on by the dependent
+  size_t edge_count = 0;
+  for (auto const& job : frame.jobs) {
+    edge_count += job.dependencies.size();
+  }
+  while (frame.semaphores.size() < edge_count) {
+    frame.semaphores.push_back(m_device.createSemaphore(vk::SemaphoreCreateInfo{}, nullptr, *m_dispatch));
+  }
+  // wait and signal arrays must outlive the submission
+  std::vector<std::vector<vk::Semaphore>> waits(frame.jobs.size());
+  std::vector<std::vector<vk::PipelineStageFlags>> wait_stages(frame.jobs.size());
+  std::vector<std::vector<vk::Semaphore>> signals(frame.jobs.size());
+  size_t edge = 0;
+  for (size_t i = 0; i < frame.jobs.size(); ++i) {
+    Job const& job = frame.jobs[i];
+    for (auto dependency : job.dependencies) {
+      vk::Semaphore const& semaphore = frame.semaphores[edge++];
+      signals[dependency].push_back(semaphore);
+      waits[i].push_back(semaphore);
+      wait_stages[i].push_back(job.wait_stages);
+    }
+  }
+  std::vector<vk::SubmitInfo> infos_submit(frame.jobs.size());
+  for (size_t i = 0; i < frame.jobs.size(); ++i) {
+    infos_submit[i].commandBufferCount = 1;
+    infos_submit[i].pCommandBuffers = &frame.jobs[i].command_buffer;
+    infos_submit[i].waitSemaphoreCount = uint32_t(waits[i].size());
+    infos_submit[i].pWaitSemaphores = waits[i].data();
+    infos_submit[i].pWaitDstStageMask = wait_stages[i].data();
+    infos_submit[i].signalSemaphoreCount = uint32_t(signals[i].size());
+    infos_submit[i].pSignalSemaphores = signals[i].data();
+  }
+  m_queue.submit(infos_submit, frame.fence, *m_dispatch);
+  frame.submit_time = clock::now();
+  frame.index = m_frame_index - 1;
+  frame.pending = true;
+}
+
+void Scheduler::wait_idle() {
+  for (auto& frame : m_frames) {
+    retire(frame, true);
+  }
+  m_deletions.retire(completed_frames());
+}
+
+void Scheduler::defer(std::function<void()> const& deleter) {
+  std::lock_guard<std::mutex> lock{m_mutex};
+  m_deletions.push(m_frame_index, deleter);
+}
+
+std::vector<Scheduler::Timing> Scheduler::take_timings() {
+  std::vector<Timing> timings{};
+  std::swap(timings, m_timings);
+  return timings;
+}
+
+uint64_t Scheduler::frame_index() const {
+  return m_frame_index;
+}
+
+uint64_t Scheduler::completed_frames() const {
+  // fences of one queue signal in submission order, so the oldest pending frame bounds completion
+  uint64_t completed = m_frame_index;
+  for (auto const& frame : m_frames) {
+    if (frame.pending) {
+      completed = std::min(completed, frame.index);
+    }
+  }
+  return completed;
+}
+
+bool Scheduler::retire(Frame& frame, bool wait) {
+  if (!frame.pending) return true;
+  if (wait) {
+    if (m_device.waitForFences(frame.fence, VK_TRUE, UINT64_MAX, *m_dispatch) != vk::Result::eSuccess) {
+      throw std::runtime_error{"Failed to wait for frame"};
+    }
+  }
+  else if (m_device.getFenceStatus(frame.fence, *m_dispatch) == vk::Result::eNotReady) {
+    return false;
+  }
+  double latency_ms = milliseconds(clock::now() - frame.submit_time);
+  for (size_t i = 0; i < frame.jobs.size(); ++i) {
+    Timing timing{};
+    timing.frame = frame.index;
+    timing.job = uint32_t(i);
+    timing.record_ms = frame.jobs[i].record_ms;
+    timing.latency_ms = latency_ms;
+    m_timings.push_back(timing);
+  }
+  // recycle all command buffers of the frame at once
+  for (auto& pool : frame.pools) {
+    m_device.resetCommandPool(pool.pool, vk::CommandPoolResetFlags{}, *m_dispatch);
+    pool.used = 0;
+  }
+  frame.jobs.clear();
+  m_device.resetFences(frame.fence, *m_dispatch);
+  frame.pending = false;
+  return true;
+}
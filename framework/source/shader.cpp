@@ -0,0 +1,372 @@
+#include "shader.hpp"
+
+#include "bring_up.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <map>
+
+// subset of the SPIR-V specification needed for reflection
+namespace spv {
+  static uint32_t const magic = 0x07230203;
+
+  enum Op {
+    OpEntryPoint = 15,
+    OpExecutionMode = 16,
+    OpTypeInt = 21,
+    OpTypeFloat = 22,
+    OpTypeVector = 23,
+    OpTypeMatrix = 24,
+    OpTypeImage = 25,
+    OpTypeSampler = 26,
+    OpTypeSampledImage = 27,
+    OpTypeArray = 28,
+    OpTypeRuntimeArray = 29,
+    OpTypeStruct = 30,
+    OpTypePointer = 32,
+    OpConstant = 43,
+    OpSpecConstant = 50,
+    OpSpecConstantComposite = 51,
+    OpVariable = 59,
+    OpDecorate = 71,
+    OpMemberDecorate = 72
+  };
+
+  enum Decoration {
+    SpecId = 1,
+    BufferBlock = 3,
+    ArrayStride = 6,
+    BuiltIn = 11,
+    Binding = 33,
+    DescriptorSet = 34,
+    Offset = 35
+  };
+
+  static uint32_t const BuiltInWorkgroupSize = 25;
+  static uint32_t const ExecutionModeLocalSize = 17;
+  enum ExecutionModel {
+    ExecutionModelVertex = 0,
+    ExecutionModelTessellationControl = 1,
+    ExecutionModelTessellationEvaluation = 2,
+    ExecutionModelGeometry = 3,
+    ExecutionModelFragment = 4,
+    ExecutionModelGLCompute = 5
+  };
+
+  enum StorageClass {
+    UniformConstant = 0,
+    Uniform = 2,
+    PushConstant = 9,
+    StorageBuffer = 12
+  };
+
+  static uint32_t const DimBuffer = 5;
+  static uint32_t const DimSubpassData = 6;
+}
+
+// stage executing an entry point of the given model
+static vk::ShaderStageFlagBits execution_stage(uint32_t model) {
+  switch (model) {
+    case spv::ExecutionModelVertex:
+      return vk::ShaderStageFlagBits::eVertex;
+    case spv::ExecutionModelTessellationControl:
+      return vk::ShaderStageFlagBits::eTessellationControl;
+    case spv::ExecutionModelTessellationEvaluation:
+      return vk::ShaderStageFlagBits::eTessellationEvaluation;
+    case spv::ExecutionModelGeometry:
+      return vk::ShaderStageFlagBits::eGeometry;
+    case spv::ExecutionModelFragment:
+      return vk::ShaderStageFlagBits::eFragment;
+    case spv::ExecutionModelGLCompute:
+      return vk::ShaderStageFlagBits::eCompute;
+    default:
+      throw std::runtime_error{"Unsupported SPIR-V execution model " + std::to_string(model)};
+  }
+}
+
+Shader::Shader()
+ :m_device{}
+ ,m_dispatch{nullptr}
+ ,m_module{}
+ ,m_stage{vk::ShaderStageFlagBits::eCompute}
+ ,m_entry_point{}
+ ,m_code{}
+ ,m_bindings{}
+ ,m_push_constant_size{0}
+ ,m_local_size{1}
+ ,m_local_size_ids{-1}
+{}
+
+Shader::Shader(vk::Device const& device, std::string const& path)
+ :Shader{device, load(path)}
+{}
+
+Shader::Shader(vk::Device const& device, std::vector<uint32_t> const& code)
+ :Shader{}
+{
+  m_device = device;
+  m_dispatch = &device_dispatch(device);
+  m_code = code;
+  if (m_code.size() < 5 || m_code[0] != spv::magic) {
+    throw std::runtime_error{"Invalid SPIR-V"};
+  }
+  reflect();
+
+  vk::ShaderModuleCreateInfo info_module{};
+  info_module.codeSize = m_code.size() * sizeof(uint32_t);
+  info_module.pCode = m_code.data();
+  m_module = m_device.createShaderModule(info_module, nullptr, *m_dispatch);
+}
+
+Shader::Shader(Shader&& rhs)
+ :Shader{}
+{
+  std::swap(m_device, rhs.m_device);
+  std::swap(m_dispatch, rhs.m_dispatch);
+  std::swap(m_module, rhs.m_module);
+  std::swap(m_stage, rhs.m_stage);
+  std::swap(m_entry_point, rhs.m_entry_point);
+  std::swap(m_code, rhs.m_code);
+  std::swap(m_bindings, rhs.m_bindings);
+  std::swap(m_push_constant_size, rhs.m_push_constant_size);
+  std::swap(m_local_size, rhs.m_local_size);
+  std::swap(m_local_size_ids, rhs.m_local_size_ids);
+}
+
+Shader& Shader::operator=(Shader&& rhs) {
+  cleanup();
+  std::swap(m_device, rhs.m_device);
+  std::swap(m_dispatch, rhs.m_dispatch);
+  std::swap(m_module, rhs.m_module);
+  std::swap(m_stage, rhs.m_stage);
+  std::swap(m_entry_point, rhs.m_entry_point);
+  std::swap(m_code, rhs.m_code);
+  std::swap(m_bindings, rhs.m_bindings);
+  std::swap(m_push_constant_size, rhs.m_push_constant_size);
+  std::swap(m_local_size, rhs.m_local_size);
+  std::swap(m_local_size_ids, rhs.m_local_size_ids);
+  return *this;
+}
+
+Shader::~Shader() {
+  cleanup();
+}
+
+void Shader::cleanup() {
+  if (m_module) {
+    m_device.destroyShaderModule(m_module, nullptr, *m_dispatch);
+    m_module = vk::ShaderModule{};
+  }
+}
+
+std::vector<uint32_t> Shader::load(std::string const& path) {
+  std::ifstream file{path, std::ios::binary | std::ios::ate};
+  if (!file) {
+    throw std::runtime_error{"Failed to open shader '" + path + "'"};
+  }
+  std::streamsize size = file.tellg();
+  if (size % 4 != 0) {
+    throw std::runtime_error{"Shader '" + path + "' is not SPIR-V"};
+  }
+  std::vector<uint32_t> code(size_t(size / 4));
+  file.seekg(0);
+  file.read(reinterpret_cast<char*>(code.data()), size);
+  return code;
+}
+
+vk::ShaderModule const& Shader::module() const {
+  return m_module;
+}
+
+vk::ShaderStageFlagBits Shader::stage() const {
+  return m_stage;
+}
+
+std::string const& Shader::entry_point() const {
+  return m_entry_point;
+}
+
+std::vector<uint32_t> const& Shader::code() const {
+  return m_code;
+}
+
+std::vector<ShaderBinding> const& Shader::bindings() const {
+  return m_bindings;
+}
+
+uint32_t Shader::push_constant_size() const {
+  return m_push_constant_size;
+}
+
+glm::uvec3 const& Shader::local_size() const {
+  return m_local_size;
+}
+
+glm::ivec3 const& Shader::local_size_ids() const {
+  return m_local_size_ids;
+}
+
+void Shader::reflect() {
+  // instructions defining an id, indexed by result id
+  std::map<uint32_t, std::vector<uint32_t>> types{};
+  std::map<uint32_t, std::vector<uint32_t>> constants{};
+  std::map<uint32_t, std::vector<uint32_t>> variables{};
+  std::map<uint32_t, std::map<uint32_t, uint32_t>> decorations{};
+  std::map<uint32_t, std::map<uint32_t, uint32_t>> member_offsets{};
+  uint32_t workgroup_size_id = 0;
+
+  for (size_t i = 5; i < m_code.size();) {
+    uint32_t opcode = m_code[i] & 0xFFFF;
+    uint32_t word_count = m_code[i] >> 16;
+    if (word_count == 0 || i + word_count > m_code.size()) {
+      throw std::runtime_error{"Malformed SPIR-V"};
+    }
+    std::vector<uint32_t> words(m_code.begin() + long(i), m_code.begin() + long(i + word_count));
+    switch (opcode) {
+      case spv::OpEntryPoint:
+        // the first entry point is used
+        if (m_entry_point.empty()) {
+          m_stage = execution_stage(words[1]);
+          m_entry_point = reinterpret_cast<char const*>(&words[3]);
+        }
+        break;
+      case spv::OpExecutionMode:
+        if (words[2] == spv::ExecutionModeLocalSize) {
+          m_local_size = glm::uvec3{words[3], words[4], words[5]};
+        }
+        break;
+      case spv::OpDecorate:
+        decorations[words[1]][words[2]] = word_count > 3 ? words[3] : 1;
+        if (words[2] == spv::BuiltIn && words[3] == spv::BuiltInWorkgroupSize) {
+          workgroup_size_id = words[1];
+        }
+        break;
+      case spv::OpMemberDecorate:
+        if (words[3] == spv::Offset) {
+          member_offsets[words[1]][words[2]] = words[4];
+        }
+        break;
+      case spv::OpTypeInt:
+      case spv::OpTypeFloat:
+      case spv::OpTypeVector:
+      case spv::OpTypeMatrix:
+      case spv::OpTypeImage:
+      case spv::OpTypeSampler:
+      case spv::OpTypeSampledImage:
+      case spv::OpTypeArray:
+      case spv::OpTypeRuntimeArray:
+      case spv::OpTypeStruct:
+      case spv::OpTypePointer:
+        types[words[1]] = words;
+        break;
+      case spv::OpConstant:
+      case spv::OpSpecConstant:
+      case spv::OpSpecConstantComposite:
+        constants[words[2]] = words;
+        break;
+      case spv::OpVariable:
+        variables[words[2]] = words;
+        break;
+      default:
+        break;
+    }
+    i += word_count;
+  }
+
+  // size of a type in bytes, following explicit offsets and strides
+  std::function<uint32_t(uint32_t)> type_size = [&](uint32_t id) -> uint32_t {
+    std::vector<uint32_t> const& type = types.at(id);
+    switch (type[0] & 0xFFFF) {
+      case spv::OpTypeInt:
+      case spv::OpTypeFloat:
+        return type[2] / 8;
+      case spv::OpTypeVector:
+      case spv::OpTypeMatrix:
+        return type[3] * type_size(type[2]);
+      case spv::OpTypeArray: {
+        uint32_t length = constants.at(type[3])[3];
+        auto stride = decorations[id].find(spv::ArrayStride);
+        return length * (stride != decorations[id].end() ? stride->second : type_size(type[2]));
+      }
+      case spv::OpTypeStruct: {
+        uint32_t size = 0;
+        for (uint32_t m = 2; m < type.size(); ++m) {
+          size = std::max(size, member_offsets[id][m - 2] + type_size(type[m]));
+        }
+        return size;
+      }
+      default:
+        return 0;
+    }
+  };
+
+  for (auto const& variable : variables) {
+    uint32_t storage = variable.second[3];
+    std::vector<uint32_t> const& pointer = types.at(variable.second[1]);
+    uint32_t type_id = pointer[3];
+
+    if (storage == spv::PushConstant) {
+      m_push_constant_size = std::max(m_push_constant_size, type_size(type_id));
+      continue;
+    }
+    if (storage != spv::UniformConstant && storage != spv::Uniform && storage != spv::StorageBuffer) {
+      continue;
+    }
+    ShaderBinding binding{};
+    binding.set = decorations[variable.first][spv::DescriptorSet];
+    binding.binding = decorations[variable.first][spv::Binding];
+    binding.count = 1;
+    // strip arrays of descriptors
+    while ((types.at(type_id)[0] & 0xFFFF) == spv::OpTypeArray || (types.at(type_id)[0] & 0xFFFF) == spv::OpTypeRuntimeArray) {
+      std::vector<uint32_t> const& array = types.at(type_id);
+      if ((array[0] & 0xFFFF) == spv::OpTypeArray) {
+        binding.count *= constants.at(array[3])[3];
+      }
+      type_id = array[2];
+    }
+    std::vector<uint32_t> const& type = types.at(type_id);
+    switch (type[0] & 0xFFFF) {
+      case spv::OpTypeSampler:
+        binding.type = vk::DescriptorType::eSampler;
+        break;
+      case spv::OpTypeSampledImage:
+        binding.type = types.at(type[2])[3] == spv::DimBuffer ? vk::DescriptorType::eUniformTexelBuffer : vk::DescriptorType::eCombinedImageSampler;
+        break;
+      case spv::OpTypeImage:
+        if (type[3] == spv::DimBuffer) {
+          binding.type = type[7] == 2 ? vk::DescriptorType::eStorageTexelBuffer : vk::DescriptorType::eUniformTexelBuffer;
+        }
+        else if (type[3] == spv::DimSubpassData) {
+          binding.type = vk::DescriptorType::eInputAttachment;
+        }
+        else {
+          binding.type = type[7] == 2 ? vk::DescriptorType::eStorageImage : vk::DescriptorType::eSampledImage;
+        }
+        break;
+      case spv::OpTypeStruct:
+        if (storage == spv::StorageBuffer || decorations[type_id].count(spv::BufferBlock)) {
+          binding.type = vk::DescriptorType::eStorageBuffer;
+        }
+        else {
+          binding.type = vk::DescriptorType::eUniformBuffer;
+        }
+        break;
+      default:
+        continue;
+    }
+    m_bindings.push_back(binding);
+  }
+
+  // workgroup size given by specialization constants
+  if (workgroup_size_id != 0 && constants.count(workgroup_size_id)) {
+    std::vector<uint32_t> const& composite = constants.at(workgroup_size_id);
+    for (uint32_t c = 0; c < 3; ++c) {
+      std::vector<uint32_t> const& component = constants.at(composite[3 + c]);
+      m_local_size[c] = component[3];
+      if ((component[0] & 0xFFFF) == spv::OpSpecConstant && decorations[composite[3 + c]].count(spv::SpecId)) {
+        m_local_size_ids[c] = int(decorations[composite[3 + c]][spv::SpecId]);
+      }
+    }
+  }
+}
@@ -0,0 +1,507 @@
+#include "task_graph.hpp"
+
+#include <algorithm>
+
+struct UsageInfo {
+  vk::PipelineStageFlags stages;
+  vk::AccessFlags access;
+  vk::ImageLayout layout;
+  bool write;
+};
+
+static UsageInfo usage_info(ResourceUsage usage) {
+  UsageInfo info{};
+  info.layout = vk::ImageLayout::eGeneral;
+  info.write = false;
+  switch (usage) {
+    case ResourceUsage::eStorageRead:
+      info.stages = vk::PipelineStageFlagBits::eComputeShader;
+      info.access = vk::AccessFlagBits::eShaderRead;
+      break;
+    case ResourceUsage::eStorageWrite:
+      info.stages = vk::PipelineStageFlagBits::eComputeShader;
+      info.access = vk::AccessFlagBits::eShaderWrite;
+      info.write = true;
+      break;
+    case ResourceUsage::eStorageReadWrite:
+      info.stages = vk::PipelineStageFlagBits::eComputeShader;
+      info.access = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+      info.write = true;
+      break;
+    case ResourceUsage::eSampled:
+      info.stages = vk::PipelineStageFlagBits::eComputeShader;
+      info.access = vk::AccessFlagBits::eShaderRead;
+      info.layout = vk::ImageLayout::eShaderReadOnlyOptimal;
+      break;
+    case ResourceUsage::eUniform:
+      info.stages = vk::PipelineStageFlagBits::eComputeShader;
+      info.access = vk::AccessFlagBits::eUniformRead;
+      break;
+    case ResourceUsage::eIndirect:
+      info.stages = vk::PipelineStageFlagBits::eDrawIndirect;
+      info.access = vk::AccessFlagBits::eIndirectCommandRead;
+      break;
+    case ResourceUsage::eTransferSrc:
+      info.stages = vk::PipelineStageFlagBits::eTransfer;
+      info.access = vk::AccessFlagBits::eTransferRead;
+      info.layout = vk::ImageLayout::eTransferSrcOptimal;
+      break;
+    case ResourceUsage::eTransferDst:
+      info.stages = vk::PipelineStageFlagBits::eTransfer;
+      info.access = vk::AccessFlagBits::eTransferWrite;
+      info.layout = vk::ImageLayout::eTransferDstOptimal;
+      info.write = true;
+      break;
+    case ResourceUsage::eHostRead:
+      info.stages = vk::PipelineStageFlagBits::eHost;
+      info.access = vk::AccessFlagBits::eHostRead;
+      break;
+  }
+  return info;
+}
+
+// aspects of all data in an image of the format, barriers cover every aspect
+static vk::ImageAspectFlags aspect_mask(vk::Format format) {
+  switch (format) {
+    case vk::Format::eD16Unorm:
+    case vk::Format::eX8D24UnormPack32:
+    case vk::Format::eD32Sfloat:
+      return vk::ImageAspectFlagBits::eDepth;
+    case vk::Format::eS8Uint:
+      return vk::ImageAspectFlagBits::eStencil;
+    case vk::Format::eD16UnormS8Uint:
+    case vk::Format::eD24UnormS8Uint:
+    case vk::Format::eD32SfloatS8Uint:
+      return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+    default:
+      return vk::ImageAspectFlagBits::eColor;
+  }
+}
+
+static vk::ImageViewType view_type(vk::ImageType type) {
+  switch (type) {
+    case vk::ImageType::e1D: return vk::ImageViewType::e1D;
+    case vk::ImageType::e3D: return vk::ImageViewType::e3D;
+    default: return vk::ImageViewType::e2D;
+  }
+}
+
+TaskGraph::Statistics::Statistics()
+ :barrier_count{0}
+ ,batch_count{0}
+ ,bytes_transient{0}
+ ,bytes_allocated{0}
+{}
+
+TaskGraph::TaskGraph()
+ :m_device{}
+ ,m_dispatch{nullptr}
+ ,m_allocator{nullptr}
+ ,m_resources{}
+ ,m_passes{}
+ ,m_slots{}
+ ,m_final{}
+ ,m_statistics{}
+ ,m_compiled{false}
+{}
+
+TaskGraph::TaskGraph(vk::Device const& device, Allocator& allocator)
+ :TaskGraph{}
+{
+  m_device = device;
+  m_dispatch = &device_dispatch(device);
+  m_allocator = &allocator;
+}
+
+TaskGraph::TaskGraph(TaskGraph&& rhs)
+ :TaskGraph{}
+{
+  std::swap(m_device, rhs.m_device);
+  std::swap(m_dispatch, rhs.m_dispatch);
+  std::swap(m_allocator, rhs.m_allocator);
+  std::swap(m_resources, rhs.m_resources);
+  std::swap(m_passes, rhs.m_passes);
+  std::swap(m_slots, rhs.m_slots);
+  std::swap(m_final, rhs.m_final);
+  std::swap(m_statistics, rhs.m_statistics);
+  std::swap(m_compiled, rhs.m_compiled);
+}
+
+TaskGraph& TaskGraph::operator=(TaskGraph&& rhs) {
+  cleanup();
+  std::swap(m_device, rhs.m_device);
+  std::swap(m_dispatch, rhs.m_dispatch);
+  std::swap(m_allocator, rhs.m_allocator);
+  std::swap(m_resources, rhs.m_resources);
+  std::swap(m_passes, rhs.m_passes);
+  std::swap(m_slots, rhs.m_slots);
+  std::swap(m_final, rhs.m_final);
+  std::swap(m_statistics, rhs.m_statistics);
+  std::swap(m_compiled, rhs.m_compiled);
+  return *this;
+}
+
+TaskGraph::~TaskGraph() {
+  cleanup();
+}
+
+void TaskGraph::cleanup() {
+  release_transients();
+  m_resources.clear();
+  m_passes.clear();
+  m_final = Batch{};
+  m_statistics = Statistics{};
+  m_compiled = false;
+}
+
+void TaskGraph::release_transients() {
+  for (auto& resource : m_resources) {
+    if (!resource.transient) continue;
+    if (resource.view) {
+      m_device.destroyImageView(resource.view, nullptr, *m_dispatch);
+      resource.view = vk::ImageView{};
+    }
+    if (resource.image) {
+      m_device.destroyImage(resource.image, nullptr, *m_dispatch);
+      resource.image = vk::Image{};
+    }
+    if (resource.buffer) {
+      m_device.destroyBuffer(resource.buffer, nullptr, *m_dispatch);
+      resource.buffer = vk::Buffer{};
+    }
+  }
+  for (auto& slot : m_slots) {
+    m_allocator->free(slot.allocation);
+  }
+  m_slots.clear();
+}
+
+TaskGraph::Resource TaskGraph::import_buffer(vk::Buffer const& buffer) {
+  ResourceInfo resource{};
+  resource.is_image = false;
+  resource.buffer = buffer;
+  resource.alias_of = -1;
+  m_resources.push_back(resource);
+  return Resource(m_resources.size() - 1);
+}
+
+TaskGraph::Resource TaskGraph::import_image(vk::Image const& image, vk::ImageSubresourceRange const& range, vk::ImageLayout layout, vk::ImageView const& view) {
+  ResourceInfo resource{};
+  resource.is_image = true;
+  resource.image = image;
+  resource.view = view;
+  resource.range = range;
+  resource.initial_layout = layout;
+  resource.alias_of = -1;
+  m_resources.push_back(resource);
+  return Resource(m_resources.size() - 1);
+}
+
+TaskGraph::Resource TaskGraph::create_buffer(vk::BufferCreateInfo const& info) {
+  ResourceInfo resource{};
+  resource.is_image = false;
+  resource.transient = true;
+  resource.info_buffer = info;
+  resource.alias_of = -1;
+  m_resources.push_back(resource);
+  return Resource(m_resources.size() - 1);
+}
+
+TaskGraph::Resource TaskGraph::create_image(vk::ImageCreateInfo const& info) {
+  ResourceInfo resource{};
+  resource.is_image = true;
+  resource.transient = true;
+  resource.info_image = info;
+  // contents never survive between executions
+  resource.info_image.initialLayout = vk::ImageLayout::eUndefined;
+  resource.initial_layout = vk::ImageLayout::eUndefined;
+  resource.range.aspectMask = aspect_mask(info.format);
+  resource.range.baseMipLevel = 0;
+  resource.range.levelCount = info.mipLevels;
+  resource.range.baseArrayLayer = 0;
+  resource.range.layerCount = info.arrayLayers;
+  resource.alias_of = -1;
+  m_resources.push_back(resource);
+  return Resource(m_resources.size() - 1);
+}
+
+uint32_t TaskGraph::add_pass(std::string const& name, std::vector<Use> const& uses, Function const& fn) {
+  for (size_t i = 0; i < uses.size(); ++i) {
+    if (uses[i].resource >= m_resources.size()) {
+      throw std::runtime_error{"Pass '" + name + "' uses unknown resource"};
+    }
+    for (size_t j = 0; j < i; ++j) {
+      if (uses[i].resource == uses[j].resource) {
+        throw std::runtime_error{"Pass '" + name + "' uses resource " + std::to_string(uses[i].resource) + " twice"};
+      }
+    }
+  }
+  Pass pass{};
+  pass.name = name;
+  pass.uses = uses;
+  pass.function = fn;
+  m_passes.push_back(pass);
+  m_compiled = false;
+  return uint32_t(m_passes.size() - 1);
+}
+
+void TaskGraph::set_final_usage(Resource resource, ResourceUsage usage) {
+  m_resources.at(resource).has_final = true;
+  m_resources.at(resource).final_usage = usage;
+  m_compiled = false;
+}
+
+void TaskGraph::compile() {
+  release_transients();
+  m_statistics = Statistics{};
+
+  // lifetimes
+  uint32_t const unused = ~uint32_t(0);
+  for (auto& resource : m_resources) {
+    resource.first_pass = unused;
+    resource.last_pass = 0;
+    resource.alias_of = -1;
+    if (resource.has_final) {
+      resource.first_pass = uint32_t(m_passes.size());
+      resource.last_pass = uint32_t(m_passes.size());
+    }
+  }
+  for (uint32_t i = 0; i < m_passes.size(); ++i) {
+    for (auto const& use : m_passes[i].uses) {
+      ResourceInfo& resource = m_resources[use.resource];
+      resource.first_pass = std::min(resource.first_pass, i);
+      resource.last_pass = std::max(resource.last_pass, i);
+    }
+  }
+  allocate_transients();
+
+  // walk passes in order and track the state of every resource
+  std::vector<State> states(m_resources.size());
+  for (size_t i = 0; i < m_resources.size(); ++i) {
+    states[i] = State{};
+    states[i].layout = m_resources[i].initial_layout;
+  }
+  for (auto& pass : m_passes) {
+    pass.barriers = Batch{};
+    for (auto const& use : pass.uses) {
+      add_barrier(states, use.resource, use.usage, pass.barriers);
+    }
+  }
+  m_final = Batch{};
+  for (size_t i = 0; i < m_resources.size(); ++i) {
+    if (m_resources[i].has_final) {
+      add_barrier(states, Resource(i), m_resources[i].final_usage, m_final);
+    }
+  }
+
+  for (auto const& pass : m_passes) {
+    if (pass.barriers.src_stages) {
+      ++m_statistics.batch_count;
+      m_statistics.barrier_count += pass.barriers.images.size() + (pass.barriers.has_memory ? 1 : 0);
+    }
+  }
+  if (m_final.src_stages) {
+    ++m_statistics.batch_count;
+    m_statistics.barrier_count += m_final.images.size() + (m_final.has_memory ? 1 : 0);
+  }
+  m_compiled = true;
+}
+
+void TaskGraph::allocate_transients() {
+  std::vector<uint32_t> transients{};
+  for (uint32_t i = 0; i < m_resources.size(); ++i) {
+    ResourceInfo& resource = m_resources[i];
+    // unused transients are never created
+    if (!resource.transient || resource.first_pass > resource.last_pass) continue;
+    if (resource.is_image) {
+      resource.image = m_device.createImage(resource.info_image, nullptr, *m_dispatch);
+      resource.requirements = m_device.getImageMemoryRequirements(resource.image, *m_dispatch);
+    }
+    else {
+      resource.buffer = m_device.createBuffer(resource.info_buffer, nullptr, *m_dispatch);
+      resource.requirements = m_device.getBufferMemoryRequirements(resource.buffer, *m_dispatch);
+    }
+    m_statistics.bytes_transient += resource.requirements.size;
+    transients.push_back(i);
+  }
+  // placing large resources first keeps slots from growing
+  std::stable_sort(transients.begin(), transients.end(), [this](uint32_t a, uint32_t b) {
+    return m_resources[a].requirements.size > m_resources[b].requirements.size;
+  });
+
+  for (uint32_t index : transients) {
+    ResourceInfo const& resource = m_resources[index];
+    bool linear = !resource.is_image || resource.info_image.tiling == vk::ImageTiling::eLinear;
+    Slot* target = nullptr;
+    for (auto& slot : m_slots) {
+      // only alias resources of the same granularity class and compatible memory types
+      if (slot.linear != linear || !(slot.requirements.memoryTypeBits & resource.requirements.memoryTypeBits)) continue;
+      bool overlaps = false;
+      for (uint32_t other : slot.resources) {
+        overlaps = overlaps || (resource.first_pass <= m_resources[other].last_pass && m_resources[other].first_pass <= resource.last_pass);
+      }
+      if (!overlaps) {
+        target = &slot;
+        break;
+      }
+    }
+    if (!target) {
+      m_slots.push_back(Slot{});
+      target = &m_slots.back();
+      target->requirements = resource.requirements;
+      target->linear = linear;
+    }
+    target->requirements.size = std::max(target->requirements.size, resource.requirements.size);
+    target->requirements.alignment = std::max(target->requirements.alignment, resource.requirements.alignment);
+    target->requirements.memoryTypeBits &= resource.requirements.memoryTypeBits;
+    target->resources.push_back(index);
+  }
+
+  for (auto& slot : m_slots) {
+    slot.allocation = m_allocator->allocate(slot.requirements, MemoryUsage::eDeviceLocal, slot.linear);
+    m_statistics.bytes_allocated += slot.allocation.size;
+    for (uint32_t index : slot.resources) {
+      ResourceInfo& resource = m_resources[index];
+      if (resource.is_image) {
+        m_device.bindImageMemory(resource.image, slot.allocation.memory, slot.allocation.offset, *m_dispatch);
+      }
+      else {
+        m_device.bindBufferMemory(resource.buffer, slot.allocation.memory, slot.allocation.offset, *m_dispatch);
+      }
+      // the latest resource ending before this one starts must finish first
+      for (uint32_t other : slot.resources) {
+        if (m_resources[other].last_pass < resource.first_pass
+         && (resource.alias_of < 0 || m_resources[uint32_t(resource.alias_of)].last_pass < m_resources[other].last_pass)) {
+          resource.alias_of = int32_t(other);
+        }
+      }
+    }
+  }
+
+  for (auto& resource : m_resources) {
+    if (!resource.transient || !resource.is_image || !resource.image) continue;
+    vk::ImageViewCreateInfo info_view{};
+    info_view.image = resource.image;
+    info_view.viewType = view_type(resource.info_image.imageType);
+    info_view.format = resource.info_image.format;
+    info_view.subresourceRange = resource.range;
+    // views read by shaders may only select one aspect, depth is the one sampled
+    if (info_view.subresourceRange.aspectMask & vk::ImageAspectFlagBits::eDepth) {
+      info_view.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eDepth;
+    }
+    resource.view = m_device.createImageView(info_view, nullptr, *m_dispatch);
+  }
+}
+
+void TaskGraph::add_barrier(std::vector<State>& states, Resource index, ResourceUsage usage, Batch& batch) const {
+  ResourceInfo const& resource = m_resources[index];
+  State& state = states[index];
+  UsageInfo info = usage_info(usage);
+  if (!state.used && resource.alias_of >= 0) {
+    // inherit hazards of the resource previously occupying the memory
+    State const& state_previous = states[uint32_t(resource.alias_of)];
+    state.write_stages = state_previous.write_stages | state_previous.read_stages;
+    state.write_access = state_previous.write_access;
+  }
+  state.used = true;
+
+  bool transition = resource.is_image && state.layout != info.layout;
+  bool hazard = false;
+  if (info.write) {
+    // write after write and write after read
+    hazard = bool(state.write_stages) || bool(state.read_stages);
+  }
+  else {
+    // read after write, skipped if the write was already made visible to this stage
+    hazard = bool(state.write_stages)
+          && ((state.visible_stages & info.stages) != info.stages || (state.visible_access & info.access) != info.access);
+  }
+
+  if (transition || hazard) {
+    vk::PipelineStageFlags src_stages = state.write_stages | state.read_stages;
+    if (!src_stages) {
+      src_stages = vk::PipelineStageFlagBits::eTopOfPipe;
+    }
+    batch.src_stages |= src_stages;
+    batch.dst_stages |= info.stages;
+    if (resource.is_image) {
+      vk::ImageMemoryBarrier barrier{};
+      barrier.srcAccessMask = state.write_access;
+      barrier.dstAccessMask = info.access;
+      barrier.oldLayout = state.layout;
+      barrier.newLayout = info.layout;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image = resource.image;
+      barrier.subresourceRange = resource.range;
+      batch.images.push_back(barrier);
+    }
+    else {
+      batch.memory.srcAccessMask |= state.write_access;
+      batch.memory.dstAccessMask |= info.access;
+      batch.has_memory = true;
+    }
+  }
+
+  if (info.write) {
+    state.write_stages = info.stages;
+    state.write_access = info.access & (vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite);
+    state.read_stages = vk::PipelineStageFlags{};
+    state.visible_stages = vk::PipelineStageFlags{};
+    state.visible_access = vk::AccessFlags{};
+  }
+  else {
+    state.read_stages |= info.stages;
+    if (transition || hazard) {
+      state.visible_stages |= info.stages;
+      state.visible_access |= info.access;
+    }
+  }
+  if (resource.is_image) {
+    state.layout = info.layout;
+  }
+}
+
+void TaskGraph::record(vk::CommandBuffer const& command_buffer, Batch const& batch) const {
+  if (!batch.src_stages) return;
+  command_buffer.pipelineBarrier(
+    batch.src_stages,
+    batch.dst_stages,
+    vk::DependencyFlags{},
+    vk::ArrayProxy<const vk::MemoryBarrier>{batch.has_memory ? 1u : 0u, &batch.memory},
+    nullptr,
+    batch.images,
+    *m_dispatch
+  );
+}
+
+void TaskGraph::execute(vk::CommandBuffer const& command_buffer) const {
+  if (!m_compiled) {
+    throw std::runtime_error{"TaskGraph must be compiled before execution"};
+  }
+  for (auto const& pass : m_passes) {
+    record(command_buffer, pass.barriers);
+    pass.function(command_buffer, *this);
+  }
+  record(command_buffer, m_final);
+}
+
+vk::Buffer const& TaskGraph::buffer(Resource resource) const {
+  return m_resources.at(resource).buffer;
+}
+
+vk::Image const& TaskGraph::image(Resource resource) const {
+  return m_resources.at(resource).image;
+}
+
+vk::ImageView const& TaskGraph::view(Resource resource) const {
+  return m_resources.at(resource).view;
+}
+
+TaskGraph::Statistics TaskGraph::statistics() const {
+  return m_statistics;
+}
+
+vk::ImageLayout TaskGraph::layout(ResourceUsage usage) {
+  return usage_info(usage).layout;
+}
@@ -0,0 +1,289 @@
+#include "tiled_processor.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+static vk::Format const tile_format = vk::Format::eR8G8B8A8Unorm;
+
+static Handle<vk::Image> create_tile_image(vk::Device const& device, vk::DispatchLoaderDynamic const& dispatch, uint32_t size, vk::ImageUsageFlags const& usage) {
+  vk::ImageCreateInfo info_image{};
+  info_image.imageType = vk::ImageType::e2D;
+  info_image.extent = vk::Extent3D{size, size, 1};
+  info_image.format = tile_format;
+  info_image.tiling = vk::ImageTiling::eOptimal;
+  info_image.mipLevels = 1;
+  info_image.arrayLayers = 1;
+  info_image.initialLayout = vk::ImageLayout::eUndefined;
+  info_image.usage = usage;
+  return Handle<vk::Image>{device, device.createImage(info_image, nullptr, dispatch)};
+}
+
+static Handle<vk::ImageView> create_tile_view(vk::Device const& device, vk::DispatchLoaderDynamic const& dispatch, vk::Image const& image) {
+  vk::ImageViewCreateInfo info_view{};
+  info_view.image = image;
+  info_view.viewType = vk::ImageViewType::e2D;
+  info_view.format = tile_format;
+  info_view.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+  info_view.subresourceRange.levelCount = 1;
+  info_view.subresourceRange.layerCount = 1;
+  return Handle<vk::ImageView>{device, device.createImageView(info_view, nullptr, dispatch)};
+}
+
+static Handle<vk::Buffer> create_staging_buffer(vk::Device const& device, vk::DispatchLoaderDynamic const& dispatch, vk::DeviceSize size, vk::BufferUsageFlags const& usage) {
+  vk::BufferCreateInfo info_buffer{};
+  info_buffer.size = size;
+  info_buffer.usage = usage;
+  return Handle<vk::Buffer>{device, device.createBuffer(info_buffer, nullptr, dispatch)};
+}
+
+static vk::ImageMemoryBarrier image_barrier(vk::Image const& image, vk::ImageLayout old_layout, vk::ImageLayout new_layout, vk::AccessFlags const& src_access, vk::AccessFlags const& dst_access) {
+  vk::ImageMemoryBarrier barrier{};
+  barrier.image = image;
+  barrier.oldLayout = old_layout;
+  barrier.newLayout = new_layout;
+  barrier.srcAccessMask = src_access;
+  barrier.dstAccessMask = dst_access;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.layerCount = 1;
+  return barrier;
+}
+
+TiledProcessor::TiledProcessor(vk::Device const& device, vk::PhysicalDevice const& phys_device, Allocator& allocator, uint32_t queue_family, vk::Queue const& queue, uint32_t tile_size, uint32_t halo, uint32_t slot_count)
+ :m_device{device}
+ ,m_dispatch{&device_dispatch(device)}
+ ,m_allocator{&allocator}
+ ,m_queue{queue}
+ ,m_tile_size{0}
+ ,m_halo{halo}
+ ,m_command_pool{}
+ ,m_slots(std::max(slot_count, 1u))
+{
+  uint32_t max_dimension = phys_device.getProperties().limits.maxImageDimension2D;
+  if (2 * halo >= max_dimension) {
+    throw std::runtime_error{"Tile halo exceeds the maximum image dimension"};
+  }
+  // the input image holds the tile and the halo on both sides
+  m_tile_size = std::max(std::min(tile_size, max_dimension - 2 * halo), 1u);
+  uint32_t const input_size = m_tile_size + 2 * m_halo;
+
+  vk::CommandPoolCreateInfo info_command_pool{};
+  info_command_pool.queueFamilyIndex = queue_family;
+  info_command_pool.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+  m_command_pool = Handle<vk::CommandPool>{m_device, m_device.createCommandPool(info_command_pool, nullptr, *m_dispatch)};
+
+  vk::CommandBufferAllocateInfo info_command_buffer{};
+  info_command_buffer.commandPool = m_command_pool.get();
+  info_command_buffer.level = vk::CommandBufferLevel::ePrimary;
+  info_command_buffer.commandBufferCount = uint32_t(m_slots.size());
+  std::vector<vk::CommandBuffer> command_buffers = m_device.allocateCommandBuffers(info_command_buffer, *m_dispatch);
+
+  for (size_t i = 0; i < m_slots.size(); ++i) {
+    Slot& slot = m_slots[i];
+    slot.command_buffer = command_buffers[i];
+    slot.fence = Handle<vk::Fence>{m_device, m_device.createFence(vk::FenceCreateInfo{}, nullptr, *m_dispatch)};
+    slot.busy = false;
+
+    slot.input = create_tile_image(m_device, *m_dispatch, input_size, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst);
+    slot.allocation_input = AllocationHandle{allocator, allocator.allocate(slot.input.get(), MemoryUsage::eDeviceLocal)};
+    slot.view_input = create_tile_view(m_device, *m_dispatch, slot.input.get());
+    slot.output = create_tile_image(m_device, *m_dispatch, m_tile_size, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc);
+    slot.allocation_output = AllocationHandle{allocator, allocator.allocate(slot.output.get(), MemoryUsage::eDeviceLocal)};
+    slot.view_output = create_tile_view(m_device, *m_dispatch, slot.output.get());
+
+    // write-combined memory for the source, cached memory for reading tiles back
+    slot.upload = create_staging_buffer(m_device, *m_dispatch, vk::DeviceSize(input_size) * input_size * 4, vk::BufferUsageFlagBits::eTransferSrc);
+    slot.allocation_upload = AllocationHandle{allocator, allocator.allocate(slot.upload.get(), MemoryUsage::eUpload)};
+    slot.readback = create_staging_buffer(m_device, *m_dispatch, vk::DeviceSize(m_tile_size) * m_tile_size * 4, vk::BufferUsageFlagBits::eTransferDst);
+    slot.allocation_readback = AllocationHandle{allocator, allocator.allocate(slot.readback.get(), MemoryUsage::eReadback)};
+  }
+}
+
+TiledProcessor::~TiledProcessor() {
+  wait_idle();
+}
+
+void TiledProcessor::run(uint32_t width, uint32_t height, Source const& source, Kernel const& kernel, Sink const& sink) {
+  PROFILE_SCOPE("tiled run");
+  // drop tiles of a previous run that was aborted by an exception
+  wait_idle();
+  if (width == 0 || height == 0) return;
+
+  uint32_t const tiles_x = (width + m_tile_size - 1) / m_tile_size;
+  uint32_t const tiles_y = (height + m_tile_size - 1) / m_tile_size;
+  uint32_t const tile_count = tiles_x * tiles_y;
+  uint32_t const slot_count = uint32_t(m_slots.size());
+  // one row of tiles
+  std::vector<uint8_t> strip(size_t(width) * 4 * std::min(m_tile_size, height));
+
+  // tiles are submitted in row-major order and retired in the same order,
+  // so a slot is always reused after the oldest tile in flight finished
+  for (uint32_t index = 0; index < tile_count; ++index) {
+    Tile tile{};
+    tile.index = index;
+    tile.x = index % tiles_x * m_tile_size;
+    tile.y = index / tiles_x * m_tile_size;
+    tile.width = std::min(m_tile_size, width - tile.x);
+    tile.height = std::min(m_tile_size, height - tile.y);
+    tile.input_x = tile.x - std::min(tile.x, m_halo);
+    tile.input_y = tile.y - std::min(tile.y, m_halo);
+    tile.input_width = std::min(tile.x + tile.width + m_halo, width) - tile.input_x;
+    tile.input_height = std::min(tile.y + tile.height + m_halo, height) - tile.input_y;
+
+    Slot& slot = m_slots[index % slot_count];
+    if (slot.busy) {
+      retire(slot, strip, width, sink);
+    }
+    submit(slot, tile, source, kernel, index % slot_count);
+  }
+  for (uint32_t index = tile_count; index < tile_count + slot_count; ++index) {
+    Slot& slot = m_slots[index % slot_count];
+    if (slot.busy) {
+      retire(slot, strip, width, sink);
+    }
+  }
+}
+
+void TiledProcessor::wait_idle() {
+  for (auto& slot : m_slots) {
+    if (slot.busy) {
+      m_device.waitForFences(slot.fence.get(), VK_TRUE, UINT64_MAX, *m_dispatch);
+      slot.busy = false;
+    }
+  }
+}
+
+vk::ImageView const& TiledProcessor::input_view(uint32_t slot) const {
+  return m_slots.at(slot).view_input.get();
+}
+
+vk::ImageView const& TiledProcessor::output_view(uint32_t slot) const {
+  return m_slots.at(slot).view_output.get();
+}
+
+uint32_t TiledProcessor::tile_size() const {
+  return m_tile_size;
+}
+
+uint32_t TiledProcessor::halo() const {
+  return m_halo;
+}
+
+uint32_t TiledProcessor::slot_count() const {
+  return uint32_t(m_slots.size());
+}
+
+void TiledProcessor::submit(Slot& slot, Tile const& tile, Source const& source, Kernel const& kernel, uint32_t slot_index) {
+  if (source) {
+    PROFILE_SCOPE("tile source");
+    Allocation const& allocation = slot.allocation_upload.get();
+    source(tile, allocation.ptr, size_t(tile.input_width) * 4);
+    m_allocator->flush(allocation, 0, vk::DeviceSize(tile.input_width) * tile.input_height * 4);
+  }
+  slot.tile = tile;
+
+  vk::CommandBuffer const& cb = slot.command_buffer;
+  m_device.resetFences(slot.fence.get(), *m_dispatch);
+  vk::CommandBufferBeginInfo info_cb_begin{};
+  info_cb_begin.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+  cb.begin(info_cb_begin, *m_dispatch);
+
+  vk::ImageSubresourceLayers layers{};
+  layers.aspectMask = vk::ImageAspectFlagBits::eColor;
+  layers.layerCount = 1;
+  // contents of the previous tile are discarded, the fence wait ordered its accesses
+  std::vector<vk::ImageMemoryBarrier> barriers{
+    image_barrier(slot.input.get(), vk::ImageLayout::eUndefined, source ? vk::ImageLayout::eTransferDstOptimal : vk::ImageLayout::eGeneral, vk::AccessFlags{}, source ? vk::AccessFlags{vk::AccessFlagBits::eTransferWrite} : vk::AccessFlags{vk::AccessFlagBits::eShaderRead}),
+    image_barrier(slot.output.get(), vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral, vk::AccessFlags{}, vk::AccessFlagBits::eShaderWrite)
+  };
+  cb.pipelineBarrier(
+    vk::PipelineStageFlagBits::eTopOfPipe,
+    vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader,
+    vk::DependencyFlags{},
+    nullptr,
+    nullptr,
+    barriers,
+    *m_dispatch
+  );
+  if (source) {
+    vk::BufferImageCopy region{};
+    region.imageSubresource = layers;
+    region.imageExtent = vk::Extent3D{tile.input_width, tile.input_height, 1};
+    cb.copyBufferToImage(slot.upload.get(), slot.input.get(), vk::ImageLayout::eTransferDstOptimal, region, *m_dispatch);
+
+    vk::ImageMemoryBarrier barrier = image_barrier(slot.input.get(), vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eGeneral, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead);
+    cb.pipelineBarrier(
+      vk::PipelineStageFlagBits::eTransfer,
+      vk::PipelineStageFlagBits::eComputeShader,
+      vk::DependencyFlags{},
+      nullptr,
+      nullptr,
+      barrier,
+      *m_dispatch
+    );
+  }
+
+  {
+    PROFILE_SCOPE("tile kernel");
+    kernel(cb, tile, slot_index);
+  }
+
+  vk::ImageMemoryBarrier barrier = image_barrier(slot.output.get(), vk::ImageLayout::eGeneral, vk::ImageLayout::eGeneral, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead);
+  cb.pipelineBarrier(
+    vk::PipelineStageFlagBits::eComputeShader,
+    vk::PipelineStageFlagBits::eTransfer,
+    vk::DependencyFlags{},
+    nullptr,
+    nullptr,
+    barrier,
+    *m_dispatch
+  );
+  vk::BufferImageCopy region{};
+  region.imageSubresource = layers;
+  region.imageExtent = vk::Extent3D{tile.width, tile.height, 1};
+  cb.copyImageToBuffer(slot.output.get(), vk::ImageLayout::eGeneral, slot.readback.get(), region, *m_dispatch);
+  // make the copy visible to the host
+  vk::MemoryBarrier barrier_host{};
+  barrier_host.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+  barrier_host.dstAccessMask = vk::AccessFlagBits::eHostRead;
+  cb.pipelineBarrier(
+    vk::PipelineStageFlagBits::eTransfer,
+    vk::PipelineStageFlagBits::eHost,
+    vk::DependencyFlags{},
+    barrier_host,
+    nullptr,
+    nullptr,
+    *m_dispatch
+  );
+  cb.end(*m_dispatch);
+
+  vk::SubmitInfo info_submit{};
+  info_submit.pCommandBuffers = &cb;
+  info_submit.commandBufferCount = 1;
+  m_queue.submit(info_submit, slot.fence.get(), *m_dispatch);
+  slot.busy = true;
+}
+
+void TiledProcessor::retire(Slot& slot, std::vector<uint8_t>& strip, uint32_t width, Sink const& sink) {
+  m_device.waitForFences(slot.fence.get(), VK_TRUE, UINT64_MAX, *m_dispatch);
+  slot.busy = false;
+
+  PROFILE_SCOPE("tile readback");
+  Tile const& tile = slot.tile;
+  size_t const row_size = size_t(tile.width) * 4;
+  size_t const strip_pitch = size_t(width) * 4;
+  Allocation const& allocation = slot.allocation_readback.get();
+  m_allocator->invalidate(allocation, 0, vk::DeviceSize(row_size) * tile.height);
+  for (uint32_t y = 0; y < tile.height; ++y) {
+    std::memcpy(&strip[y * strip_pitch + size_t(tile.x) * 4], allocation.ptr + y * row_size, row_size);
+  }
+  // last tile of its row completes the strip
+  if (tile.x + tile.width == width) {
+    PROFILE_SCOPE("tile sink");
+    sink(strip.data(), tile.y, tile.height, strip_pitch);
+  }
+}
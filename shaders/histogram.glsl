@@ -0,0 +1,72 @@
+// counts values into bins, in shared memory first if all bins fit
+#include "primitives.glsl"
+
+layout(set = 0, binding = 0) readonly buffer Input { uint values[]; } src;
+layout(set = 0, binding = 1) buffer Bins { uint counts[]; } bins;
+
+layout(push_constant) uniform PushConstants {
+  uint count;
+  // values v with lower <= v < lower + bin_count * bin_width are counted in bin (v - lower) / bin_width
+  uint lower;
+  uint bin_width;
+  uint bin_count;
+} constants;
+
+const uint SHARED_BINS = 2048;
+shared uint s_bins[SHARED_BINS];
+
+void add(uint bin, uint amount, bool use_shared) {
+  if (use_shared) {
+    atomicAdd(s_bins[bin], amount);
+  }
+  else {
+    atomicAdd(bins.counts[bin], amount);
+  }
+}
+
+void count_value(uint bin, bool valid, bool use_shared) {
+#ifdef SUBGROUPS
+  // invocations with equal bins are counted with a single atomic
+  bool done = !valid;
+  while (!done) {
+    uint leader_bin = subgroupBroadcastFirst(bin);
+    if (bin == leader_bin) {
+      uint amount = subgroupBallotBitCount(subgroupBallot(true));
+      if (subgroupElect()) {
+        add(bin, amount, use_shared);
+      }
+      done = true;
+    }
+  }
+#else
+  if (valid) {
+    add(bin, 1u, use_shared);
+  }
+#endif
+}
+
+void main() {
+  uint size = gl_WorkGroupSize.x;
+  bool use_shared = constants.bin_count <= SHARED_BINS;
+  if (use_shared) {
+    for (uint i = gl_LocalInvocationID.x; i < constants.bin_count; i += size) {
+      s_bins[i] = 0;
+    }
+  }
+  barrier();
+  // grid-stride loop, the grid is limited to keep the shared bins busy
+  uint invocations = gl_NumWorkGroups.x * gl_NumWorkGroups.y * size;
+  for (uint index = block_index() * size + gl_LocalInvocationID.x; index < constants.count; index += invocations) {
+    uint value = src.values[index];
+    uint bin = (value - constants.lower) / constants.bin_width;
+    count_value(bin, value >= constants.lower && bin < constants.bin_count, use_shared);
+  }
+  barrier();
+  if (use_shared) {
+    for (uint i = gl_LocalInvocationID.x; i < constants.bin_count; i += size) {
+      if (s_bins[i] != 0) {
+        atomicAdd(bins.counts[i], s_bins[i]);
+      }
+    }
+  }
+}
@@ -0,0 +1,34 @@
+// declarations shared by the parallel primitives
+// SUBGROUPS is defined by the variants using subgroup operations
+#ifdef SUBGROUPS
+#extension GL_KHR_shader_subgroup_basic : require
+#extension GL_KHR_shader_subgroup_arithmetic : require
+#extension GL_KHR_shader_subgroup_ballot : require
+#extension GL_KHR_shader_subgroup_shuffle_relative : require
+#endif
+
+// must be a power of two, each workgroup processes one block
+layout(local_size_x_id = 0) in;
+// combining operation, 0 add, 1 min, 2 max
+layout(constant_id = 1) const uint OP = 0;
+// whether head flags start new segments
+layout(constant_id = 2) const bool SEGMENTED = false;
+
+// values per invocation of reduce and scan blocks
+const uint ITEMS = 4;
+// radix sort digits
+const uint RADIX_BITS = 4;
+const uint RADIX = 1u << RADIX_BITS;
+
+uint identity() {
+  return OP == 1 ? 0xffffffffu : 0u;
+}
+
+uint combine(uint a, uint b) {
+  return OP == 0 ? a + b : (OP == 1 ? min(a, b) : max(a, b));
+}
+
+// blocks are spread over two dimensions to exceed the group count limit of one
+uint block_index() {
+  return gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+}
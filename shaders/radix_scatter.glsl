@@ -0,0 +1,66 @@
+// sorts each block locally by the digit and moves the pairs to their place in the output
+// the offsets are the exclusive scan of the digit-major counts of radix_count
+#include "primitives.glsl"
+#include "workgroup_scan.glsl"
+
+layout(set = 0, binding = 0) readonly buffer KeysInput { uint values[]; } keys_src;
+layout(set = 0, binding = 1) readonly buffer ValuesInput { uint values[]; } values_src;
+layout(set = 0, binding = 2) writeonly buffer KeysOutput { uint values[]; } keys_dst;
+layout(set = 0, binding = 3) writeonly buffer ValuesOutput { uint values[]; } values_dst;
+layout(set = 0, binding = 4) readonly buffer Offsets { uint values[]; } offsets;
+
+layout(push_constant) uniform PushConstants {
+  uint count;
+  uint shift;
+  uint block_count;
+} constants;
+
+shared uint s_keys[gl_WorkGroupSize.x];
+shared uint s_values[gl_WorkGroupSize.x];
+shared uint s_digit_begin[RADIX];
+
+uint digit(uint key) {
+  return (key >> constants.shift) & (RADIX - 1u);
+}
+
+void main() {
+  uint block = block_index();
+  if (block >= constants.block_count) return;
+  uint size = gl_WorkGroupSize.x;
+  uint local = gl_LocalInvocationID.x;
+  uint index = block * size + local;
+  uint valid_count = min(size, constants.count - block * size);
+
+  // padding has the largest digit and stays behind the valid keys, the sort is stable
+  uint key = 0xffffffffu;
+  uint value = 0u;
+  if (index < constants.count) {
+    key = keys_src.values[index];
+    value = values_src.values[index];
+  }
+  // one stable split per bit of the digit
+  for (uint bit = 0; bit < RADIX_BITS; ++bit) {
+    uint zero = ((digit(key) >> bit) & 1u) ^ 1u;
+    uint zeros_before = workgroup_exclusive_scan(false, zero);
+    uint rank = zero != 0 ? zeros_before : s_total + local - zeros_before;
+    s_keys[rank] = key;
+    s_values[rank] = value;
+    barrier();
+    key = s_keys[local];
+    value = s_values[local];
+    barrier();
+  }
+  // first position of each digit in the sorted block
+  uint key_digit = digit(key);
+  s_keys[local] = key_digit;
+  barrier();
+  if (local == 0 || s_keys[local - 1] != key_digit) {
+    s_digit_begin[key_digit] = local;
+  }
+  barrier();
+  if (local < valid_count) {
+    uint position = offsets.values[key_digit * constants.block_count + block] + local - s_digit_begin[key_digit];
+    keys_dst.values[position] = key;
+    values_dst.values[position] = value;
+  }
+}
@@ -0,0 +1,32 @@
+// reduces each block of ITEMS values per invocation to one value
+#include "primitives.glsl"
+#include "workgroup_scan.glsl"
+
+layout(set = 0, binding = 0) readonly buffer Input { uint values[]; } src;
+layout(set = 0, binding = 1) writeonly buffer Output { uint values[]; } dst;
+
+layout(push_constant) uniform PushConstants {
+  uint count;
+  // the result of block i is written to dst[output_index + i]
+  uint output_index;
+} constants;
+
+void main() {
+  uint block = block_index();
+  uint size = gl_WorkGroupSize.x;
+  uint block_begin = block * size * ITEMS;
+  if (block_begin >= constants.count) return;
+
+  // strided, neighbouring invocations read neighbouring values
+  uint value = identity();
+  for (uint i = 0; i < ITEMS; ++i) {
+    uint index = block_begin + i * size + gl_LocalInvocationID.x;
+    if (index < constants.count) {
+      value = combine(value, src.values[index]);
+    }
+  }
+  value = workgroup_reduce(value);
+  if (gl_LocalInvocationID.x == 0) {
+    dst.values[constants.output_index + block] = value;
+  }
+}
@@ -0,0 +1,69 @@
+// scans each block of ITEMS values per invocation and writes the block totals
+// the totals are scanned in turn and added back by scan_add
+#include "primitives.glsl"
+#include "workgroup_scan.glsl"
+
+layout(set = 0, binding = 0) readonly buffer Input { uint values[]; } src;
+// non-zero values start a segment, only read if SEGMENTED
+layout(set = 0, binding = 1) readonly buffer Flags { uint values[]; } flags;
+layout(set = 0, binding = 2) writeonly buffer Output { uint values[]; } dst;
+// per block the combination since its last segment start, whether it has one and the first one
+layout(set = 0, binding = 3) writeonly buffer Totals { uint values[]; } totals;
+layout(set = 0, binding = 4) writeonly buffer TotalFlags { uint values[]; } total_flags;
+layout(set = 0, binding = 5) writeonly buffer FirstHeads { uint values[]; } first_heads;
+
+layout(push_constant) uniform PushConstants {
+  uint count;
+  // inclusive or exclusive scan
+  uint inclusive;
+} constants;
+
+shared uint s_first_head;
+
+void main() {
+  uint block = block_index();
+  uint size = gl_WorkGroupSize.x;
+  uint block_begin = block * size * ITEMS;
+  if (block_begin >= constants.count) return;
+
+  if (gl_LocalInvocationID.x == 0) {
+    s_first_head = 0xffffffffu;
+  }
+  barrier();
+  // each invocation scans consecutive values
+  uint local_begin = gl_LocalInvocationID.x * ITEMS;
+  uint values[ITEMS];
+  bool heads[ITEMS];
+  uint sum = identity();
+  bool head = false;
+  for (uint i = 0; i < ITEMS; ++i) {
+    uint index = block_begin + local_begin + i;
+    values[i] = identity();
+    heads[i] = false;
+    if (index < constants.count) {
+      values[i] = src.values[index];
+      if (SEGMENTED) {
+        heads[i] = flags.values[index] != 0;
+      }
+    }
+    if (heads[i]) {
+      atomicMin(s_first_head, local_begin + i);
+    }
+    sum = heads[i] ? values[i] : combine(sum, values[i]);
+    head = head || heads[i];
+  }
+  uint prefix = workgroup_exclusive_scan(head, sum);
+  for (uint i = 0; i < ITEMS; ++i) {
+    uint index = block_begin + local_begin + i;
+    uint exclusive = heads[i] ? identity() : prefix;
+    prefix = combine(exclusive, values[i]);
+    if (index < constants.count) {
+      dst.values[index] = constants.inclusive != 0 ? prefix : exclusive;
+    }
+  }
+  if (gl_LocalInvocationID.x == 0) {
+    totals.values[block] = s_total;
+    total_flags.values[block] = s_total_flag ? 1u : 0u;
+    first_heads.values[block] = s_first_head;
+  }
+}
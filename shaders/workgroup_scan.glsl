@@ -0,0 +1,130 @@
+// scans and reductions of one value per invocation over the workgroup
+// all invocations must call them in uniform control flow
+shared uint s_value[gl_WorkGroupSize.x];
+shared uint s_flag[gl_WorkGroupSize.x];
+// result over the whole workgroup, valid after the call returns
+shared uint s_total;
+shared bool s_total_flag;
+
+// exclusive scan of (flag, value) pairs, a set flag starts a new segment at its invocation
+// returns the combination of the values since the last segment start before this invocation
+uint workgroup_exclusive_scan(bool flag, uint value) {
+  uint index = gl_LocalInvocationID.x;
+#ifdef SUBGROUPS
+  uint lane = gl_SubgroupInvocationID;
+  uint head = flag ? 1u : 0u;
+  // inclusive scan inside the subgroup
+  if (SEGMENTED) {
+    for (uint offset = 1; offset < gl_SubgroupSize; offset *= 2) {
+      uint value_up = subgroupShuffleUp(value, offset);
+      uint head_up = subgroupShuffleUp(head, offset);
+      if (lane >= offset) {
+        value = head != 0 ? value : combine(value_up, value);
+        head |= head_up;
+      }
+    }
+  }
+  else if (OP == 0) {
+    value = subgroupInclusiveAdd(value);
+  }
+  else if (OP == 1) {
+    value = subgroupInclusiveMin(value);
+  }
+  else {
+    value = subgroupInclusiveMax(value);
+  }
+  uint value_before = subgroupShuffleUp(value, 1);
+  uint head_before = subgroupShuffleUp(head, 1);
+  if (lane == 0) {
+    value_before = identity();
+    head_before = 0;
+  }
+  // the few subgroup totals are scanned by one invocation
+  if (lane == gl_SubgroupSize - 1) {
+    s_value[gl_SubgroupID] = value;
+    s_flag[gl_SubgroupID] = head;
+  }
+  barrier();
+  if (index == 0) {
+    uint prefix = identity();
+    uint prefix_head = 0;
+    for (uint i = 0; i < gl_NumSubgroups; ++i) {
+      uint total = s_value[i];
+      uint total_head = s_flag[i];
+      s_value[i] = prefix;
+      s_flag[i] = prefix_head;
+      prefix = total_head != 0 ? total : combine(prefix, total);
+      prefix_head |= total_head;
+    }
+    s_total = prefix;
+    s_total_flag = prefix_head != 0;
+  }
+  barrier();
+  // the prefix of the subgroup ends at a segment start inside it
+  uint result = head_before != 0 ? value_before : combine(s_value[gl_SubgroupID], value_before);
+  barrier();
+  return result;
+#else
+  s_value[index] = value;
+  s_flag[index] = flag ? 1u : 0u;
+  barrier();
+  for (uint offset = 1; offset < gl_WorkGroupSize.x; offset *= 2) {
+    uint value_up = index >= offset ? s_value[index - offset] : identity();
+    uint head_up = index >= offset ? s_flag[index - offset] : 0u;
+    barrier();
+    if (index >= offset) {
+      s_value[index] = s_flag[index] != 0 ? s_value[index] : combine(value_up, s_value[index]);
+      s_flag[index] |= head_up;
+    }
+    barrier();
+  }
+  uint result = index > 0 ? s_value[index - 1] : identity();
+  if (index == gl_WorkGroupSize.x - 1) {
+    s_total = s_value[index];
+    s_total_flag = s_flag[index] != 0;
+  }
+  barrier();
+  return result;
+#endif
+}
+
+// returns the combination of the values of all invocations
+uint workgroup_reduce(uint value) {
+  uint index = gl_LocalInvocationID.x;
+#ifdef SUBGROUPS
+  if (OP == 0) {
+    value = subgroupAdd(value);
+  }
+  else if (OP == 1) {
+    value = subgroupMin(value);
+  }
+  else {
+    value = subgroupMax(value);
+  }
+  if (subgroupElect()) {
+    s_value[gl_SubgroupID] = value;
+  }
+  barrier();
+  if (index == 0) {
+    uint total = identity();
+    for (uint i = 0; i < gl_NumSubgroups; ++i) {
+      total = combine(total, s_value[i]);
+    }
+    s_total = total;
+  }
+  barrier();
+  return s_total;
+#else
+  s_value[index] = value;
+  barrier();
+  for (uint offset = gl_WorkGroupSize.x / 2; offset > 0; offset /= 2) {
+    if (index < offset) {
+      s_value[index] = combine(s_value[index], s_value[index + offset]);
+    }
+    barrier();
+  }
+  uint total = s_value[0];
+  barrier();
+  return total;
+#endif
+}
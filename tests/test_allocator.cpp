@@ -0,0 +1,78 @@
+#include "allocator.hpp"
+#include "benchmark.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// two small adjacent readback allocations in non-coherent memory must not share a
+// nonCoherentAtomSize unit, otherwise invalidating one discards host writes to the other
+// returns 77 without a host visible, non-coherent memory type
+
+static int failures = 0;
+
+static void check(bool condition, std::string const& message) {
+  if (!condition) {
+    std::cerr << "FAILED: " << message << std::endl;
+    ++failures;
+  }
+}
+
+int main() {
+  HeadlessDevice headless = create_headless_device();
+  vk::PhysicalDevice phys_device = headless.selection.phys_device;
+  vk::DeviceSize atom_size = std::max(phys_device.getProperties().limits.nonCoherentAtomSize, vk::DeviceSize{1});
+
+  vk::PhysicalDeviceMemoryProperties mem_properties = phys_device.getMemoryProperties();
+  uint32_t type = UINT32_MAX;
+  for (uint32_t i = 0; i < mem_properties.memoryTypeCount && type == UINT32_MAX; ++i) {
+    vk::MemoryPropertyFlags flags = mem_properties.memoryTypes[i].propertyFlags;
+    if ((flags & vk::MemoryPropertyFlagBits::eHostVisible) && !(flags & vk::MemoryPropertyFlagBits::eHostCoherent)) {
+      type = i;
+    }
+  }
+  if (type == UINT32_MAX) {
+    std::cerr << "skipped, no host visible non-coherent memory type" << std::endl;
+    destroy_headless_device(headless);
+    return 77;
+  }
+
+  {
+    Allocator allocator{headless.device, phys_device};
+    // smaller than any atom and only 4 byte aligned
+    vk::MemoryRequirements requirements{};
+    requirements.size = 16;
+    requirements.alignment = 4;
+    requirements.memoryTypeBits = 1u << type;
+    Allocation first = allocator.allocate(requirements, MemoryUsage::eReadback, true);
+    Allocation second = allocator.allocate(requirements, MemoryUsage::eReadback, true);
+
+    check(first.memory == second.memory, "allocations share a block");
+    check(first.offset % atom_size == 0 && second.offset % atom_size == 0, "offsets are atom aligned");
+    vk::DeviceSize first_end = (first.offset + first.size + atom_size - 1) / atom_size * atom_size;
+    vk::DeviceSize second_end = (second.offset + second.size + atom_size - 1) / atom_size * atom_size;
+    check(first_end <= second.offset || second_end <= first.offset, "widened ranges do not overlap");
+
+    // unflushed host writes to the second survive invalidating the first
+    std::memset(second.ptr, 0xab, size_t(second.size));
+    allocator.invalidate(first);
+    bool intact = true;
+    for (vk::DeviceSize i = 0; i < second.size; ++i) {
+      intact = intact && second.ptr[i] == 0xab;
+    }
+    check(intact, "host writes to the neighbour survive an invalidate");
+
+    allocator.free(first);
+    allocator.free(second);
+  }
+  destroy_headless_device(headless);
+
+  if (failures == 0) {
+    std::cout << "allocator tests passed" << std::endl;
+  }
+  return failures == 0 ? 0 : 1;
+}